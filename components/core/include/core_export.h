@@ -14,6 +14,24 @@ extern "C" {
  */
 esp_err_t core_export_csv(const char *filename);
 
+/**
+ * @brief Export one animal (record + history) as a JSON document.
+ *        JSON is the interchange format; records are stored in binary.
+ * 
+ * @param animal_id Animal to export
+ * @param filename Output filename (e.g., "/sdcard/export/<id>.json")
+ * @return esp_err_t 
+ */
+esp_err_t core_export_animal_json(const char *animal_id, const char *filename);
+
+/**
+ * @brief Import an animal from a JSON document and store it as a binary record.
+ * 
+ * @param filename JSON file produced by core_export_animal_json()
+ * @return esp_err_t 
+ */
+esp_err_t core_import_animal_json(const char *filename);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
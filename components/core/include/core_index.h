@@ -0,0 +1,117 @@
+#pragma once
+
+#include "core_models.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Resident summary entry kept for every animal record on storage.
+ *        Built once by core_init() and refreshed by core_save_animal() so that
+ *        listing and searching never touch the filesystem.
+ */
+typedef struct {
+    animal_summary_t summary;
+    char registry_id[32];
+    animal_sex_t sex;
+    uint32_t dob;
+    bool is_deleted;
+    uint32_t deleted_at;
+} core_index_entry_t;
+
+/**
+ * @brief Allocate the index lock. Safe to call more than once.
+ */
+esp_err_t core_index_init(void);
+
+/**
+ * @brief Drop every entry (used before a full rebuild).
+ */
+void core_index_clear(void);
+
+/**
+ * @brief End a bulk load started by core_index_clear(): adopt the trigram
+ *        postings persisted under ANIMAL_DIR if they match the loaded entries,
+ *        otherwise rebuild and persist them. Until then searches scan linearly.
+ */
+void core_index_finish_load(void);
+
+/**
+ * @brief Insert or refresh the entry matching animal->id. Trigram postings
+ *        are updated only when the searchable text changed; their copy on
+ *        storage follows CONFIG_CORE_INDEX_PERSIST_DELAY_MS later.
+ */
+esp_err_t core_index_upsert(const animal_t *animal);
+
+/**
+ * @brief Drop the entry of an archived animal. Its slot is left vacant (no
+ *        query returns it) so the other slots keep their numbers; it is
+ *        reclaimed by the next rebuild.
+ */
+esp_err_t core_index_remove(const char *id);
+
+/**
+ * @brief Queue the trigram postings for writing now if they changed since
+ *        last persisted (core_flush() does this before a restart).
+ */
+esp_err_t core_index_flush(void);
+
+/**
+ * @brief Summaries of the deleted animals whose deleted_at is before cutoff
+ *        (an unknown date counts as before). Free the result with free().
+ */
+esp_err_t core_index_list_deleted(uint32_t cutoff, animal_summary_t **out_list, size_t *out_count);
+
+/**
+ * @brief True when an entry exists for id (deleted or not).
+ */
+bool core_index_contains(const char *id);
+
+/**
+ * @brief Slot of the entry for id. Slots stay valid until the next clear.
+ */
+esp_err_t core_index_find_slot(const char *id, uint16_t *out_slot);
+
+/**
+ * @brief Number of slots, deleted entries and vacant slots included.
+ */
+size_t core_index_count(void);
+
+/**
+ * @brief Copy the entries matching query (case-insensitive substring on name,
+ *        species or registry_id, NULL/empty matches all) so callers can iterate
+ *        without holding the index lock. Queries of 3+ characters intersect
+ *        trigram posting lists; shorter ones scan. Free the result with free().
+ */
+esp_err_t core_index_snapshot(const char *query, bool include_deleted,
+                              core_index_entry_t **out_entries, size_t *out_count);
+
+/**
+ * @brief Change counter of the index, bumped by every clear/upsert. Slot
+ *        numbers from core_index_match_slots() stay valid while it is unchanged.
+ */
+uint32_t core_index_generation(void);
+
+/**
+ * @brief Slot-level variant of core_index_snapshot(): returns the slots of the
+ *        matching entries in slot order. When within is non-NULL only those
+ *        slots are tested, which lets a caller refine an earlier result set.
+ *        Free the result with free().
+ */
+esp_err_t core_index_match_slots(const char *query, bool include_deleted,
+                                 const uint16_t *within, size_t within_count,
+                                 uint16_t **out_slots, size_t *out_count);
+
+/**
+ * @brief Copy the summaries of the given slots into out (room for count).
+ * @return Number of summaries copied (stale slots are skipped).
+ */
+size_t core_index_copy_summaries(const uint16_t *slots, size_t count, animal_summary_t *out);
+
+#ifdef __cplusplus
+}
+#endif
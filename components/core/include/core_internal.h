@@ -0,0 +1,479 @@
+#pragma once
+
+#include "core_models.h"
+#include "core_service.h"
+#include "core_weights.h"
+#include "esp_err.h"
+#include "cJSON.h"
+#include "reptile_storage.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Locations under storage_root() of the backend mounted by core_init()
+#define ANIMAL_DIR core_animal_dir()
+#define REPORT_DIR core_report_dir()
+#define LOG_FILE   core_log_file()
+#define FILEPATH_BUF_LEN 512
+
+// One slot per event_type_t value
+#define CORE_EVENT_TYPE_COUNT (EVENT_OTHER + 1)
+
+const char *core_animal_dir(void);
+const char *core_report_dir(void);
+const char *core_log_file(void);
+
+/**
+ * @brief Record + journal of one animal, from the cache when present.
+ *        populate caches what was read (single lookups, not full scans).
+ */
+esp_err_t core_load_animal(const char *id, animal_t *out_animal, bool populate);
+
+// =============================================================================
+// Binary record store (core_record.c)
+// =============================================================================
+
+esp_err_t core_record_path(char *buf, size_t len, const char *animal_id);
+
+/**
+ * @brief Write a versioned, checksummed binary record (header + fixed-stride
+ *        weight and event sections).
+ */
+esp_err_t core_record_write_file(const char *path, const animal_t *animal);
+
+/**
+ * @brief Read a binary record. With with_history=false only the header is
+ *        read and the weights/events arrays stay empty.
+ */
+esp_err_t core_record_read_file(const char *path, animal_t *out, bool with_history);
+
+esp_err_t core_record_write(const animal_t *animal);
+
+/**
+ * @brief Write a record whose weight history is already packed (the cache
+ *        keeps it that way); animal->weights is ignored.
+ */
+esp_err_t core_record_write_packed(const animal_t *animal, const core_weight_series_t *weights);
+esp_err_t core_record_read(const char *animal_id, animal_t *out, bool with_history);
+
+/**
+ * @brief Header-only read that also returns the latest date of each event type
+ *        (0 when none). Legacy version 1 records pay one history read for it.
+ */
+esp_err_t core_record_read_header(const char *animal_id, animal_t *out,
+                                  uint32_t last_event[CORE_EVENT_TYPE_COUNT]);
+
+/**
+ * @brief Read up to max history entries starting at index first, seeking
+ *        past the rest of the record. Weights come back in grams (unit "g").
+ *        The payload checksum covers whole sections and is not verified here.
+ * @param out_total Entries of that kind in the record (journal not included).
+ */
+esp_err_t core_record_read_weights(const char *animal_id, size_t first, size_t max,
+                                   weight_record_t *out, size_t *out_count, size_t *out_total);
+esp_err_t core_record_read_events(const char *animal_id, size_t first, size_t max,
+                                  event_record_t *out, size_t *out_count, size_t *out_total);
+
+bool core_record_exists(const char *animal_id);
+
+/**
+ * @brief Latest date of each event type found in animal->events (0 when none).
+ */
+void core_animal_last_events(const animal_t *animal, uint32_t last_event[CORE_EVENT_TYPE_COUNT]);
+
+/**
+ * @brief Chronological range of a history page: limit entries skipping offset
+ *        from the newest end (newest_first) or the oldest one.
+ * @return Entries in the page; *first is the index of the oldest one.
+ */
+size_t core_history_slice(size_t total, size_t offset, size_t limit, bool newest_first, size_t *first);
+
+/**
+ * @brief Open the record store: with CONFIG_CORE_RECORD_COLLECTION, the
+ *        collection file under ANIMAL_DIR, into which loose record files
+ *        are moved. Nothing to do for the per-file layout.
+ */
+esp_err_t core_record_store_init(void);
+
+/**
+ * @brief Call cb with the id of every stored record; cb returns false to stop.
+ */
+typedef bool (*core_record_id_cb_t)(const char *animal_id, void *ctx);
+esp_err_t core_record_foreach_id(core_record_id_cb_t cb, void *ctx);
+
+/**
+ * @brief Stored size of a record (header and history), journal excluded.
+ */
+esp_err_t core_record_size(const char *animal_id, size_t *out_size);
+
+/**
+ * @brief Delete a record from the store (its journal is left to the caller).
+ */
+esp_err_t core_record_remove(const char *animal_id);
+
+// =============================================================================
+// Packed collection store (core_collection.c)
+// =============================================================================
+
+/**
+ * Many small records in one file: fixed-size slots on 4 KB pages hold each
+ * key and its header, the rest of the record lives in an extent. Keys are
+ * found through a resident open-addressing hash table and slot pages go
+ * through a small LRU page cache, so a lookup costs no directory search and
+ * usually no read. Thread safe.
+ */
+typedef struct core_collection core_collection_t;
+
+#define CORE_COLLECTION_KEY_LEN    37
+#define CORE_COLLECTION_HEADER_MAX 456
+
+/**
+ * @brief Open path, creating an empty collection only if it does not exist.
+ *        A compaction interrupted by a power loss is completed first; that
+ *        is safe because only the collection itself writes its temp file.
+ * @return NULL on any other open failure, the file left untouched.
+ */
+core_collection_t *core_collection_open(const char *path);
+void core_collection_close(core_collection_t *c);
+
+/**
+ * @brief Insert or replace key. The new payload and a new slot are written
+ *        and synced before the old slot is cleared, so a power loss keeps one
+ *        of the two versions. Dead space is compacted once it outweighs live
+ *        data.
+ */
+esp_err_t core_collection_put(core_collection_t *c, const char *key, const void *header, size_t header_len,
+                              const void *payload, size_t payload_len);
+
+/**
+ * @brief Copy up to max bytes of the header of key.
+ * @return ESP_ERR_NOT_FOUND if key is not stored.
+ */
+esp_err_t core_collection_get_header(core_collection_t *c, const char *key, void *header, size_t max,
+                                     size_t *out_len);
+
+/**
+ * @brief Read len payload bytes of key starting at offset.
+ */
+esp_err_t core_collection_read(core_collection_t *c, const char *key, size_t offset, void *buf, size_t len);
+
+/**
+ * @brief Header plus payload size of key.
+ */
+esp_err_t core_collection_size(core_collection_t *c, const char *key, size_t *out_size);
+
+bool core_collection_contains(core_collection_t *c, const char *key);
+
+/**
+ * @brief Free the slot of key; its extent becomes dead space, compacted
+ *        under the same condition as for puts.
+ */
+esp_err_t core_collection_remove(core_collection_t *c, const char *key);
+size_t core_collection_count(core_collection_t *c);
+
+/**
+ * @brief Call cb with every key, in slot order; cb returns false to stop and
+ *        may use the collection.
+ */
+typedef bool (*core_collection_key_cb_t)(const char *key, void *ctx);
+esp_err_t core_collection_foreach(core_collection_t *c, core_collection_key_cb_t cb, void *ctx);
+
+/**
+ * @brief Rewrite the file without dead extents (also done by puts).
+ */
+esp_err_t core_collection_compact(core_collection_t *c);
+
+/**
+ * @brief core_record_write_file() / core_record_read_file() counterparts
+ *        for a collection keyed by animal id.
+ */
+esp_err_t core_record_write_collection(core_collection_t *c, const animal_t *animal);
+esp_err_t core_record_read_collection(core_collection_t *c, const char *animal_id, animal_t *out,
+                                      bool with_history);
+
+// =============================================================================
+// Per-type event columns (core_events.c)
+// =============================================================================
+
+/**
+ * @brief Structure-of-arrays index over an event array. The events of type t
+ *        are dates/rows[start[t] .. start[t + 1]), ascending by date; rows
+ *        are positions in the event array. Built for event_count events, so
+ *        appends make it stale.
+ */
+typedef struct {
+    uint32_t *dates;
+    uint32_t *rows;
+    uint32_t start[CORE_EVENT_TYPE_COUNT + 1];
+    size_t event_count;
+} core_event_columns_t;
+
+void core_event_columns_init(core_event_columns_t *cols);
+void core_event_columns_free(core_event_columns_t *cols);
+esp_err_t core_event_columns_build(core_event_columns_t *cols, const event_record_t *events, size_t count);
+
+/**
+ * @brief Run query against columns built over events; fills page->events,
+ *        count and total.
+ */
+esp_err_t core_event_columns_query(const core_event_columns_t *cols, const event_record_t *events,
+                                   const core_event_query_t *query, core_history_page_t *page);
+
+// =============================================================================
+// JSON interchange (core_export.c)
+// =============================================================================
+
+/**
+ * @brief Stream the JSON document used for import/export of one animal.
+ */
+void core_animal_write_json(storage_json_writer_t *w, const animal_t *animal);
+
+/**
+ * @brief Write one animal as a JSON file (atomic, bounded memory).
+ */
+esp_err_t core_animal_save_json(const char *filename, const animal_t *animal);
+
+/**
+ * @brief Fill out from a JSON DOM (kept as the benchmark baseline).
+ */
+esp_err_t core_animal_from_json(const cJSON *root, animal_t *out);
+
+/**
+ * @brief Fill out straight from a token stream, no DOM. With summary_only,
+ *        stops as soon as id, name and species were read (history skipped).
+ */
+esp_err_t core_animal_read_json(storage_json_reader_t *r, animal_t *out, bool summary_only);
+
+/**
+ * @brief core_animal_read_json() over a file.
+ * @return ESP_ERR_NOT_FOUND if the file does not exist.
+ */
+esp_err_t core_animal_load_json(const char *filename, animal_t *out, bool summary_only);
+
+// =============================================================================
+// Benchmarks (core_bench.c)
+// =============================================================================
+
+/**
+ * @brief Compare JSON and binary record load/save latency on the SD card.
+ *        Only called when CONFIG_CORE_BENCHMARK_AT_BOOT is enabled.
+ */
+void core_bench_run(void);
+
+// =============================================================================
+// History journal (core_journal.c)
+// =============================================================================
+
+/**
+ * @brief Append one weight sample to the animal's journal (single fwrite).
+ */
+esp_err_t core_journal_append_weight(const char *animal_id, const weight_record_t *weight);
+
+/**
+ * @brief Append one event to the animal's journal (single fwrite).
+ */
+esp_err_t core_journal_append_event(const char *animal_id, const event_record_t *event);
+
+/**
+ * @brief Append the journaled records to animal->weights / animal->events.
+ *        A missing journal is not an error.
+ */
+esp_err_t core_journal_merge(animal_t *animal);
+
+/**
+ * @brief Remove the journal once its records are part of the base record.
+ */
+void core_journal_discard(const char *animal_id);
+
+/**
+ * @brief True when the journal outgrew the base record and should be
+ *        folded back into it (keeps appends amortized O(1)).
+ */
+bool core_journal_needs_compaction(const char *animal_id);
+
+/**
+ * @brief Raise last_event[type] to the latest journaled event of each type.
+ */
+void core_journal_last_events(const char *animal_id, uint32_t last_event[CORE_EVENT_TYPE_COUNT]);
+
+// =============================================================================
+// Alert engine (core_alerts.c)
+// =============================================================================
+
+/**
+ * @brief Create the lock and timer, and compile the rule file.
+ */
+esp_err_t core_alerts_init(void);
+
+/**
+ * @brief Forget every tracked animal (used before a full rebuild).
+ */
+void core_alerts_clear(void);
+
+/**
+ * @brief Start tracking animal, or refresh it after a save.
+ */
+void core_alerts_track(const animal_t *animal, const uint32_t last_event[CORE_EVENT_TYPE_COUNT]);
+
+/**
+ * @brief Account for one new event of a tracked animal.
+ */
+void core_alerts_note_event(const char *animal_id, event_type_t type, uint32_t date);
+
+/**
+ * @brief Start tracking a document's expiry, or refresh it after a save.
+ */
+void core_alerts_track_document(const document_t *doc);
+
+/**
+ * @brief Stop alerting for a deleted document.
+ */
+void core_alerts_forget_document(const char *doc_id);
+
+// =============================================================================
+// Document store (core_documents.c)
+// =============================================================================
+
+esp_err_t core_documents_init(void);
+
+/**
+ * @brief Open the document collection at the storage root, build the
+ *        by-animal and by-expiry indexes and track every expiry in the alert
+ *        engine. Run after core_alerts_clear().
+ */
+esp_err_t core_documents_load(void);
+
+// =============================================================================
+// Tombstone archive (core_archive.c)
+// =============================================================================
+
+/**
+ * @brief Start the background task that moves animals deleted more than
+ *        CONFIG_CORE_ARCHIVE_RETENTION_DAYS ago to ANIMAL_DIR/archive.col.
+ *        Nothing happens when CONFIG_CORE_ARCHIVE_DELETED is disabled.
+ */
+void core_archive_start(void);
+
+/**
+ * @brief One archive pass, run by the task every CONFIG_CORE_ARCHIVE_INTERVAL_H.
+ * @param out_archived Number of animals moved (may be NULL).
+ */
+esp_err_t core_archive_run(size_t *out_archived);
+
+// =============================================================================
+// Event timeline (core_timeline.c)
+// =============================================================================
+
+/**
+ * @brief Create the lock. The index is built by core_timeline_start_build().
+ */
+esp_err_t core_timeline_init(void);
+
+/**
+ * @brief Index the history of every animal of the summary index in a
+ *        background task; queries are refused until it is done.
+ */
+void core_timeline_start_build(void);
+
+/**
+ * @brief Held around a history change and its timeline update, so the boot
+ *        build sees each change exactly once, and around write-backs, so a
+ *        reader of the record and the journal sees both from one state.
+ *        Recursive; take it before the cache lock, never after.
+ */
+void core_timeline_lock(void);
+void core_timeline_unlock(void);
+
+/**
+ * @brief Add one weighing (CORE_TIMELINE_WEIGHT) or event appended to the
+ *        end of an animal's history.
+ */
+void core_timeline_note(const char *animal_id, uint8_t type, uint32_t date);
+
+/**
+ * @brief Re-index an animal whose whole history was saved.
+ */
+void core_timeline_replace(const animal_t *animal);
+
+/**
+ * @brief Drop every entry of an animal about to leave the summary index.
+ */
+void core_timeline_forget(const char *animal_id);
+
+// =============================================================================
+// Record cache (core_cache.c)
+// =============================================================================
+
+/**
+ * @brief Allocate CONFIG_CORE_CACHE_ENTRIES slots and start the write-back task.
+ */
+esp_err_t core_cache_init(void);
+
+/**
+ * @brief Copy a cached animal into out (caller frees the content).
+ * @return ESP_ERR_NOT_FOUND on a miss.
+ */
+esp_err_t core_cache_get(const char *id, animal_t *out, bool with_history);
+
+/**
+ * @brief Cache an animal just read from disk (record + journal merged).
+ */
+void core_cache_fill(const animal_t *animal);
+
+/**
+ * @brief Save path: cache the animal as dirty for the write-back task, or
+ *        write it through when write-back is disabled.
+ */
+esp_err_t core_cache_store(const animal_t *animal);
+
+/**
+ * @brief Journal one weight / event and mirror it into the cached copy.
+ */
+esp_err_t core_cache_append_weight(const char *id, const weight_record_t *weight);
+esp_err_t core_cache_append_event(const char *id, const event_record_t *event);
+
+/**
+ * @brief Stream the packed weights of a cached animal to cb, under the lock.
+ * @return ESP_ERR_NOT_FOUND on a miss.
+ */
+esp_err_t core_cache_foreach_weight(const char *id, core_weight_cb_t cb, void *ctx);
+
+/**
+ * @brief Copy one page of a cached animal's history, in chronological order
+ *        (weights in grams). *out is NULL for an empty page; free with free().
+ * @return ESP_ERR_NOT_FOUND on a miss.
+ */
+esp_err_t core_cache_page_weights(const char *id, size_t offset, size_t limit, bool newest_first,
+                                  weight_record_t **out, size_t *out_count, size_t *out_total);
+esp_err_t core_cache_page_events(const char *id, size_t offset, size_t limit, bool newest_first,
+                                 event_record_t **out, size_t *out_count, size_t *out_total);
+
+/**
+ * @brief core_query_events() on a cached animal; its columns are rebuilt
+ *        first if events were appended since.
+ * @return ESP_ERR_NOT_FOUND on a miss.
+ */
+esp_err_t core_cache_query_events(const char *id, const core_event_query_t *query, core_history_page_t *page);
+
+/**
+ * @brief Write every dirty entry back to its record file.
+ */
+esp_err_t core_cache_flush(void);
+
+/**
+ * @brief True when id has a save waiting for write-back: its journal is
+ *        folded in and discarded by that write, whatever its size.
+ */
+bool core_cache_dirty(const char *id);
+
+/**
+ * @brief Drop the cached copy of id, pending write-back included.
+ */
+void core_cache_forget(const char *id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -46,6 +46,7 @@ typedef struct {
     char origin[16];        // NC, WC, CB...
     char registry_id[32];   // Numéro I-FAP / Registre
     bool is_deleted;        // Soft delete
+    uint32_t deleted_at;    // Timestamp suppression (0 si inconnu)
     
     // Dynamic Lists
     weight_record_t *weights;
@@ -55,11 +56,15 @@ typedef struct {
     size_t event_count;
 } animal_t;
 
+// Interned species name, see core_species.h
+typedef uint16_t species_id_t;
+#define SPECIES_ID_NONE 0
+
 // Lightweight structure for listing
 typedef struct {
     char id[37];
     char name[64];
-    char species[128];
+    species_id_t species_id; // core_species_name() for display
 } animal_summary_t;
 
 typedef struct {
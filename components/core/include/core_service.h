@@ -1,7 +1,10 @@
 #pragma once
 
 #include "core_models.h"
+#include "core_species.h"
+#include "core_weights.h"
 #include "esp_err.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -10,6 +13,7 @@ extern "C" {
 
 /**
  * @brief Initialize the core service (load data, check integrity).
+ *        Builds the resident summary index used by list/search.
  * 
  * @return esp_err_t 
  */
@@ -21,33 +25,255 @@ esp_err_t core_init(void);
 
 esp_err_t core_save_animal(const animal_t *animal);
 esp_err_t core_get_animal(const char *id, animal_t *out_animal);
+
+/**
+ * @brief Header fields only (one record header read, or the cached copy);
+ *        weights and events stay empty. Pair with core_get_history_page().
+ */
+esp_err_t core_get_animal_header(const char *id, animal_t *out_animal);
 void core_free_animal_content(animal_t *animal);
 esp_err_t core_list_animals(animal_summary_t **out_list, size_t *out_count);
 void core_free_animal_list(animal_summary_t *list);
 
 /**
- * @brief Search animals by name or species.
+ * @brief Search animals by name, species or registry ID (case-insensitive substring).
+ *        Served from the resident summary index (no file I/O).
  * 
  * @param query Search string.
- * @param out_list Result list.
+ * @param out_list Result list; species are ids, see core_species_name().
  * @param out_count Result count.
  * @return esp_err_t 
  */
 esp_err_t core_search_animals(const char *query, animal_summary_t **out_list, size_t *out_count);
 
+// =============================================================================
+// Collection Scan
+// =============================================================================
+
+typedef enum {
+    CORE_SCAN_SUMMARY = 0, // id, name, species, registry_id, sex, dob, is_deleted (resident index, no I/O)
+    CORE_SCAN_HEADER,      // + origin (one record header read)
+    CORE_SCAN_FULL,        // + weights and events, journal merged
+} core_scan_level_t;
+
+typedef struct {
+    const char *query;       // Substring on name/species/registry_id, NULL or "" for all
+    bool include_deleted;
+    core_scan_level_t level;
+} core_scan_filter_t;
+
+/**
+ * @brief Called once per matching animal. The animal (and its history) is
+ *        only valid for the duration of the call.
+ *
+ * @return true to continue, false to stop the scan.
+ */
+typedef bool (*core_scan_visitor_t)(const animal_t *animal, void *ctx);
+
+/**
+ * @brief Single-pass iteration over the collection: every matching record is
+ *        decoded exactly once, at the requested level.
+ *
+ * @param filter Selection and decode level (NULL: all live animals, summary level).
+ * @param visitor Callback invoked per animal.
+ * @param ctx User pointer handed to the visitor.
+ * @return esp_err_t 
+ */
+esp_err_t core_scan(const core_scan_filter_t *filter, core_scan_visitor_t visitor, void *ctx);
+
+typedef struct {
+    size_t animal_count;
+    size_t male_count;
+    size_t female_count;
+    size_t unknown_sex_count;
+} core_stats_t;
+
+/**
+ * @brief Collection statistics (served from the resident index).
+ */
+esp_err_t core_get_stats(core_stats_t *out_stats);
+
+// =============================================================================
+// Incremental Search
+// =============================================================================
+
+/**
+ * @brief Type-ahead search state: caches the result set of every prefix typed
+ *        so far, so each keystroke refines (or rewinds to) a previous set
+ *        instead of searching the whole collection again. Not thread-safe;
+ *        one session per text field.
+ */
+typedef struct core_search_session core_search_session_t;
+
+core_search_session_t *core_search_session_create(void);
+void core_search_session_destroy(core_search_session_t *session);
+
+/**
+ * @brief Update the session with the current query text.
+ *
+ * @param session Search session.
+ * @param query Current text (NULL or "" matches all live animals).
+ * @param max_results Number of summaries to materialise (0: no bound).
+ * @param out_list Result window, owned by the session and valid until the next update.
+ * @param out_count Number of summaries in out_list.
+ * @param out_total Optional, total number of matches.
+ * @return esp_err_t 
+ */
+esp_err_t core_search_session_update(core_search_session_t *session, const char *query,
+                                     size_t max_results, const animal_summary_t **out_list,
+                                     size_t *out_count, size_t *out_total);
+
 // =============================================================================
 // History Operations
 // =============================================================================
 
+/**
+ * @brief Append a weight / event to the animal's history journal. Weights are
+ *        normalized to grams (unit: mg, g, kg, oz or lb).
+ *        Costs one append regardless of history length; the journal is folded
+ *        into the base record by core_save_animal() once it outgrows it.
+ */
 esp_err_t core_add_weight(const char *animal_id, float weight, const char *unit);
 esp_err_t core_add_event(const char *animal_id, event_type_t type, const char *description);
 
+/**
+ * @brief Stream an animal's weight history (date, milligrams) in order,
+ *        decoded from the packed series without building an array.
+ */
+esp_err_t core_foreach_weight(const char *animal_id, core_weight_cb_t cb, void *ctx);
+
+typedef enum {
+    CORE_HISTORY_WEIGHTS = 0,
+    CORE_HISTORY_EVENTS,
+} core_history_kind_t;
+
+typedef enum {
+    CORE_HISTORY_NEWEST_FIRST = 0,
+    CORE_HISTORY_OLDEST_FIRST,
+} core_history_order_t;
+
+typedef struct {
+    core_history_kind_t kind;
+    size_t total;              // Entries of this kind in the whole history
+    size_t count;              // Entries in this page
+    weight_record_t *weights;  // CORE_HISTORY_WEIGHTS, in grams
+    event_record_t *events;    // CORE_HISTORY_EVENTS
+} core_history_page_t;
+
+/**
+ * @brief Read at most limit weights or events, skipping the offset newest
+ *        (or oldest) ones, in the requested order. Only that slice is read
+ *        from the record; journaled entries are included.
+ *        Free with core_free_history_page().
+ */
+esp_err_t core_get_history_page(const char *animal_id, core_history_kind_t kind, size_t offset,
+                                size_t limit, core_history_order_t order, core_history_page_t *out_page);
+void core_free_history_page(core_history_page_t *page);
+
+#define CORE_EVENT_MASK(type) (1u << (type))
+
+typedef struct {
+    uint32_t types;               // CORE_EVENT_MASK() bits, 0 for every type
+    uint32_t from;                // Inclusive date bounds, 0 when unbounded
+    uint32_t to;
+    size_t offset;
+    size_t limit;
+    core_history_order_t order;
+} core_event_query_t;
+
+/**
+ * @brief Events of the selected types within [from, to], merged by date and
+ *        paged like core_get_history_page(). Served from per-type sorted
+ *        date columns: each type is a slice and each bound a binary search.
+ *        The last shedding is { CORE_EVENT_MASK(EVENT_SHEDDING), .limit = 1 }.
+ *        Free with core_free_history_page().
+ */
+esp_err_t core_query_events(const char *animal_id, const core_event_query_t *query, core_history_page_t *out_page);
+
+// =============================================================================
+// Event Timeline
+// =============================================================================
+
+// Timeline type of weighings; CORE_EVENT_MASK(CORE_TIMELINE_WEIGHT) selects them
+#define CORE_TIMELINE_WEIGHT 31
+
+typedef struct {
+    uint32_t date;
+    uint8_t type;           // event_type_t or CORE_TIMELINE_WEIGHT
+    uint32_t offset;        // Oldest-first position in the animal's weights or events
+    char animal_id[37];
+    char name[64];
+} core_timeline_item_t;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint32_t types;
+    core_history_order_t order;
+    // Position: the last entry returned
+    bool started;
+    uint32_t last_date;
+    uint32_t last_offset;
+    uint16_t last_slot;
+    uint8_t last_type;
+} core_timeline_cursor_t;
+
+/**
+ * @brief Start a walk over the weighings and events of every animal dated
+ *        within [from, to] (to 0: no upper bound), restricted to type_mask
+ *        (CORE_EVENT_MASK() bits, 0 for all).
+ */
+void core_timeline_cursor_init(core_timeline_cursor_t *cursor, uint32_t from, uint32_t to,
+                               uint32_t type_mask, core_history_order_t order);
+
+/**
+ * @brief Next items of the walk, at most max; *out_count is 0 at the end.
+ *        The first call seeks with a binary search, later calls resume after
+ *        the last item even if entries were added meanwhile. Details of an
+ *        event come from core_get_history_page() at item offset.
+ * @return ESP_ERR_INVALID_STATE while the boot build is still running.
+ */
+esp_err_t core_timeline_next(core_timeline_cursor_t *cursor, core_timeline_item_t *out,
+                             size_t max, size_t *out_count);
+
+/**
+ * @brief False until the timeline has been built after boot.
+ */
+bool core_timeline_ready(void);
+
+// =============================================================================
+// Record Cache
+// =============================================================================
+
+typedef struct {
+    uint32_t hits;          // core_get_animal() and full scans served from memory
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t writebacks;    // Dirty records written to the SD card
+    size_t capacity;        // CONFIG_CORE_CACHE_ENTRIES
+    size_t used;
+    size_t dirty;           // Saved but not yet written back
+} core_cache_stats_t;
+
+/**
+ * @brief Write every saved-but-cached animal to the SD card now, and queue
+ *        the search index if it changed. Saves are otherwise written back
+ *        CONFIG_CORE_CACHE_WRITEBACK_MS after the last one; call this before
+ *        a restart.
+ */
+esp_err_t core_flush(void);
+
+void core_get_cache_stats(core_cache_stats_t *out_stats);
+
 // =============================================================================
 // Alerts Operations
 // =============================================================================
 
 /**
- * @brief Generate a list of alerts (e.g. no feeding for > 21 days).
+ * @brief Generate a list of alerts (feeding, shedding, vet, cleaning intervals
+ *        and document expiry, per alert_rules.json at the storage root; default: no feeding
+ *        for > 21 days, documents 30 days before expiry).
+ *        Served from the alert engine's overdue list, O(number of alerts).
  * 
  * @param out_list List of alert strings.
  * @param out_count Count of alerts.
@@ -57,11 +283,51 @@ esp_err_t core_get_alerts(char ***out_list, size_t *out_count);
 
 void core_free_alert_list(char **list, size_t count);
 
+/**
+ * @brief Number of current alerts, O(1). Kept up to date by saves, new events
+ *        and a timer armed for the next animal to become overdue.
+ */
+size_t core_get_alert_count(void);
+
+/**
+ * @brief Re-read the alert rule file and re-evaluate every tracked animal and
+ *        document from cached dates (no record is read).
+ */
+esp_err_t core_alerts_reload_rules(void);
+
 // =============================================================================
 // Document Operations
 // =============================================================================
 
+/**
+ * @brief Insert or replace the document with doc->id. Written to storage
+ *        before the in-memory indexes and the alert engine are updated.
+ */
 esp_err_t core_save_document(const document_t *doc);
+
+/**
+ * @brief Remove a document and its alert.
+ * @return ESP_ERR_NOT_FOUND if no document has that id.
+ */
+esp_err_t core_delete_document(const char *id);
+
+esp_err_t core_get_document(const char *id, document_t *out_doc);
+
+/**
+ * @brief Documents linked to animal_id, ordered by id. Range scan of the
+ *        by-animal index; free the list with core_free_document_list().
+ */
+esp_err_t core_list_animal_documents(const char *animal_id, document_t **out_list, size_t *out_count);
+
+/**
+ * @brief Documents whose date_expire lies within [from, to], soonest first.
+ *        Range scan of the expiry index; permanent documents (date_expire 0)
+ *        are never listed. Free the list with core_free_document_list().
+ */
+esp_err_t core_list_expiring_documents(uint32_t from, uint32_t to, document_t **out_list, size_t *out_count);
+
+void core_free_document_list(document_t *list);
+
 esp_err_t core_generate_report(const char *animal_id);
 esp_err_t core_list_reports(char ***out_list, size_t *out_count);
 void core_free_report_list(char **list, size_t count);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "core_models.h"
+#include "esp_err.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Species intern table. Every distinct species name gets a small id,
+ *        stable until reboot, so summaries carry 2 bytes instead of the name
+ *        and species equality is an integer compare. Names are never removed.
+ */
+
+/**
+ * @brief Allocate the table lock. Safe to call more than once.
+ */
+esp_err_t core_species_init(void);
+
+/**
+ * @brief Id of name, adding it on first use. NULL or "" is SPECIES_ID_NONE.
+ * @return ESP_ERR_NO_MEM when the table cannot grow.
+ */
+esp_err_t core_species_intern(const char *name, species_id_t *out_id);
+
+/**
+ * @brief Name of an interned species ("" for SPECIES_ID_NONE or an unknown
+ *        id). The string stays valid and unchanged until reboot.
+ */
+const char *core_species_name(species_id_t id);
+
+/**
+ * @brief Number of ids handed out, SPECIES_ID_NONE included.
+ */
+size_t core_species_count(void);
+
+#ifdef __cplusplus
+}
+#endif
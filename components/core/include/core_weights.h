@@ -0,0 +1,95 @@
+#pragma once
+
+#include "core_models.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Packed weight history. Each sample is two zigzag varints: the date delta
+ * and the milligram delta to the previous sample (the first one against
+ * 0/0). Weekly weighings of a growing animal take 4-5 bytes per sample
+ * instead of a 16-byte weight_record_t.
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    uint32_t count;
+    uint32_t last_date;      // Encoder state: previous sample
+    int32_t last_mg;
+} core_weight_series_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t remaining;
+    uint32_t date;
+    int32_t mg;
+} core_weight_iter_t;
+
+/**
+ * @brief Receives one sample; return false to stop the iteration.
+ */
+typedef bool (*core_weight_cb_t)(uint32_t date, int32_t mg, void *ctx);
+
+// Worst case bytes of one encoded sample: two deltas of at most 33 bits
+#define CORE_WEIGHT_SAMPLE_MAX 10
+
+/**
+ * @brief Convert a value in "mg", "g", "kg", "oz" or "lb" (empty: "g") to
+ *        integer milligrams.
+ * @return ESP_ERR_INVALID_ARG for an unknown unit or an out-of-range value.
+ */
+esp_err_t core_weight_to_mg(float value, const char *unit, int32_t *out_mg);
+
+/**
+ * @brief Rewrite a row in grams (unit "g"); unknown units are taken as grams.
+ */
+void core_weight_normalize(weight_record_t *weight);
+
+/**
+ * @brief Format for display: "850 g", "1.25 kg".
+ */
+void core_weight_format(int32_t mg, char *buf, size_t len);
+
+void core_weight_series_init(core_weight_series_t *series);
+void core_weight_series_free(core_weight_series_t *series);
+
+/**
+ * @brief Make room for extra_samples more appends, so they cannot fail.
+ */
+esp_err_t core_weight_series_reserve(core_weight_series_t *series, size_t extra_samples);
+
+esp_err_t core_weight_series_append(core_weight_series_t *series, uint32_t date, int32_t mg);
+
+/**
+ * @brief Append weight_record_t rows, normalizing their units.
+ */
+esp_err_t core_weight_series_encode(core_weight_series_t *series, const weight_record_t *weights, size_t count);
+
+/**
+ * @brief Expand to weight_record_t rows in grams (unit "g"); *out is NULL
+ *        for an empty series. Free with free().
+ */
+esp_err_t core_weight_series_decode(const uint8_t *data, size_t len, uint32_t count,
+                                    weight_record_t **out, size_t *out_count);
+
+/**
+ * @brief Iterate an encoded buffer sample by sample, without expanding it.
+ */
+void core_weight_iter_init(core_weight_iter_t *it, const uint8_t *data, size_t len, uint32_t count);
+
+/**
+ * @brief Next sample; false at the end or on a truncated buffer.
+ */
+bool core_weight_iter_next(core_weight_iter_t *it, uint32_t *date, int32_t *mg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,604 @@
+#include "core_service.h"
+#include "core_internal.h"
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "CORE_ALERTS";
+
+#define ALERT_DAY_S              (24 * 3600)
+#define ALERT_INITIAL_CAPACITY   32
+
+// Rule file (all durations in days):
+// {
+//   "defaults": { "feeding": 21, "document": 30 },
+//   "rules": [
+//     { "species": "Python regius", "feeding": 14, "shedding": 60 },
+//     { "animal": "<uuid>", "vet": 365 }
+//   ]
+// }
+// Per-animal rules win over species rules, which win over the defaults.
+// For documents the value is the warning lead time before date_expire.
+#define ALERT_RULES_FILE         "alert_rules.json"   // Under storage_root()
+
+// The first kinds map 1:1 onto event_type_t values
+typedef enum {
+    ALERT_KIND_FEEDING = EVENT_FEEDING,
+    ALERT_KIND_SHEDDING = EVENT_SHEDDING,
+    ALERT_KIND_VET = EVENT_VET,
+    ALERT_KIND_CLEANING = EVENT_CLEANING,
+    ALERT_KIND_DOCUMENT,
+    ALERT_KIND_COUNT
+} alert_kind_t;
+
+#define ALERT_EVENT_KINDS ALERT_KIND_DOCUMENT
+
+static const char *const s_kind_names[ALERT_KIND_COUNT] = {
+    "feeding", "shedding", "vet", "cleaning", "document",
+};
+
+typedef enum {
+    RULE_SCOPE_ANIMAL = 0,
+    RULE_SCOPE_SPECIES = 1,
+} rule_scope_t;
+
+// Compiled rule: sorted by (scope, key, kind) for binary search.
+// Keys are FNV-1a hashes of the animal id / lowercased species name.
+typedef struct {
+    uint32_t key;
+    uint8_t scope;
+    uint8_t kind;
+    uint16_t order;     // position in the file, later rules win
+    uint32_t seconds;
+} alert_rule_t;
+
+// Alert subject: an animal (owns ALERT_EVENT_KINDS items) or a document (one item)
+typedef struct {
+    char id[37];
+    char label[64];
+    uint32_t id_key;
+    uint32_t species_key;
+    int32_t first_item;
+    bool is_document;
+    bool inactive;          // deleted animal: dates kept, nothing scheduled
+} alert_subject_t;
+
+// One schedulable alert. Each item is either pending (in the min-heap, keyed
+// by due time), overdue (in the unordered overdue list) or disabled (no rule).
+// The esp_timer is armed for the heap root, so the overdue list is exactly
+// the set of current alerts.
+typedef struct {
+    int32_t subject;
+    uint8_t kind;
+    uint32_t last;          // last event date, or date_expire for documents (0: none)
+    uint32_t interval;      // resolved rule, 0: disabled
+    uint32_t due;
+    int32_t heap_pos;       // -1 when not pending
+    int32_t overdue_pos;    // -1 when not overdue
+} alert_item_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_timer = NULL;
+
+static alert_rule_t *s_rules = NULL;
+static size_t s_rule_count = 0;
+static uint32_t s_default_interval[ALERT_KIND_COUNT];
+
+static alert_subject_t *s_subjects = NULL;
+static size_t s_subject_count = 0;
+static size_t s_subject_capacity = 0;
+static alert_item_t *s_items = NULL;
+static size_t s_item_count = 0;
+static size_t s_item_capacity = 0;
+static int32_t *s_heap = NULL;      // indices into s_items
+static size_t s_heap_len = 0;
+static int32_t *s_overdue = NULL;   // indices into s_items
+static size_t s_overdue_len = 0;
+
+static void alerts_lock(void) {
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void alerts_unlock(void) {
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+static void *alerts_realloc(void *ptr, size_t size) {
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!grown) grown = realloc(ptr, size);
+    return grown;
+}
+
+static esp_err_t subjects_reserve(size_t wanted) {
+    if (wanted <= s_subject_capacity) return ESP_OK;
+    size_t new_cap = s_subject_capacity ? s_subject_capacity * 2 : ALERT_INITIAL_CAPACITY;
+    while (new_cap < wanted) new_cap *= 2;
+    alert_subject_t *grown = alerts_realloc(s_subjects, new_cap * sizeof(alert_subject_t));
+    if (!grown) return ESP_ERR_NO_MEM;
+    s_subjects = grown;
+    s_subject_capacity = new_cap;
+    return ESP_OK;
+}
+
+static esp_err_t items_reserve(size_t wanted) {
+    if (wanted <= s_item_capacity) return ESP_OK;
+    size_t new_cap = s_item_capacity ? s_item_capacity * 2 : ALERT_INITIAL_CAPACITY * ALERT_EVENT_KINDS;
+    while (new_cap < wanted) new_cap *= 2;
+
+    // Heap and overdue list can each hold every item; grow all three together
+    alert_item_t *items = alerts_realloc(s_items, new_cap * sizeof(alert_item_t));
+    if (!items) return ESP_ERR_NO_MEM;
+    s_items = items;
+    int32_t *heap = alerts_realloc(s_heap, new_cap * sizeof(int32_t));
+    if (!heap) return ESP_ERR_NO_MEM;
+    s_heap = heap;
+    int32_t *overdue = alerts_realloc(s_overdue, new_cap * sizeof(int32_t));
+    if (!overdue) return ESP_ERR_NO_MEM;
+    s_overdue = overdue;
+    s_item_capacity = new_cap;
+    return ESP_OK;
+}
+
+static int32_t subject_find(const char *id, bool is_document) {
+    for (size_t i = 0; i < s_subject_count; i++) {
+        if (s_subjects[i].is_document == is_document && strcmp(s_subjects[i].id, id) == 0) return (int32_t)i;
+    }
+    return -1;
+}
+
+// Case-insensitive FNV-1a, so "python regius" and "Python Regius" share rules
+static uint32_t rule_key(const char *text) {
+    uint32_t h = 2166136261u;
+    for (const char *p = text; p && *p; p++) {
+        h ^= (uint8_t)tolower((unsigned char)*p);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// =============================================================================
+// Rules
+// =============================================================================
+
+static int cmp_rule(const void *a, const void *b) {
+    const alert_rule_t *x = a, *y = b;
+    if (x->scope != y->scope) return (int)x->scope - (int)y->scope;
+    if (x->key != y->key) return (x->key > y->key) - (x->key < y->key);
+    return (int)x->kind - (int)y->kind;
+}
+
+static int cmp_rule_order(const void *a, const void *b) {
+    int c = cmp_rule(a, b);
+    if (c != 0) return c;
+    return (int)((const alert_rule_t *)a)->order - (int)((const alert_rule_t *)b)->order;
+}
+
+static const alert_rule_t *rule_find(rule_scope_t scope, uint32_t key, alert_kind_t kind) {
+    if (s_rule_count == 0) return NULL;
+    alert_rule_t probe = { .key = key, .scope = scope, .kind = kind };
+    return bsearch(&probe, s_rules, s_rule_count, sizeof(alert_rule_t), cmp_rule);
+}
+
+static uint32_t rule_resolve(const alert_subject_t *subject, alert_kind_t kind) {
+    const alert_rule_t *rule = rule_find(RULE_SCOPE_ANIMAL, subject->id_key, kind);
+    if (!rule && !subject->is_document) rule = rule_find(RULE_SCOPE_SPECIES, subject->species_key, kind);
+    return rule ? rule->seconds : s_default_interval[kind];
+}
+
+// Compile the rule file into the sorted table; built-in defaults if absent
+static void rules_compile(void) {
+    free(s_rules);
+    s_rules = NULL;
+    s_rule_count = 0;
+    memset(s_default_interval, 0, sizeof(s_default_interval));
+    s_default_interval[ALERT_KIND_FEEDING] = 21 * ALERT_DAY_S;
+    s_default_interval[ALERT_KIND_DOCUMENT] = 30 * ALERT_DAY_S;
+
+    char path[FILEPATH_BUF_LEN];
+    if (storage_path(path, sizeof(path), ALERT_RULES_FILE) != ESP_OK) return;
+    cJSON *root = storage_json_load(path);
+    if (!root) return;
+
+    const cJSON *defaults = cJSON_GetObjectItem(root, "defaults");
+    for (int k = 0; k < ALERT_KIND_COUNT; k++) {
+        const cJSON *days = cJSON_GetObjectItem(defaults, s_kind_names[k]);
+        if (cJSON_IsNumber(days) && days->valuedouble >= 0) {
+            s_default_interval[k] = (uint32_t)(days->valuedouble * ALERT_DAY_S);
+        }
+    }
+
+    const cJSON *rules = cJSON_GetObjectItem(root, "rules");
+    size_t capacity = (size_t)cJSON_GetArraySize(rules) * ALERT_KIND_COUNT;
+    s_rules = capacity ? calloc(capacity, sizeof(alert_rule_t)) : NULL;
+    const cJSON *rule = NULL;
+    cJSON_ArrayForEach(rule, rules) {
+        if (!s_rules) break;
+        const cJSON *animal = cJSON_GetObjectItem(rule, "animal");
+        const cJSON *species = cJSON_GetObjectItem(rule, "species");
+        alert_rule_t compiled = {0};
+        if (cJSON_IsString(animal)) {
+            compiled.scope = RULE_SCOPE_ANIMAL;
+            compiled.key = rule_key(animal->valuestring);
+        } else if (cJSON_IsString(species)) {
+            compiled.scope = RULE_SCOPE_SPECIES;
+            compiled.key = rule_key(species->valuestring);
+        } else {
+            ESP_LOGW(TAG, "Rule without \"animal\" or \"species\" ignored");
+            continue;
+        }
+        for (int k = 0; k < ALERT_KIND_COUNT; k++) {
+            const cJSON *days = cJSON_GetObjectItem(rule, s_kind_names[k]);
+            if (!cJSON_IsNumber(days) || days->valuedouble < 0) continue;
+            compiled.kind = (uint8_t)k;
+            compiled.order = (uint16_t)s_rule_count;
+            compiled.seconds = (uint32_t)(days->valuedouble * ALERT_DAY_S);
+            s_rules[s_rule_count++] = compiled;
+        }
+    }
+    cJSON_Delete(root);
+
+    // Keep only the last rule of each (scope, key, kind)
+    qsort(s_rules, s_rule_count, sizeof(alert_rule_t), cmp_rule_order);
+    size_t unique = 0;
+    for (size_t i = 0; i < s_rule_count; i++) {
+        if (unique > 0 && cmp_rule(&s_rules[unique - 1], &s_rules[i]) == 0) unique--;
+        s_rules[unique++] = s_rules[i];
+    }
+    s_rule_count = unique;
+    ESP_LOGI(TAG, "%u alert rules compiled from %s", (unsigned)s_rule_count, ALERT_RULES_FILE);
+}
+
+// =============================================================================
+// Min-heap on due time
+// =============================================================================
+
+static void heap_set(size_t pos, int32_t item) {
+    s_heap[pos] = item;
+    s_items[item].heap_pos = (int32_t)pos;
+}
+
+static void heap_sift_up(size_t pos) {
+    int32_t item = s_heap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (s_items[s_heap[parent]].due <= s_items[item].due) break;
+        heap_set(pos, s_heap[parent]);
+        pos = parent;
+    }
+    heap_set(pos, item);
+}
+
+static void heap_sift_down(size_t pos) {
+    int32_t item = s_heap[pos];
+    for (;;) {
+        size_t child = 2 * pos + 1;
+        if (child >= s_heap_len) break;
+        if (child + 1 < s_heap_len && s_items[s_heap[child + 1]].due < s_items[s_heap[child]].due) child++;
+        if (s_items[item].due <= s_items[s_heap[child]].due) break;
+        heap_set(pos, s_heap[child]);
+        pos = child;
+    }
+    heap_set(pos, item);
+}
+
+static void heap_push(int32_t item) {
+    s_heap[s_heap_len] = item;
+    s_items[item].heap_pos = (int32_t)s_heap_len;
+    s_heap_len++;
+    heap_sift_up(s_heap_len - 1);
+}
+
+static void heap_remove(int32_t item) {
+    size_t pos = (size_t)s_items[item].heap_pos;
+    s_items[item].heap_pos = -1;
+    s_heap_len--;
+    if (pos == s_heap_len) return;
+    int32_t moved = s_heap[s_heap_len];
+    heap_set(pos, moved);
+    heap_sift_up(pos);
+    heap_sift_down((size_t)s_items[moved].heap_pos);
+}
+
+// =============================================================================
+// Overdue list
+// =============================================================================
+
+static void overdue_push(int32_t item) {
+    s_items[item].overdue_pos = (int32_t)s_overdue_len;
+    s_overdue[s_overdue_len++] = item;
+}
+
+static void overdue_remove(int32_t item) {
+    size_t pos = (size_t)s_items[item].overdue_pos;
+    s_items[item].overdue_pos = -1;
+    int32_t last = s_overdue[--s_overdue_len];
+    if (pos == s_overdue_len) return;
+    s_overdue[pos] = last;
+    s_items[last].overdue_pos = (int32_t)pos;
+}
+
+// =============================================================================
+// Scheduling
+// =============================================================================
+
+static void alerts_arm_timer(uint32_t now) {
+    if (!s_timer) return;
+    esp_timer_stop(s_timer); // Not running is fine
+    if (s_heap_len == 0) return;
+    uint32_t due = s_items[s_heap[0]].due;
+    uint64_t delay_us = (due > now) ? (uint64_t)(due - now) * 1000000ULL : 0;
+    esp_timer_start_once(s_timer, delay_us);
+}
+
+// Move every pending item whose due time has passed to the overdue list
+static void alerts_advance(uint32_t now) {
+    while (s_heap_len > 0 && s_items[s_heap[0]].due <= now) {
+        int32_t item = s_heap[0];
+        heap_remove(item);
+        overdue_push(item);
+        ESP_LOGI(TAG, "%s: %s alert due", s_subjects[s_items[item].subject].label,
+                 s_kind_names[s_items[item].kind]);
+    }
+}
+
+static void item_unschedule(int32_t item) {
+    if (s_items[item].heap_pos >= 0) heap_remove(item);
+    if (s_items[item].overdue_pos >= 0) overdue_remove(item);
+}
+
+// (Re)file one item after its last date or its rule changed
+static void item_place(int32_t item, uint32_t now) {
+    alert_item_t *it = &s_items[item];
+    item_unschedule(item);
+    if (it->interval == 0) return;
+
+    if (it->kind == ALERT_KIND_DOCUMENT) {
+        if (it->last == 0) return; // Permanent document
+        it->due = (it->last > it->interval) ? it->last - it->interval : 0;
+    } else {
+        // Never recorded counts as overdue right away
+        it->due = it->last ? it->last + it->interval : 0;
+    }
+    if (it->due <= now) overdue_push(item);
+    else heap_push(item);
+}
+
+static int32_t subject_add(const char *id, bool is_document) {
+    int32_t items = is_document ? 1 : ALERT_EVENT_KINDS;
+    if (subjects_reserve(s_subject_count + 1) != ESP_OK ||
+        items_reserve(s_item_count + items) != ESP_OK) {
+        ESP_LOGE(TAG, "Out of memory tracking %s", id);
+        return -1;
+    }
+    int32_t subject = (int32_t)s_subject_count++;
+    alert_subject_t *s = &s_subjects[subject];
+    memset(s, 0, sizeof(*s));
+    strlcpy(s->id, id, sizeof(s->id));
+    s->id_key = rule_key(id);
+    s->is_document = is_document;
+    s->first_item = (int32_t)s_item_count;
+    for (int32_t k = 0; k < items; k++) {
+        alert_item_t *it = &s_items[s_item_count++];
+        memset(it, 0, sizeof(*it));
+        it->subject = subject;
+        it->kind = is_document ? ALERT_KIND_DOCUMENT : (uint8_t)k;
+        it->heap_pos = -1;
+        it->overdue_pos = -1;
+    }
+    return subject;
+}
+
+static void alerts_timer_cb(void *arg) {
+    (void)arg;
+    uint32_t now = (uint32_t)time(NULL);
+    alerts_lock();
+    alerts_advance(now);
+    alerts_arm_timer(now);
+    alerts_unlock();
+}
+
+// =============================================================================
+// Internal API
+// =============================================================================
+
+esp_err_t core_alerts_init(void) {
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+    if (!s_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = alerts_timer_cb,
+            .name = "core_alerts",
+        };
+        esp_err_t ret = esp_timer_create(&args, &s_timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create alert timer: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    alerts_lock();
+    rules_compile();
+    alerts_unlock();
+    return ESP_OK;
+}
+
+void core_alerts_clear(void) {
+    alerts_lock();
+    s_subject_count = 0;
+    s_item_count = 0;
+    s_heap_len = 0;
+    s_overdue_len = 0;
+    if (s_timer) esp_timer_stop(s_timer);
+    alerts_unlock();
+}
+
+void core_alerts_track(const animal_t *animal, const uint32_t last_event[CORE_EVENT_TYPE_COUNT]) {
+    uint32_t now = (uint32_t)time(NULL);
+    alerts_lock();
+    int32_t subject = subject_find(animal->id, false);
+    if (subject < 0) subject = subject_add(animal->id, false);
+    if (subject < 0) { alerts_unlock(); return; }
+
+    alert_subject_t *s = &s_subjects[subject];
+    strlcpy(s->label, animal->name, sizeof(s->label));
+    s->species_key = rule_key(animal->species);
+    // Deleted animals keep their slot but raise no alert
+    s->inactive = animal->is_deleted;
+    for (int k = 0; k < ALERT_EVENT_KINDS; k++) {
+        alert_item_t *it = &s_items[s->first_item + k];
+        it->last = last_event[k];
+        it->interval = rule_resolve(s, (alert_kind_t)k);
+        if (s->inactive) item_unschedule(s->first_item + k);
+        else item_place(s->first_item + k, now);
+    }
+    alerts_arm_timer(now);
+    alerts_unlock();
+}
+
+void core_alerts_note_event(const char *animal_id, event_type_t type, uint32_t date) {
+    if ((unsigned)type >= ALERT_EVENT_KINDS) return;
+    uint32_t now = (uint32_t)time(NULL);
+    alerts_lock();
+    int32_t subject = subject_find(animal_id, false);
+    if (subject >= 0) {
+        int32_t item = s_subjects[subject].first_item + type;
+        alert_item_t *it = &s_items[item];
+        if (date > it->last) {
+            it->last = date;
+            if (!s_subjects[subject].inactive) {
+                item_place(item, now);
+                alerts_arm_timer(now);
+            }
+        }
+    }
+    alerts_unlock();
+}
+
+void core_alerts_track_document(const document_t *doc) {
+    uint32_t now = (uint32_t)time(NULL);
+    alerts_lock();
+    int32_t subject = subject_find(doc->id, true);
+    if (subject < 0) subject = subject_add(doc->id, true);
+    if (subject < 0) { alerts_unlock(); return; }
+
+    alert_subject_t *s = &s_subjects[subject];
+    snprintf(s->label, sizeof(s->label), "%s %s", doc->type, doc->ref_number);
+    s->inactive = false;
+    // Per-animal rules also apply to the documents linked to that animal
+    s->id_key = doc->linked_animal_id[0] ? rule_key(doc->linked_animal_id) : rule_key(doc->id);
+    alert_item_t *it = &s_items[s->first_item];
+    it->last = doc->date_expire;
+    it->interval = rule_resolve(s, ALERT_KIND_DOCUMENT);
+    item_place(s->first_item, now);
+    alerts_arm_timer(now);
+    alerts_unlock();
+}
+
+void core_alerts_forget_document(const char *doc_id) {
+    alerts_lock();
+    int32_t subject = subject_find(doc_id, true);
+    if (subject >= 0) {
+        // The slot is kept, like a deleted animal's
+        s_subjects[subject].inactive = true;
+        item_unschedule(s_subjects[subject].first_item);
+        alerts_arm_timer((uint32_t)time(NULL));
+    }
+    alerts_unlock();
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+esp_err_t core_alerts_reload_rules(void) {
+    uint32_t now = (uint32_t)time(NULL);
+    alerts_lock();
+    rules_compile();
+    // Re-resolve from the cached dates: no record is read back
+    for (size_t i = 0; i < s_item_count; i++) {
+        alert_item_t *it = &s_items[i];
+        const alert_subject_t *s = &s_subjects[it->subject];
+        it->interval = rule_resolve(s, (alert_kind_t)it->kind);
+        if (!s->inactive) item_place((int32_t)i, now);
+    }
+    alerts_arm_timer(now);
+    alerts_unlock();
+    return ESP_OK;
+}
+
+size_t core_get_alert_count(void) {
+    alerts_lock();
+    size_t count = s_overdue_len;
+    alerts_unlock();
+    return count;
+}
+
+static void format_alert(const alert_item_t *it, const char *label, uint32_t now, char *buf, size_t len) {
+    int days = it->last ? (int)((now - it->last) / ALERT_DAY_S) : -1;
+    switch (it->kind) {
+    case ALERT_KIND_FEEDING:
+        if (days < 0) snprintf(buf, len, "%s: Jamais nourri", label);
+        else snprintf(buf, len, "%s: Jeun de %d jours", label, days);
+        break;
+    case ALERT_KIND_SHEDDING:
+        if (days < 0) snprintf(buf, len, "%s: Aucune mue enregistrée", label);
+        else snprintf(buf, len, "%s: Pas de mue depuis %d jours", label, days);
+        break;
+    case ALERT_KIND_VET:
+        if (days < 0) snprintf(buf, len, "%s: Aucune visite vétérinaire", label);
+        else snprintf(buf, len, "%s: Visite vétérinaire il y a %d jours", label, days);
+        break;
+    case ALERT_KIND_CLEANING:
+        if (days < 0) snprintf(buf, len, "%s: Aucun nettoyage enregistré", label);
+        else snprintf(buf, len, "%s: Nettoyage il y a %d jours", label, days);
+        break;
+    default:
+        if (it->last <= now) snprintf(buf, len, "%s: Document expiré", label);
+        else snprintf(buf, len, "%s: Expire dans %d jours", label, (int)((it->last - now) / ALERT_DAY_S));
+        break;
+    }
+}
+
+esp_err_t core_get_alerts(char ***out_list, size_t *out_count) {
+    *out_list = NULL; *out_count = 0;
+    uint32_t now = (uint32_t)time(NULL);
+
+    alerts_lock();
+    // Catch up if the wall clock moved (e.g. SNTP) since the timer was armed
+    alerts_advance(now);
+    size_t count = s_overdue_len;
+    char **list = count ? calloc(count, sizeof(char *)) : NULL;
+    if (count && !list) { alerts_unlock(); return ESP_ERR_NO_MEM; }
+
+    for (size_t i = 0; i < count; i++) {
+        const alert_item_t *it = &s_items[s_overdue[i]];
+        char buf[128];
+        format_alert(it, s_subjects[it->subject].label, now, buf, sizeof(buf));
+        list[i] = strdup(buf);
+        if (!list[i]) {
+            alerts_unlock();
+            core_free_alert_list(list, count);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    alerts_unlock();
+
+    *out_list = list; *out_count = count;
+    return ESP_OK;
+}
+
+void core_free_alert_list(char **list, size_t count) {
+    if (list) {
+        for (size_t i = 0; i < count; i++) free(list[i]);
+        free(list);
+    }
+}
@@ -0,0 +1,137 @@
+#include "core_internal.h"
+#include "core_index.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Soft-deleted animals are moved, record and journal folded together, into
+// their own collection so that the live store, the boot scan and the
+// resident indexes stop paying for them. The archive uses the record format
+// of the live store and is only ever written to.
+#define ARCHIVE_FILE "archive.col"   // Under ANIMAL_DIR
+
+#define ARCHIVE_CLOCK_MIN 1577836800u // 2020-01-01: wall clock not set before that
+#define SECONDS_PER_DAY   86400u
+
+#if CONFIG_CORE_ARCHIVE_DELETED
+static const char *TAG = "CORE_ARCHIVE";
+
+static core_collection_t *s_archive = NULL;
+
+static core_collection_t *archive_open(void) {
+    if (s_archive) return s_archive;
+    char path[FILEPATH_BUF_LEN];
+    int n = snprintf(path, sizeof(path), "%s/" ARCHIVE_FILE, ANIMAL_DIR);
+    if (n < 0 || n >= (int)sizeof(path)) return NULL;
+    s_archive = core_collection_open(path);
+    if (!s_archive) ESP_LOGE(TAG, "Cannot open %s", path);
+    return s_archive;
+}
+
+// Held under the timeline lock, which every save and append takes: the
+// animal cannot change between the copy and the removal
+static esp_err_t archive_animal(const char *id, uint32_t cutoff, size_t *reclaimed) {
+    core_timeline_lock();
+    animal_t animal;
+    esp_err_t ret = core_load_animal(id, &animal, false);
+    if (ret != ESP_OK) goto done;
+    // Restored or re-deleted since the index was listed
+    if (!animal.is_deleted || animal.deleted_at >= cutoff) {
+        core_free_animal_content(&animal);
+        ret = ESP_ERR_INVALID_STATE;
+        goto done;
+    }
+    ret = core_record_write_collection(s_archive, &animal);
+    core_free_animal_content(&animal);
+
+    // Only drop the live copy once the archived one reads back cleanly
+    animal_t check;
+    if (ret == ESP_OK) ret = core_record_read_collection(s_archive, id, &check, true);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Archiving %s failed, record kept: %s", id, esp_err_to_name(ret));
+        goto done;
+    }
+    core_free_animal_content(&check);
+
+    size_t size = 0;
+    core_record_size(id, &size);
+    core_cache_forget(id);
+    ret = core_record_remove(id);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_FOUND) {
+        ESP_LOGE(TAG, "Cannot remove the record of %s: %s", id, esp_err_to_name(ret));
+        goto done;
+    }
+    core_journal_discard(id);
+    // The timeline finds the slot through the index: forget it first
+    core_timeline_forget(id);
+    core_index_remove(id);
+    *reclaimed += size;
+    ret = ESP_OK;
+
+done:
+    core_timeline_unlock();
+    return ret;
+}
+#endif
+
+esp_err_t core_archive_run(size_t *out_archived) {
+    if (out_archived) *out_archived = 0;
+#if CONFIG_CORE_ARCHIVE_DELETED
+    uint32_t now = (uint32_t)time(NULL);
+    if (now < ARCHIVE_CLOCK_MIN) {
+        ESP_LOGW(TAG, "Clock not set, archive pass skipped");
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t retention = (uint32_t)CONFIG_CORE_ARCHIVE_RETENTION_DAYS * SECONDS_PER_DAY;
+    // Deleted before the deletion date was recorded (deleted_at 0): expired
+    uint32_t cutoff = now - retention + 1;
+
+    animal_summary_t *list;
+    size_t count;
+    esp_err_t ret = core_index_list_deleted(cutoff, &list, &count);
+    if (ret != ESP_OK || count == 0) return ret;
+    if (!archive_open()) {
+        free(list);
+        return ESP_FAIL;
+    }
+
+    size_t archived = 0, reclaimed = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (archive_animal(list[i].id, cutoff, &reclaimed) == ESP_OK) archived++;
+        // Background work: let the UI and the network run between animals
+        vTaskDelay(1);
+    }
+    free(list);
+    ESP_LOGI(TAG, "Archived %u of %u deleted animals, %u bytes freed in the live store",
+             (unsigned)archived, (unsigned)count, (unsigned)reclaimed);
+    if (out_archived) *out_archived = archived;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+#if CONFIG_CORE_ARCHIVE_DELETED
+static void archive_task(void *arg) {
+    // The timeline build reads every record at boot: stay out of its way
+    while (!core_timeline_ready()) vTaskDelay(pdMS_TO_TICKS(5000));
+    for (;;) {
+        core_archive_run(NULL);
+        // One hour per delay keeps the tick count within TickType_t
+        for (int h = 0; h < CONFIG_CORE_ARCHIVE_INTERVAL_H; h++) vTaskDelay(pdMS_TO_TICKS(3600000));
+    }
+}
+#endif
+
+void core_archive_start(void) {
+#if CONFIG_CORE_ARCHIVE_DELETED
+    if (xTaskCreate(archive_task, "core_archive", 4096, NULL, 1, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "Archive task not started, deleted animals stay in the live store");
+    }
+#endif
+}
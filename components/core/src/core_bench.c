@@ -0,0 +1,283 @@
+#include "core_internal.h"
+#include "core_service.h"
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#ifndef CONFIG_CORE_BENCHMARK_HISTORY_LEN
+#define CONFIG_CORE_BENCHMARK_HISTORY_LEN 500
+#endif
+#ifndef CONFIG_CORE_BENCHMARK_ITERATIONS
+#define CONFIG_CORE_BENCHMARK_ITERATIONS 20
+#endif
+#ifndef CONFIG_CORE_BENCHMARK_COLLECTION_MAX
+#define CONFIG_CORE_BENCHMARK_COLLECTION_MAX 1000
+#endif
+
+static const char *TAG = "CORE_BENCH";
+
+#define BENCH_DIR "bench"   // Under storage_root()
+#define BENCH_COLLECTION_HISTORY 20
+#define BENCH_LOOKUPS 100
+
+static esp_err_t bench_fill_animal(animal_t *animal, size_t events) {
+    memset(animal, 0, sizeof(*animal));
+    strlcpy(animal->id, "00000000-0000-0000-0000-0000000bench", sizeof(animal->id));
+    strlcpy(animal->name, "Bench", sizeof(animal->name));
+    strlcpy(animal->species, "Python regius", sizeof(animal->species));
+    strlcpy(animal->origin, "CB", sizeof(animal->origin));
+    strlcpy(animal->registry_id, "BENCH-0001", sizeof(animal->registry_id));
+    animal->sex = SEX_FEMALE;
+    animal->dob = 1577836800;
+
+    size_t weights = events / 2;
+    if (weights) {
+        animal->weights = calloc(weights, sizeof(weight_record_t));
+        if (!animal->weights) return ESP_ERR_NO_MEM;
+        animal->weight_count = weights;
+    }
+    if (events) {
+        animal->events = calloc(events, sizeof(event_record_t));
+        if (!animal->events) { core_free_animal_content(animal); return ESP_ERR_NO_MEM; }
+        animal->event_count = events;
+    }
+    for (size_t i = 0; i < weights; i++) {
+        animal->weights[i].date = animal->dob + i * 7 * 24 * 3600;
+        animal->weights[i].value = 50.0f + i;
+        strlcpy(animal->weights[i].unit, "g", sizeof(animal->weights[i].unit));
+    }
+    for (size_t i = 0; i < events; i++) {
+        animal->events[i].date = animal->dob + i * 24 * 3600;
+        animal->events[i].type = (event_type_t)(i % EVENT_OTHER);
+        snprintf(animal->events[i].description, sizeof(animal->events[i].description), "Synthetic event %u", (unsigned)i);
+    }
+    return ESP_OK;
+}
+
+static void bench_report(const char *label, int64_t total_us) {
+    ESP_LOGI(TAG, "%-12s avg %lld us over %d runs", label,
+             (long long)(total_us / CONFIG_CORE_BENCHMARK_ITERATIONS), CONFIG_CORE_BENCHMARK_ITERATIONS);
+}
+
+// =============================================================================
+// Per-file layout versus packed collection
+// =============================================================================
+
+typedef struct {
+    int64_t create_us;      // Per animal
+    int64_t reopen_us;      // Boot cost before the first lookup
+    int64_t list_us;        // Every id and header
+    int64_t lookup_us;      // Per animal, history included
+} bench_layout_t;
+
+static void bench_id(char *buf, size_t len, uint32_t i) {
+    snprintf(buf, len, "%08x-0000-4000-8000-%012x", (unsigned)i, (unsigned)(i * 2654435761u));
+}
+
+// Deterministic spread of lookups over the whole population
+static uint32_t bench_pick(uint32_t *state, uint32_t count) {
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) % count;
+}
+
+static void bench_files(const char *dir, animal_t *animal, uint32_t count, bench_layout_t *out) {
+    char path[FILEPATH_BUF_LEN];
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        bench_id(animal->id, sizeof(animal->id), i);
+        snprintf(path, sizeof(path), "%s/%s.rec", dir, animal->id);
+        core_record_write_file(path, animal);
+    }
+    int64_t t1 = esp_timer_get_time();
+
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    while (d && (entry = readdir(d)) != NULL) {
+        if (!strstr(entry->d_name, ".rec")) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        animal_t loaded;
+        if (core_record_read_file(path, &loaded, false) == ESP_OK) core_free_animal_content(&loaded);
+    }
+    if (d) closedir(d);
+    int64_t t2 = esp_timer_get_time();
+
+    uint32_t seed = 1;
+    char id[37];
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        bench_id(id, sizeof(id), bench_pick(&seed, count));
+        snprintf(path, sizeof(path), "%s/%s.rec", dir, id);
+        animal_t loaded;
+        if (core_record_read_file(path, &loaded, true) == ESP_OK) core_free_animal_content(&loaded);
+    }
+    int64_t t3 = esp_timer_get_time();
+
+    out->create_us = (t1 - t0) / count;
+    out->reopen_us = 0;
+    out->list_us = t2 - t1;
+    out->lookup_us = (t3 - t2) / BENCH_LOOKUPS;
+
+    for (uint32_t i = 0; i < count; i++) {
+        bench_id(id, sizeof(id), i);
+        snprintf(path, sizeof(path), "%s/%s.rec", dir, id);
+        remove(path);
+    }
+}
+
+static bool bench_list_cb(const char *key, void *ctx) {
+    animal_t loaded;
+    if (core_record_read_collection(ctx, key, &loaded, false) == ESP_OK) core_free_animal_content(&loaded);
+    return true;
+}
+
+static void bench_collection(const char *path, animal_t *animal, uint32_t count, bench_layout_t *out) {
+    remove(path);
+    core_collection_t *c = core_collection_open(path);
+    if (!c) return;
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        bench_id(animal->id, sizeof(animal->id), i);
+        core_record_write_collection(c, animal);
+    }
+    // Reopening rebuilds the hash index from the slot pages
+    int64_t t1 = esp_timer_get_time();
+    core_collection_close(c);
+    c = core_collection_open(path);
+    int64_t t2 = esp_timer_get_time();
+    if (!c) return;
+
+    core_collection_foreach(c, bench_list_cb, c);
+    int64_t t3 = esp_timer_get_time();
+
+    uint32_t seed = 1;
+    char id[37];
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        bench_id(id, sizeof(id), bench_pick(&seed, count));
+        animal_t loaded;
+        if (core_record_read_collection(c, id, &loaded, true) == ESP_OK) core_free_animal_content(&loaded);
+    }
+    int64_t t4 = esp_timer_get_time();
+    core_collection_close(c);
+
+    out->create_us = (t1 - t0) / count;
+    out->reopen_us = t2 - t1;
+    out->list_us = t3 - t2;
+    out->lookup_us = (t4 - t3) / BENCH_LOOKUPS;
+    struct stat st;
+    if (stat(path, &st) == 0) ESP_LOGI(TAG, "collection of %u: %ld bytes", (unsigned)count, (long)st.st_size);
+    remove(path);
+}
+
+static void bench_layouts(const char *dir) {
+    static const uint32_t sizes[] = { 100, 1000, 10000 };
+    char files_dir[FILEPATH_BUF_LEN], col_path[FILEPATH_BUF_LEN];
+    snprintf(files_dir, sizeof(files_dir), "%s/files", dir);
+    snprintf(col_path, sizeof(col_path), "%s/bench.col", dir);
+    struct stat st = {0};
+    if (stat(files_dir, &st) == -1) mkdir(files_dir, 0700);
+
+    animal_t animal;
+    if (bench_fill_animal(&animal, BENCH_COLLECTION_HISTORY) != ESP_OK) return;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t count = sizes[i];
+        if (count > CONFIG_CORE_BENCHMARK_COLLECTION_MAX) break;
+        bench_layout_t files = {0}, packed = {0};
+        bench_files(files_dir, &animal, count, &files);
+        bench_collection(col_path, &animal, count, &packed);
+        ESP_LOGI(TAG, "%5u animals  files:      create %lld us  list %lld ms  lookup %lld us",
+                 (unsigned)count, (long long)files.create_us, (long long)(files.list_us / 1000),
+                 (long long)files.lookup_us);
+        ESP_LOGI(TAG, "%5u animals  collection: create %lld us  open %lld ms  list %lld ms  lookup %lld us",
+                 (unsigned)count, (long long)packed.create_us, (long long)(packed.reopen_us / 1000),
+                 (long long)(packed.list_us / 1000), (long long)packed.lookup_us);
+    }
+    core_free_animal_content(&animal);
+    rmdir(files_dir);
+}
+
+void core_bench_run(void) {
+    char dir[FILEPATH_BUF_LEN], json_path[FILEPATH_BUF_LEN], rec_path[FILEPATH_BUF_LEN];
+    if (storage_path(dir, sizeof(dir), BENCH_DIR) != ESP_OK) return;
+    snprintf(json_path, sizeof(json_path), "%s/bench.json", dir);
+    snprintf(rec_path, sizeof(rec_path), "%s/bench.rec", dir);
+    struct stat st = {0};
+    if (stat(dir, &st) == -1) mkdir(dir, 0700);
+
+    animal_t animal;
+    if (bench_fill_animal(&animal, CONFIG_CORE_BENCHMARK_HISTORY_LEN) != ESP_OK) {
+        ESP_LOGE(TAG, "Not enough memory for the synthetic record");
+        return;
+    }
+    ESP_LOGI(TAG, "Record benchmark: %u weights, %u events",
+             (unsigned)animal.weight_count, (unsigned)animal.event_count);
+
+    core_weight_series_t packed;
+    core_weight_series_init(&packed);
+    if (core_weight_series_encode(&packed, animal.weights, animal.weight_count) == ESP_OK) {
+        ESP_LOGI(TAG, "weights     %u bytes as rows, %u packed", (unsigned)(animal.weight_count * sizeof(weight_record_t)),
+                 (unsigned)packed.len);
+    }
+    core_weight_series_free(&packed);
+
+    int64_t json_save = 0, json_load = 0, json_stream = 0, json_summary = 0;
+    int64_t rec_save = 0, rec_load = 0, rec_summary = 0;
+    for (int i = 0; i < CONFIG_CORE_BENCHMARK_ITERATIONS; i++) {
+        int64_t t0 = esp_timer_get_time();
+        core_animal_save_json(json_path, &animal);
+        int64_t t1 = esp_timer_get_time();
+
+        animal_t loaded;
+        cJSON *root = storage_json_load(json_path);
+        if (root && core_animal_from_json(root, &loaded) == ESP_OK) core_free_animal_content(&loaded);
+        cJSON_Delete(root);
+        int64_t t2 = esp_timer_get_time();
+
+        // Pull parser: no file-sized buffer, no DOM
+        if (core_animal_load_json(json_path, &loaded, false) == ESP_OK) core_free_animal_content(&loaded);
+        int64_t t2_stream = esp_timer_get_time();
+
+        if (core_animal_load_json(json_path, &loaded, true) == ESP_OK) core_free_animal_content(&loaded);
+        int64_t t2_summary = esp_timer_get_time();
+        json_stream += t2_stream - t2;
+        json_summary += t2_summary - t2_stream;
+        t2 = t2_summary;
+
+        core_record_write_file(rec_path, &animal);
+        int64_t t3 = esp_timer_get_time();
+
+        if (core_record_read_file(rec_path, &loaded, true) == ESP_OK) core_free_animal_content(&loaded);
+        int64_t t4 = esp_timer_get_time();
+
+        if (core_record_read_file(rec_path, &loaded, false) == ESP_OK) core_free_animal_content(&loaded);
+        int64_t t5 = esp_timer_get_time();
+
+        json_save += t1 - t0;
+        json_load += t2 - t1;
+        rec_save += t3 - t2;
+        rec_load += t4 - t3;
+        rec_summary += t5 - t4;
+    }
+
+    bench_report("json save", json_save);
+    bench_report("json load", json_load);
+    bench_report("json stream", json_stream);
+    bench_report("json summary", json_summary);
+    bench_report("rec save", rec_save);
+    bench_report("rec load", rec_load);
+    bench_report("rec summary", rec_summary);
+
+    if (stat(json_path, &st) == 0) ESP_LOGI(TAG, "json size %ld bytes", (long)st.st_size);
+    if (stat(rec_path, &st) == 0) ESP_LOGI(TAG, "rec size  %ld bytes", (long)st.st_size);
+
+    core_free_animal_content(&animal);
+    remove(json_path);
+    remove(rec_path);
+    bench_layouts(dir);
+    rmdir(dir);
+}
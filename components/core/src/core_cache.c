@@ -0,0 +1,421 @@
+#include "core_service.h"
+#include "core_internal.h"
+#include "core_index.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CORE_CACHE";
+
+// Decoded animals (history included), most recently used kept. A dirty slot
+// holds a save that has not reached its .rec file yet; the journal on disk
+// still covers its history until the write-back folds it in. Weights are kept
+// packed, as in the record file: animal.weights stays NULL.
+typedef struct {
+    animal_t animal;
+    core_weight_series_t weights;
+    core_event_columns_t columns; // Built on the first event query
+    uint32_t last_use;
+    bool used;
+    bool dirty;
+} cache_slot_t;
+
+static cache_slot_t *s_slots = NULL;
+static size_t s_capacity = 0;
+static uint32_t s_clock = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_flush_task = NULL;
+static core_cache_stats_t s_stats;
+
+static void cache_lock(void) {
+    if (s_lock) xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+}
+
+static void cache_unlock(void) {
+    if (s_lock) xSemaphoreGiveRecursive(s_lock);
+}
+
+static void *cache_alloc(size_t size) {
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return ptr ? ptr : malloc(size);
+}
+
+static void *cache_realloc(void *ptr, size_t size) {
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return grown ? grown : realloc(ptr, size);
+}
+
+// Deep copy of everything but the weights; dst owns its events afterwards
+static esp_err_t copy_animal(animal_t *dst, const animal_t *src, bool with_history) {
+    *dst = *src;
+    dst->weights = NULL; dst->events = NULL;
+    dst->weight_count = 0; dst->event_count = 0;
+    if (!with_history) return ESP_OK;
+
+    if (src->event_count) {
+        dst->events = cache_alloc(src->event_count * sizeof(event_record_t));
+        if (!dst->events) { core_free_animal_content(dst); return ESP_ERR_NO_MEM; }
+        memcpy(dst->events, src->events, src->event_count * sizeof(event_record_t));
+        dst->event_count = src->event_count;
+    }
+    return ESP_OK;
+}
+
+static void release_slot(cache_slot_t *slot) {
+    core_free_animal_content(&slot->animal);
+    core_weight_series_free(&slot->weights);
+    core_event_columns_free(&slot->columns);
+    slot->used = false;
+    slot->dirty = false;
+}
+
+static cache_slot_t *find_slot(const char *id) {
+    for (size_t i = 0; i < s_capacity; i++) {
+        if (s_slots[i].used && strcmp(s_slots[i].animal.id, id) == 0) return &s_slots[i];
+    }
+    return NULL;
+}
+
+// The record write and the journal discard must not interleave with an
+// append, or the appended entry would be removed with the folded journal.
+// Callers hold the lock.
+static esp_err_t write_back(cache_slot_t *slot) {
+    esp_err_t ret = core_record_write_packed(&slot->animal, &slot->weights);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Write-back of %s failed: %s", slot->animal.id, esp_err_to_name(ret));
+        return ret;
+    }
+    core_journal_discard(slot->animal.id);
+    slot->dirty = false;
+    s_stats.writebacks++;
+    return ESP_OK;
+}
+
+// Free slot, else the least recently used one, written back first if dirty
+static cache_slot_t *claim_slot(void) {
+    cache_slot_t *victim = NULL;
+    for (size_t i = 0; i < s_capacity; i++) {
+        cache_slot_t *slot = &s_slots[i];
+        if (!slot->used) return slot;
+        if (!victim || slot->last_use < victim->last_use) victim = slot;
+    }
+    if (!victim) return NULL;
+    if (victim->dirty && write_back(victim) != ESP_OK) return NULL;
+    release_slot(victim);
+    s_stats.evictions++;
+    return victim;
+}
+
+static esp_err_t cache_insert(const animal_t *animal, bool dirty) {
+    // Only saves replace an existing entry, so its pending write-back is
+    // superseded by this one
+    cache_slot_t *slot = find_slot(animal->id);
+    if (slot) {
+        release_slot(slot);
+    } else {
+        slot = claim_slot();
+        if (!slot) return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = copy_animal(&slot->animal, animal, true);
+    if (ret == ESP_OK && animal->weights && animal->weight_count) {
+        ret = core_weight_series_encode(&slot->weights, animal->weights, animal->weight_count);
+    }
+    if (ret != ESP_OK) {
+        release_slot(slot);
+        return ret;
+    }
+    slot->used = true;
+    slot->dirty = dirty;
+    slot->last_use = ++s_clock;
+    return ESP_OK;
+}
+
+static void cache_flush_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Let a burst of saves (form, then compaction) land in one write
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_CORE_CACHE_WRITEBACK_MS));
+        core_cache_flush();
+    }
+}
+
+esp_err_t core_cache_init(void) {
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateRecursiveMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    s_capacity = CONFIG_CORE_CACHE_ENTRIES;
+    if (s_capacity) {
+        s_slots = heap_caps_calloc(s_capacity, sizeof(cache_slot_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!s_slots) s_slots = calloc(s_capacity, sizeof(cache_slot_t));
+        if (!s_slots) {
+            ESP_LOGW(TAG, "No memory for %u cached records, caching disabled", (unsigned)s_capacity);
+            s_capacity = 0;
+        }
+    }
+#if CONFIG_CORE_CACHE_WRITEBACK_MS > 0
+    if (s_capacity && xTaskCreate(cache_flush_task, "core_flush", 4096, NULL, 3, &s_flush_task) != pdPASS) {
+        ESP_LOGW(TAG, "Write-back task not started, saves are written through");
+        s_flush_task = NULL;
+    }
+#endif
+    ESP_LOGI(TAG, "Record cache: %u entries, write-back %s", (unsigned)s_capacity,
+             s_flush_task ? "on" : "off");
+    return ESP_OK;
+}
+
+esp_err_t core_cache_get(const char *id, animal_t *out, bool with_history) {
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (slot) {
+        slot->last_use = ++s_clock;
+        ret = copy_animal(out, &slot->animal, with_history);
+        if (ret == ESP_OK && with_history) {
+            ret = core_weight_series_decode(slot->weights.data, slot->weights.len, slot->weights.count,
+                                            &out->weights, &out->weight_count);
+            if (ret != ESP_OK) core_free_animal_content(out);
+        }
+        s_stats.hits++;
+    } else {
+        s_stats.misses++;
+    }
+    cache_unlock();
+    return ret;
+}
+
+void core_cache_fill(const animal_t *animal) {
+    if (!s_capacity) return;
+    cache_lock();
+    // An entry that appeared meanwhile is at least as new as the disk copy.
+    // A failed insert only costs a future miss.
+    if (!find_slot(animal->id)) cache_insert(animal, false);
+    cache_unlock();
+}
+
+esp_err_t core_cache_store(const animal_t *animal) {
+    cache_lock();
+    esp_err_t ret;
+    if (s_flush_task && cache_insert(animal, true) == ESP_OK) {
+        xTaskNotifyGive(s_flush_task);
+        ret = ESP_OK;
+    } else {
+        // Write-through: caching or the write-back task is unavailable
+        ret = core_record_write(animal);
+        if (ret == ESP_OK) {
+            core_journal_discard(animal->id);
+            if (s_capacity) cache_insert(animal, false);
+        }
+    }
+    cache_unlock();
+    return ret;
+}
+
+// Room for the mirrored entry is reserved before the journal append: a dirty
+// copy that missed an entry would drop it when its write-back discards the
+// journal. A clean copy that cannot grow is dropped instead.
+static bool reserve_history(cache_slot_t *slot, void **array, size_t count, size_t item_size) {
+    void *grown = cache_realloc(*array, (count + 1) * item_size);
+    if (grown) {
+        *array = grown;
+        return true;
+    }
+    if (slot->dirty) return false;
+    release_slot(slot);
+    return true;
+}
+
+esp_err_t core_cache_append_weight(const char *id, const weight_record_t *weight) {
+    int32_t mg;
+    if (core_weight_to_mg(weight->value, weight->unit, &mg) != ESP_OK) return ESP_ERR_INVALID_ARG;
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    bool reserved = slot && core_weight_series_reserve(&slot->weights, 1) == ESP_OK;
+    if (slot && !reserved && !slot->dirty) {
+        release_slot(slot);
+        slot = NULL;
+    }
+    if (!slot || reserved) {
+        ret = core_journal_append_weight(id, weight);
+        // Cannot fail: room was reserved above
+        if (ret == ESP_OK && slot) core_weight_series_append(&slot->weights, weight->date, mg);
+    }
+    cache_unlock();
+    return ret;
+}
+
+esp_err_t core_cache_foreach_weight(const char *id, core_weight_cb_t cb, void *ctx) {
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    if (!slot) {
+        cache_unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot->last_use = ++s_clock;
+    core_weight_iter_t it;
+    core_weight_iter_init(&it, slot->weights.data, slot->weights.len, slot->weights.count);
+    uint32_t date;
+    int32_t mg;
+    while (core_weight_iter_next(&it, &date, &mg) && cb(date, mg, ctx)) {
+    }
+    cache_unlock();
+    return ESP_OK;
+}
+
+esp_err_t core_cache_page_weights(const char *id, size_t offset, size_t limit, bool newest_first,
+                                  weight_record_t **out, size_t *out_count, size_t *out_total) {
+    *out = NULL;
+    *out_count = 0;
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    if (!slot) {
+        cache_unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot->last_use = ++s_clock;
+    *out_total = slot->weights.count;
+    size_t first;
+    size_t n = core_history_slice(slot->weights.count, offset, limit, newest_first, &first);
+    esp_err_t ret = ESP_OK;
+    weight_record_t *rows = n ? cache_alloc(n * sizeof(weight_record_t)) : NULL;
+    if (n && !rows) ret = ESP_ERR_NO_MEM;
+
+    core_weight_iter_t it;
+    core_weight_iter_init(&it, slot->weights.data, slot->weights.len, slot->weights.count);
+    uint32_t date;
+    int32_t mg;
+    for (size_t i = 0; rows && *out_count < n && core_weight_iter_next(&it, &date, &mg); i++) {
+        if (i < first) continue;
+        weight_record_t *w = &rows[(*out_count)++];
+        memset(w, 0, sizeof(*w));
+        w->date = date;
+        w->value = mg / 1000.0f;
+        w->unit[0] = 'g';
+    }
+    cache_unlock();
+    *out = rows;
+    return ret;
+}
+
+esp_err_t core_cache_page_events(const char *id, size_t offset, size_t limit, bool newest_first,
+                                 event_record_t **out, size_t *out_count, size_t *out_total) {
+    *out = NULL;
+    *out_count = 0;
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    if (!slot) {
+        cache_unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot->last_use = ++s_clock;
+    *out_total = slot->animal.event_count;
+    size_t first;
+    size_t n = core_history_slice(slot->animal.event_count, offset, limit, newest_first, &first);
+    esp_err_t ret = ESP_OK;
+    if (n) {
+        *out = cache_alloc(n * sizeof(event_record_t));
+        if (*out) {
+            memcpy(*out, &slot->animal.events[first], n * sizeof(event_record_t));
+            *out_count = n;
+        } else {
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    cache_unlock();
+    return ret;
+}
+
+esp_err_t core_cache_append_event(const char *id, const event_record_t *event) {
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (!slot || reserve_history(slot, (void **)&slot->animal.events,
+                                 slot->animal.event_count, sizeof(event_record_t))) {
+        ret = core_journal_append_event(id, event);
+        if (ret == ESP_OK && slot && slot->used) {
+            slot->animal.events[slot->animal.event_count++] = *event;
+        }
+    }
+    cache_unlock();
+    return ret;
+}
+
+esp_err_t core_cache_query_events(const char *id, const core_event_query_t *query, core_history_page_t *page) {
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    if (!slot) {
+        cache_unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot->last_use = ++s_clock;
+    esp_err_t ret = ESP_OK;
+    if (slot->columns.event_count != slot->animal.event_count || !slot->columns.dates) {
+        ret = core_event_columns_build(&slot->columns, slot->animal.events, slot->animal.event_count);
+    }
+    if (ret == ESP_OK) ret = core_event_columns_query(&slot->columns, slot->animal.events, query, page);
+    cache_unlock();
+    return ret;
+}
+
+bool core_cache_dirty(const char *id) {
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    bool dirty = slot && slot->dirty;
+    cache_unlock();
+    return dirty;
+}
+
+void core_cache_forget(const char *id) {
+    cache_lock();
+    cache_slot_t *slot = find_slot(id);
+    // A pending write-back would bring the record back
+    if (slot) release_slot(slot);
+    cache_unlock();
+}
+
+esp_err_t core_cache_flush(void) {
+    esp_err_t ret = ESP_OK;
+    // Lock order: a reader of the record and the journal holds the timeline
+    // lock, and must not see the journal folded in between its two reads
+    core_timeline_lock();
+    cache_lock();
+    for (size_t i = 0; i < s_capacity; i++) {
+        cache_slot_t *slot = &s_slots[i];
+        if (!slot->used || !slot->dirty) continue;
+        // Failed slots stay dirty and are retried on the next flush
+        esp_err_t err = write_back(slot);
+        if (err != ESP_OK) ret = err;
+    }
+    cache_unlock();
+    core_timeline_unlock();
+    return ret;
+}
+
+esp_err_t core_flush(void) {
+    esp_err_t ret = core_cache_flush();
+    esp_err_t index_ret = core_index_flush();
+    // The index goes through the commit queue: make it durable too
+    esp_err_t queue_ret = storage_commit_flush();
+    if (ret == ESP_OK) ret = index_ret;
+    return ret != ESP_OK ? ret : queue_ret;
+}
+
+void core_get_cache_stats(core_cache_stats_t *out_stats) {
+    if (!out_stats) return;
+    cache_lock();
+    *out_stats = s_stats;
+    out_stats->capacity = s_capacity;
+    out_stats->used = 0;
+    out_stats->dirty = 0;
+    for (size_t i = 0; i < s_capacity; i++) {
+        if (s_slots[i].used) out_stats->used++;
+        if (s_slots[i].used && s_slots[i].dirty) out_stats->dirty++;
+    }
+    cache_unlock();
+}
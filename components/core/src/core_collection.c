@@ -0,0 +1,783 @@
+#include "core_internal.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+#include "reptile_storage.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef CONFIG_CORE_COLLECTION_PAGE_CACHE
+#define CONFIG_CORE_COLLECTION_PAGE_CACHE 8
+#endif
+
+static const char *TAG = "CORE_COLLECTION";
+
+// File layout (little endian):
+//   pages 0-1  two copies of the superblock: directory of the slot segments
+//   segments   COLLECTION_SEGMENT_PAGES pages of fixed-size slots, one per key
+//   extents    the payload of each key, anywhere after the superblocks
+// Segments and extents are both allocated at the end of the file. Nothing
+// live is rewritten in place:
+// - the superblock copies are written alternately and the valid one with
+//   the highest sequence wins, so a torn write leaves the previous directory;
+// - a slot is one 512-byte sector. A put appends the new extent and writes
+//   a new slot carrying the next generation of the key, syncing each, and
+//   only then clears the old slot. After a power loss the open keeps the
+//   newer of two intact copies; a torn slot is always the copy being written
+//   or cleared, never the only one.
+// Superseded extents stay as dead space until compaction. Version 1 files
+// (a single superblock, slot pages from page 1) are rewritten on open.
+#define COLLECTION_MAGIC          0x4C4F4352u // "RCOL"
+#define COLLECTION_VERSION        2
+#define COLLECTION_SUPER_PAGES    2
+#define COLLECTION_PAGE_SIZE      4096
+#define COLLECTION_SLOT_SIZE      512
+#define COLLECTION_SLOTS_PER_PAGE (COLLECTION_PAGE_SIZE / COLLECTION_SLOT_SIZE)
+#define COLLECTION_SEGMENT_PAGES  16
+#define COLLECTION_SEGMENT_SLOTS  (COLLECTION_SEGMENT_PAGES * COLLECTION_SLOTS_PER_PAGE)
+#define COLLECTION_MAX_SEGMENTS   1016
+#define COLLECTION_SLOT_MAGIC     0x544F4C53u // "SLOT"
+// Compaction runs once dead extents outweigh live ones and exceed this
+#define COLLECTION_COMPACT_MIN    (256 * 1024)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t page_size;
+    uint16_t slot_size;
+    uint16_t segment_pages;
+    uint32_t segment_count;
+    uint32_t crc;                               // CRC32 of the page with this field zeroed
+    uint32_t sequence;                          // v2+: the valid copy with the highest wins
+    uint8_t reserved[8];
+    uint32_t segment_page[COLLECTION_MAX_SEGMENTS];
+} collection_super_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                             // COLLECTION_SLOT_MAGIC in use, 0 free
+    char key[CORE_COLLECTION_KEY_LEN];
+    uint8_t generation;                         // Bumped (mod 256) by each put of the key
+    uint16_t header_len;
+    uint32_t extent_offset;
+    uint32_t extent_len;
+    uint32_t crc;                               // CRC32 of the slot with this field zeroed
+    uint8_t header[CORE_COLLECTION_HEADER_MAX];
+} collection_slot_t;
+
+_Static_assert(sizeof(collection_super_t) == COLLECTION_PAGE_SIZE, "superblock is one page");
+_Static_assert(sizeof(collection_slot_t) == COLLECTION_SLOT_SIZE, "slot is one sector");
+
+// Open addressing, linear probing. Entries keep the key hash so probes only
+// read a slot on a full hash match.
+#define HASH_EMPTY     UINT32_MAX
+#define HASH_TOMBSTONE (UINT32_MAX - 1)
+
+typedef struct {
+    uint32_t hash;
+    uint32_t slot;
+} hash_entry_t;
+
+typedef struct {
+    uint32_t page;      // UINT32_MAX when unused
+    uint32_t used;      // LRU tick
+    uint8_t *data;
+} cached_page_t;
+
+struct core_collection {
+    FILE *f;
+    char *path;
+    SemaphoreHandle_t lock;
+    collection_super_t *super;
+    hash_entry_t *table;
+    size_t table_cap;
+    size_t table_used;  // Live entries and tombstones
+    uint32_t *free_slots;
+    size_t free_count;
+    size_t free_cap;
+    size_t count;
+    uint32_t file_end;
+    uint32_t live_bytes;
+    uint32_t tick;
+    cached_page_t cache[CONFIG_CORE_COLLECTION_PAGE_CACHE];
+};
+
+static void *coll_alloc(size_t size) {
+    void *p = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : calloc(1, size);
+}
+
+static void *coll_realloc(void *ptr, size_t size) {
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return grown ? grown : realloc(ptr, size);
+}
+
+static uint32_t key_hash(const char *key) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (; *key; key++) {
+        h ^= (uint8_t)*key;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t super_crc(const collection_super_t *sb) {
+    collection_super_t tmp = *sb;
+    tmp.crc = 0;
+    return esp_rom_crc32_le(0, (const uint8_t *)&tmp, sizeof(tmp));
+}
+
+// Checked on every slot read: computed in place, the crc field as zeroes
+static uint32_t slot_crc(const collection_slot_t *slot) {
+    static const uint8_t zero[sizeof(slot->crc)] = { 0 };
+    const uint8_t *p = (const uint8_t *)slot;
+    size_t at = offsetof(collection_slot_t, crc), after = at + sizeof(slot->crc);
+    uint32_t crc = esp_rom_crc32_le(0, p, at);
+    crc = esp_rom_crc32_le(crc, zero, sizeof(zero));
+    return esp_rom_crc32_le(crc, p + after, sizeof(*slot) - after);
+}
+
+static esp_err_t file_write_at(FILE *f, uint32_t offset, const void *data, size_t len, bool sync) {
+    if (fseek(f, offset, SEEK_SET) != 0 || fwrite(data, 1, len, f) != len) return ESP_FAIL;
+    if (fflush(f) != 0) return ESP_FAIL;
+    if (sync && fsync(fileno(f)) != 0) return ESP_FAIL;
+    return ESP_OK;
+}
+
+static esp_err_t file_read_at(FILE *f, uint32_t offset, void *data, size_t len) {
+    if (fseek(f, offset, SEEK_SET) != 0 || fread(data, 1, len, f) != len) return ESP_FAIL;
+    return ESP_OK;
+}
+
+// =============================================================================
+// Slot pages
+// =============================================================================
+
+static size_t slot_capacity(const core_collection_t *c) {
+    return (size_t)c->super->segment_count * COLLECTION_SEGMENT_SLOTS;
+}
+
+static uint32_t slot_page(const core_collection_t *c, uint32_t slot) {
+    return c->super->segment_page[slot / COLLECTION_SEGMENT_SLOTS] +
+           (slot % COLLECTION_SEGMENT_SLOTS) / COLLECTION_SLOTS_PER_PAGE;
+}
+
+static void cache_invalidate(core_collection_t *c) {
+    for (size_t i = 0; i < CONFIG_CORE_COLLECTION_PAGE_CACHE; i++) c->cache[i].page = UINT32_MAX;
+}
+
+// Slot page through the LRU page cache
+static const uint8_t *page_get(core_collection_t *c, uint32_t page) {
+    cached_page_t *victim = NULL;
+    for (size_t i = 0; i < CONFIG_CORE_COLLECTION_PAGE_CACHE; i++) {
+        cached_page_t *p = &c->cache[i];
+        if (p->page == page && p->data) {
+            p->used = ++c->tick;
+            return p->data;
+        }
+        if (!victim || p->page == UINT32_MAX || (victim->page != UINT32_MAX && p->used < victim->used)) {
+            victim = p;
+        }
+    }
+    if (!victim->data) victim->data = coll_alloc(COLLECTION_PAGE_SIZE);
+    if (!victim->data) return NULL;
+    victim->page = UINT32_MAX;
+    if (file_read_at(c->f, page * COLLECTION_PAGE_SIZE, victim->data, COLLECTION_PAGE_SIZE) != ESP_OK) {
+        return NULL;
+    }
+    victim->page = page;
+    victim->used = ++c->tick;
+    return victim->data;
+}
+
+// Slot in use and intact, NULL otherwise (pointer into the page cache)
+static const collection_slot_t *slot_get(core_collection_t *c, uint32_t slot) {
+    const uint8_t *page = page_get(c, slot_page(c, slot));
+    if (!page) return NULL;
+    const collection_slot_t *s =
+        (const collection_slot_t *)(page + (slot % COLLECTION_SLOTS_PER_PAGE) * COLLECTION_SLOT_SIZE);
+    return (s->magic == COLLECTION_SLOT_MAGIC && slot_crc(s) == s->crc) ? s : NULL;
+}
+
+static esp_err_t slot_put(core_collection_t *c, uint32_t slot, const collection_slot_t *s) {
+    uint32_t page = slot_page(c, slot);
+    size_t in_page = (slot % COLLECTION_SLOTS_PER_PAGE) * COLLECTION_SLOT_SIZE;
+    esp_err_t ret = file_write_at(c->f, page * COLLECTION_PAGE_SIZE + in_page, s, sizeof(*s), true);
+    for (size_t i = 0; i < CONFIG_CORE_COLLECTION_PAGE_CACHE; i++) {
+        cached_page_t *p = &c->cache[i];
+        if (p->page != page) continue;
+        // A failed write leaves the sector unknown: reload it next time
+        if (ret == ESP_OK) memcpy(p->data + in_page, s, sizeof(*s));
+        else p->page = UINT32_MAX;
+    }
+    return ret;
+}
+
+static esp_err_t free_push(core_collection_t *c, uint32_t slot) {
+    if (c->free_count == c->free_cap) {
+        size_t new_cap = c->free_cap ? c->free_cap * 2 : COLLECTION_SEGMENT_SLOTS;
+        uint32_t *grown = coll_realloc(c->free_slots, new_cap * sizeof(uint32_t));
+        if (!grown) return ESP_ERR_NO_MEM;
+        c->free_slots = grown;
+        c->free_cap = new_cap;
+    }
+    c->free_slots[c->free_count++] = slot;
+    return ESP_OK;
+}
+
+static uint32_t super_pages(const core_collection_t *c) {
+    return c->super->version == 1 ? 1 : COLLECTION_SUPER_PAGES;
+}
+
+// Into the copy not holding the current directory (a version 1 file has
+// only page 0, until the open rewrites it)
+static esp_err_t super_write(core_collection_t *c) {
+    c->super->sequence++;
+    c->super->crc = super_crc(c->super);
+    uint32_t page = super_pages(c) == 1 ? 0 : c->super->sequence % COLLECTION_SUPER_PAGES;
+    esp_err_t ret = file_write_at(c->f, page * COLLECTION_PAGE_SIZE, c->super, sizeof(*c->super), true);
+    if (ret != ESP_OK) c->super->sequence--;
+    return ret;
+}
+
+// Zeroed slot pages at the (page aligned) end of the file
+static esp_err_t segment_add(core_collection_t *c) {
+    if (c->super->segment_count >= COLLECTION_MAX_SEGMENTS) return ESP_ERR_NO_MEM;
+    uint32_t start = (c->file_end + COLLECTION_PAGE_SIZE - 1) / COLLECTION_PAGE_SIZE;
+    uint8_t *zero = coll_alloc(COLLECTION_PAGE_SIZE);
+    if (!zero) return ESP_ERR_NO_MEM;
+    esp_err_t ret = ESP_OK;
+    for (uint32_t i = 0; i < COLLECTION_SEGMENT_PAGES && ret == ESP_OK; i++) {
+        ret = file_write_at(c->f, (start + i) * COLLECTION_PAGE_SIZE, zero, COLLECTION_PAGE_SIZE,
+                            i + 1 == COLLECTION_SEGMENT_PAGES);
+    }
+    free(zero);
+    if (ret != ESP_OK) return ret;
+
+    uint32_t first_slot = c->super->segment_count * COLLECTION_SEGMENT_SLOTS;
+    c->super->segment_page[c->super->segment_count++] = start;
+    ret = super_write(c);
+    if (ret != ESP_OK) {
+        c->super->segment_count--;
+        return ret;
+    }
+    c->file_end = (start + COLLECTION_SEGMENT_PAGES) * COLLECTION_PAGE_SIZE;
+    // Lowest slot popped first
+    for (uint32_t i = COLLECTION_SEGMENT_SLOTS; i-- > 0;) {
+        if (free_push(c, first_slot + i) != ESP_OK) break;
+    }
+    return ESP_OK;
+}
+
+// =============================================================================
+// Hash index
+// =============================================================================
+
+static esp_err_t table_insert(core_collection_t *c, uint32_t hash, uint32_t slot);
+
+static esp_err_t table_grow(core_collection_t *c) {
+    size_t new_cap = c->table_cap ? c->table_cap * 2 : 256;
+    // Tombstones are dropped by the rehash: do not grow a mostly dead table
+    while (new_cap / 2 > 256 && c->count * 4 < new_cap) new_cap /= 2;
+    hash_entry_t *old = c->table;
+    size_t old_cap = c->table_cap;
+    hash_entry_t *table = coll_alloc(new_cap * sizeof(hash_entry_t));
+    if (!table) return ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < new_cap; i++) table[i].slot = HASH_EMPTY;
+    c->table = table;
+    c->table_cap = new_cap;
+    c->table_used = 0;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].slot < HASH_TOMBSTONE) table_insert(c, old[i].hash, old[i].slot);
+    }
+    free(old);
+    return ESP_OK;
+}
+
+static esp_err_t table_insert(core_collection_t *c, uint32_t hash, uint32_t slot) {
+    // Load factor stays below one half, tombstones included
+    if ((c->table_used + 1) * 2 > c->table_cap) {
+        esp_err_t ret = table_grow(c);
+        if (ret != ESP_OK) return ret;
+    }
+    size_t mask = c->table_cap - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (c->table[i].slot == HASH_EMPTY) {
+            c->table_used++;
+        } else if (c->table[i].slot != HASH_TOMBSTONE) {
+            continue;
+        }
+        c->table[i].hash = hash;
+        c->table[i].slot = slot;
+        return ESP_OK;
+    }
+}
+
+// Table position of key, or SIZE_MAX
+static size_t table_find(core_collection_t *c, const char *key) {
+    if (!c->table_cap) return SIZE_MAX;
+    uint32_t hash = key_hash(key);
+    size_t mask = c->table_cap - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const hash_entry_t *e = &c->table[i];
+        if (e->slot == HASH_EMPTY) return SIZE_MAX;
+        if (e->slot == HASH_TOMBSTONE || e->hash != hash) continue;
+        const collection_slot_t *s = slot_get(c, e->slot);
+        if (s && strncmp(s->key, key, sizeof(s->key)) == 0) return i;
+    }
+}
+
+static const collection_slot_t *find_slot(core_collection_t *c, const char *key, uint32_t *out_slot) {
+    size_t pos = table_find(c, key);
+    if (pos == SIZE_MAX) return NULL;
+    if (out_slot) *out_slot = c->table[pos].slot;
+    return slot_get(c, c->table[pos].slot);
+}
+
+// =============================================================================
+// Open / close
+// =============================================================================
+
+static esp_err_t collection_create(core_collection_t *c) {
+    memset(c->super, 0, sizeof(*c->super));
+    c->super->magic = COLLECTION_MAGIC;
+    c->super->version = COLLECTION_VERSION;
+    c->super->page_size = COLLECTION_PAGE_SIZE;
+    c->super->slot_size = COLLECTION_SLOT_SIZE;
+    c->super->segment_pages = COLLECTION_SEGMENT_PAGES;
+    c->file_end = COLLECTION_SUPER_PAGES * COLLECTION_PAGE_SIZE;
+    esp_err_t ret = ESP_OK;
+    for (uint32_t i = 0; i < COLLECTION_SUPER_PAGES && ret == ESP_OK; i++) ret = super_write(c);
+    return ret;
+}
+
+static bool super_valid(const collection_super_t *sb) {
+    return sb->magic == COLLECTION_MAGIC && super_crc(sb) == sb->crc;
+}
+
+// Newer of the two copies. Page 1 of a version 1 file is a slot page,
+// which never passes for a superblock.
+static esp_err_t super_load(core_collection_t *c) {
+    collection_super_t *other = coll_alloc(sizeof(collection_super_t));
+    if (!other) return ESP_ERR_NO_MEM;
+    bool first = file_read_at(c->f, 0, c->super, sizeof(*c->super)) == ESP_OK && super_valid(c->super);
+    bool second = file_read_at(c->f, COLLECTION_PAGE_SIZE, other, sizeof(*other)) == ESP_OK &&
+                  super_valid(other) && other->version >= 2;
+    if (first && c->super->version == 1) second = false;
+    if (second && (!first || other->sequence > c->super->sequence)) {
+        memcpy(c->super, other, sizeof(*other));
+        first = true;
+    }
+    free(other);
+    return first ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+// The copy of the newer generation: the put of b was cut after its new slot
+// was written, or the other way round
+static bool slot_newer(const collection_slot_t *a, const collection_slot_t *b) {
+    return (uint8_t)(a->generation - b->generation) == 1;
+}
+
+// Read the superblock, then every slot once to build the hash index
+static esp_err_t collection_load(core_collection_t *c) {
+    if (super_load(c) != ESP_OK) {
+        ESP_LOGE(TAG, "Not a collection file: %s", c->path);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (c->super->version < 1 || c->super->version > COLLECTION_VERSION ||
+        c->super->page_size != COLLECTION_PAGE_SIZE ||
+        c->super->slot_size != COLLECTION_SLOT_SIZE || c->super->segment_pages != COLLECTION_SEGMENT_PAGES ||
+        c->super->segment_count > COLLECTION_MAX_SEGMENTS) {
+        ESP_LOGE(TAG, "Unsupported collection layout in %s", c->path);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (fseek(c->f, 0, SEEK_END) != 0) return ESP_FAIL;
+    long end = ftell(c->f);
+    if (end < COLLECTION_PAGE_SIZE) return ESP_ERR_INVALID_SIZE;
+    c->file_end = (uint32_t)end;
+
+    uint8_t *page = coll_alloc(COLLECTION_PAGE_SIZE);
+    if (!page) return ESP_ERR_NO_MEM;
+    esp_err_t ret = ESP_OK;
+    size_t torn = 0, stale = 0;
+    // Scanned backwards so that the free stack pops the lowest slot first
+    for (size_t slot = slot_capacity(c); slot-- > 0 && ret == ESP_OK;) {
+        size_t in_page = slot % COLLECTION_SLOTS_PER_PAGE;
+        if (in_page == COLLECTION_SLOTS_PER_PAGE - 1 &&
+            file_read_at(c->f, slot_page(c, slot) * COLLECTION_PAGE_SIZE, page, COLLECTION_PAGE_SIZE) != ESP_OK) {
+            ret = ESP_FAIL;
+            break;
+        }
+        const collection_slot_t *s = (const collection_slot_t *)(page + in_page * COLLECTION_SLOT_SIZE);
+        bool used = s->magic == COLLECTION_SLOT_MAGIC;
+        if (used && (slot_crc(s) != s->crc || (uint64_t)s->extent_offset + s->extent_len > c->file_end)) {
+            // Only a torn write can do that: of a new copy or of a clear,
+            // both of which leave the key as it was before that put
+            // Cleared on disk too, or compaction would revive it as valid
+            collection_slot_t zero;
+            memset(&zero, 0, sizeof(zero));
+            slot_put(c, (uint32_t)slot, &zero);
+            torn++;
+            used = false;
+        }
+        if (!used) {
+            ret = free_push(c, (uint32_t)slot);
+            continue;
+        }
+        // Both copies of a cut put: keep the newer, clear the other
+        size_t pos = table_find(c, s->key);
+        if (pos != SIZE_MAX) {
+            uint32_t other = c->table[pos].slot;
+            const collection_slot_t *o = slot_get(c, other);
+            uint32_t drop = (o && !slot_newer(o, s)) ? other : (uint32_t)slot;
+            if (drop == other) {
+                c->live_bytes += s->extent_len - (o ? o->extent_len : 0);
+                c->table[pos].slot = (uint32_t)slot;
+            }
+            collection_slot_t zero;
+            memset(&zero, 0, sizeof(zero));
+            slot_put(c, drop, &zero);
+            ret = free_push(c, drop);
+            stale++;
+            continue;
+        }
+        ret = table_insert(c, key_hash(s->key), (uint32_t)slot);
+        if (ret == ESP_OK) {
+            c->count++;
+            c->live_bytes += s->extent_len;
+        }
+    }
+    free(page);
+    if (torn) ESP_LOGW(TAG, "%u damaged slots dropped from %s", (unsigned)torn, c->path);
+    if (stale) ESP_LOGW(TAG, "%u interrupted updates resolved in %s", (unsigned)stale, c->path);
+    return ret;
+}
+
+static esp_err_t compact_locked(core_collection_t *c);
+
+core_collection_t *core_collection_open(const char *path) {
+    core_collection_t *c = calloc(1, sizeof(core_collection_t));
+    if (!c) return NULL;
+    c->path = strdup(path);
+    c->lock = xSemaphoreCreateMutex();
+    c->super = coll_alloc(sizeof(collection_super_t));
+    cache_invalidate(c);
+    if (!c->path || !c->lock || !c->super) goto fail;
+
+    // A compaction cut between its remove and rename left only the temp
+    storage_file_recover(path);
+    c->f = fopen(path, "r+b");
+    esp_err_t ret;
+    if (c->f) {
+        ret = collection_load(c);
+    } else if (errno == ENOENT) {
+        c->f = fopen(path, "w+b");
+        if (!c->f) goto fail;
+        ret = collection_create(c);
+    } else {
+        // Out of file handles or an I/O error: never truncate the store
+        ESP_LOGE(TAG, "Cannot open %s: errno %d", path, errno);
+        goto fail;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open %s: %s", path, esp_err_to_name(ret));
+        goto fail;
+    }
+    // The rewrite lays out both superblock copies; until it succeeds the
+    // single one is updated in place, as before
+    if (c->super->version == 1 && compact_locked(c) != ESP_OK) {
+        ESP_LOGW(TAG, "Upgrade of %s failed, kept as version 1", path);
+    }
+    ESP_LOGI(TAG, "Collection %s: %u keys, %u KB", path, (unsigned)c->count, (unsigned)(c->file_end / 1024));
+    return c;
+
+fail:
+    core_collection_close(c);
+    return NULL;
+}
+
+void core_collection_close(core_collection_t *c) {
+    if (!c) return;
+    if (c->f) fclose(c->f);
+    for (size_t i = 0; i < CONFIG_CORE_COLLECTION_PAGE_CACHE; i++) free(c->cache[i].data);
+    if (c->lock) vSemaphoreDelete(c->lock);
+    free(c->super);
+    free(c->table);
+    free(c->free_slots);
+    free(c->path);
+    free(c);
+}
+
+// =============================================================================
+// Compaction
+// =============================================================================
+
+// Rewrite the file with segments first and extents packed behind them. Slot
+// numbers do not change, so the hash index stays valid.
+static esp_err_t compact_locked(core_collection_t *c) {
+    FILE *out = storage_file_begin_atomic(c->path);
+    if (!out) return ESP_FAIL;
+    size_t buf_cap = 0;
+    uint8_t *buf = storage_io_buf_borrow(&buf_cap);
+    uint8_t *page = coll_alloc(COLLECTION_PAGE_SIZE);
+    collection_super_t *sb = coll_alloc(sizeof(collection_super_t));
+    esp_err_t ret = (buf && page && sb) ? ESP_OK : ESP_ERR_NO_MEM;
+
+    uint32_t segments = c->super->segment_count;
+    uint32_t first_segment = COLLECTION_SUPER_PAGES;
+    uint32_t extent_pos = (first_segment + segments * COLLECTION_SEGMENT_PAGES) * COLLECTION_PAGE_SIZE;
+    if (ret == ESP_OK) {
+        *sb = *c->super;
+        sb->version = COLLECTION_VERSION;
+        sb->sequence++;
+        for (uint32_t i = 0; i < segments; i++) sb->segment_page[i] = first_segment + i * COLLECTION_SEGMENT_PAGES;
+        sb->crc = super_crc(sb);
+        for (uint32_t i = 0; i < COLLECTION_SUPER_PAGES && ret == ESP_OK; i++) {
+            if (fwrite(sb, 1, sizeof(*sb), out) != sizeof(*sb)) ret = ESP_FAIL;
+        }
+    }
+    // Slot pages, with the new extent offsets
+    uint32_t pos = extent_pos;
+    for (size_t slot = 0; ret == ESP_OK && slot < slot_capacity(c); slot++) {
+        size_t in_page = slot % COLLECTION_SLOTS_PER_PAGE;
+        if (in_page == 0) {
+            ret = file_read_at(c->f, slot_page(c, slot) * COLLECTION_PAGE_SIZE, page, COLLECTION_PAGE_SIZE);
+            if (ret != ESP_OK) break;
+        }
+        collection_slot_t *s = (collection_slot_t *)(page + in_page * COLLECTION_SLOT_SIZE);
+        // Only intact slots are carried over: a new CRC must not bless a torn one
+        if (s->magic == COLLECTION_SLOT_MAGIC && slot_crc(s) != s->crc) memset(s, 0, sizeof(*s));
+        if (s->magic == COLLECTION_SLOT_MAGIC && s->extent_len) {
+            s->extent_offset = pos;
+            s->crc = slot_crc(s);
+            pos += s->extent_len;
+        }
+        if (in_page == COLLECTION_SLOTS_PER_PAGE - 1 &&
+            fwrite(page, 1, COLLECTION_PAGE_SIZE, out) != COLLECTION_PAGE_SIZE) {
+            ret = ESP_FAIL;
+        }
+    }
+    // Extents, in slot order
+    for (size_t slot = 0; ret == ESP_OK && slot < slot_capacity(c); slot++) {
+        const collection_slot_t *s = slot_get(c, (uint32_t)slot);
+        if (!s || !s->extent_len) continue;
+        uint32_t src = s->extent_offset, left = s->extent_len;
+        while (ret == ESP_OK && left) {
+            size_t n = left < buf_cap ? left : buf_cap;
+            ret = file_read_at(c->f, src, buf, n);
+            if (ret == ESP_OK && fwrite(buf, 1, n, out) != n) ret = ESP_FAIL;
+            src += n;
+            left -= n;
+        }
+    }
+    if (buf) storage_io_buf_return(buf);
+    free(page);
+
+    // The old file must be closed before the new one replaces it
+    fclose(c->f);
+    c->f = NULL;
+    cache_invalidate(c);
+    esp_err_t end = storage_file_end_atomic(c->path, out, ret == ESP_OK);
+    if (ret == ESP_OK) ret = end;
+    c->f = fopen(c->path, "r+b");
+    if (!c->f) {
+        ESP_LOGE(TAG, "Cannot reopen %s after compaction", c->path);
+        free(sb);
+        return ESP_FAIL;
+    }
+    if (ret == ESP_OK) {
+        memcpy(c->super, sb, sizeof(*sb));
+        ESP_LOGI(TAG, "Compacted %s: %u -> %u KB", c->path, (unsigned)(c->file_end / 1024), (unsigned)(pos / 1024));
+        c->file_end = pos;
+    }
+    free(sb);
+    return ret;
+}
+
+static uint32_t dead_bytes(const core_collection_t *c) {
+    uint32_t fixed = (super_pages(c) + c->super->segment_count * COLLECTION_SEGMENT_PAGES) * COLLECTION_PAGE_SIZE;
+    uint32_t used = fixed + c->live_bytes;
+    return c->file_end > used ? c->file_end - used : 0;
+}
+
+esp_err_t core_collection_compact(core_collection_t *c) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    esp_err_t ret = compact_locked(c);
+    xSemaphoreGive(c->lock);
+    return ret;
+}
+
+// =============================================================================
+// Access
+// =============================================================================
+
+esp_err_t core_collection_put(core_collection_t *c, const char *key, const void *header, size_t header_len,
+                              const void *payload, size_t payload_len) {
+    if (!key || strlen(key) >= CORE_COLLECTION_KEY_LEN || header_len > CORE_COLLECTION_HEADER_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    size_t pos = table_find(c, key);
+    bool created = pos == SIZE_MAX;
+    uint32_t old_slot = created ? 0 : c->table[pos].slot;
+    // Copied out: the page cache entry may be evicted below
+    const collection_slot_t *old = created ? NULL : slot_get(c, old_slot);
+    uint32_t old_len = old ? old->extent_len : 0;
+    uint8_t generation = old ? (uint8_t)(old->generation + 1) : 0;
+    // Every put writes a fresh slot, the old one is cleared afterwards
+    esp_err_t ret = ESP_OK;
+    if (c->free_count == 0) ret = segment_add(c);
+    if (ret == ESP_OK && c->free_count == 0) ret = ESP_ERR_NO_MEM;
+    if (ret != ESP_OK) goto done;
+    uint32_t slot = c->free_slots[c->free_count - 1];
+
+    collection_slot_t s;
+    memset(&s, 0, sizeof(s));
+    s.magic = COLLECTION_SLOT_MAGIC;
+    strlcpy(s.key, key, sizeof(s.key));
+    s.generation = generation;
+    s.header_len = (uint16_t)header_len;
+    memcpy(s.header, header, header_len);
+    s.extent_len = (uint32_t)payload_len;
+    if (payload_len) {
+        // The extent is durable before the slot points at it
+        s.extent_offset = c->file_end;
+        ret = file_write_at(c->f, c->file_end, payload, payload_len, true);
+        if (ret != ESP_OK) goto done;
+        c->file_end += payload_len;
+    }
+    s.crc = slot_crc(&s);
+    ret = slot_put(c, slot, &s);
+    if (ret != ESP_OK) goto done;
+
+    c->live_bytes += (uint32_t)payload_len - old_len;
+    c->free_count--;
+    if (created) {
+        c->count++;
+        if (table_insert(c, key_hash(key), slot) != ESP_OK) {
+            // Found again by the scan of the next open
+            ESP_LOGW(TAG, "Out of memory indexing %s", key);
+        }
+    } else {
+        c->table[pos].slot = slot;
+        collection_slot_t zero;
+        memset(&zero, 0, sizeof(zero));
+        // A copy left behind is told apart by its generation at the next open
+        if (slot_put(c, old_slot, &zero) == ESP_OK) free_push(c, old_slot);
+        else ESP_LOGW(TAG, "Old copy of %s not cleared", key);
+    }
+    if (dead_bytes(c) > COLLECTION_COMPACT_MIN && dead_bytes(c) > c->live_bytes) {
+        if (compact_locked(c) != ESP_OK) ESP_LOGW(TAG, "Compaction of %s failed", c->path);
+    }
+
+done:
+    xSemaphoreGive(c->lock);
+    if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to store %s: %s", key, esp_err_to_name(ret));
+    return ret;
+}
+
+esp_err_t core_collection_get_header(core_collection_t *c, const char *key, void *header, size_t max,
+                                     size_t *out_len) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    const collection_slot_t *s = find_slot(c, key, NULL);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (s) {
+        *out_len = s->header_len < max ? s->header_len : max;
+        memcpy(header, s->header, *out_len);
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(c->lock);
+    return ret;
+}
+
+esp_err_t core_collection_read(core_collection_t *c, const char *key, size_t offset, void *buf, size_t len) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    const collection_slot_t *s = find_slot(c, key, NULL);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (s) {
+        if (offset > s->extent_len || len > s->extent_len - offset) {
+            ret = ESP_ERR_INVALID_SIZE;
+        } else {
+            ret = len ? file_read_at(c->f, s->extent_offset + offset, buf, len) : ESP_OK;
+        }
+    }
+    xSemaphoreGive(c->lock);
+    return ret;
+}
+
+esp_err_t core_collection_size(core_collection_t *c, const char *key, size_t *out_size) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    const collection_slot_t *s = find_slot(c, key, NULL);
+    if (s) *out_size = s->header_len + s->extent_len;
+    xSemaphoreGive(c->lock);
+    return s ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+bool core_collection_contains(core_collection_t *c, const char *key) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    bool found = table_find(c, key) != SIZE_MAX;
+    xSemaphoreGive(c->lock);
+    return found;
+}
+
+esp_err_t core_collection_remove(core_collection_t *c, const char *key) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    size_t pos = table_find(c, key);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (pos != SIZE_MAX) {
+        uint32_t slot = c->table[pos].slot;
+        const collection_slot_t *old = slot_get(c, slot);
+        uint32_t len = old ? old->extent_len : 0;
+        collection_slot_t s;
+        memset(&s, 0, sizeof(s));
+        ret = old ? slot_put(c, slot, &s) : ESP_FAIL;
+        if (ret == ESP_OK) {
+            c->table[pos].slot = HASH_TOMBSTONE;
+            c->live_bytes -= len;
+            c->count--;
+            free_push(c, slot);
+            if (dead_bytes(c) > COLLECTION_COMPACT_MIN && dead_bytes(c) > c->live_bytes &&
+                compact_locked(c) != ESP_OK) {
+                ESP_LOGW(TAG, "Compaction of %s failed", c->path);
+            }
+        }
+    }
+    xSemaphoreGive(c->lock);
+    return ret;
+}
+
+size_t core_collection_count(core_collection_t *c) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    size_t count = c->count;
+    xSemaphoreGive(c->lock);
+    return count;
+}
+
+esp_err_t core_collection_foreach(core_collection_t *c, core_collection_key_cb_t cb, void *ctx) {
+    // Keys are copied a page at a time so cb may call back into the collection
+    char keys[COLLECTION_SLOTS_PER_PAGE][CORE_COLLECTION_KEY_LEN];
+    for (size_t first = 0;; first += COLLECTION_SLOTS_PER_PAGE) {
+        xSemaphoreTake(c->lock, portMAX_DELAY);
+        if (first >= slot_capacity(c)) {
+            xSemaphoreGive(c->lock);
+            return ESP_OK;
+        }
+        size_t n = 0;
+        for (size_t i = 0; i < COLLECTION_SLOTS_PER_PAGE; i++) {
+            const collection_slot_t *s = slot_get(c, (uint32_t)(first + i));
+            if (s) memcpy(keys[n++], s->key, CORE_COLLECTION_KEY_LEN);
+        }
+        xSemaphoreGive(c->lock);
+        for (size_t i = 0; i < n; i++) {
+            keys[i][CORE_COLLECTION_KEY_LEN - 1] = '\0';
+            if (!cb(keys[i], ctx)) return ESP_OK;
+        }
+    }
+}
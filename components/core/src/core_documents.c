@@ -0,0 +1,336 @@
+#include "core_service.h"
+#include "core_internal.h"
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CORE_DOCS";
+
+// One collection key per document, the row as its header (no extent)
+#define DOCUMENT_FILE        "documents.col"   // Under storage_root()
+#define DOCUMENT_ROW_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    char id[37];
+    char type[32];
+    char ref_number[64];
+    uint32_t date_issued;
+    uint32_t date_expire;
+    char linked_animal_id[37];
+} document_row_t;
+
+_Static_assert(sizeof(document_row_t) <= CORE_COLLECTION_HEADER_MAX, "document row must fit a collection slot");
+
+// Every document stays resident. Slots are stable positions in s_docs (id
+// empty when free); both indexes are slot arrays kept sorted:
+//   s_by_animal  documents with a linked animal, by (linked_animal_id, id)
+//   s_by_expiry  documents with an expiry date, by (date_expire, id)
+// so "documents of X" and "expiring before D" are a binary search plus a
+// contiguous run.
+static SemaphoreHandle_t s_lock = NULL;
+static core_collection_t *s_store = NULL;
+static document_t *s_docs = NULL;
+static size_t s_slot_count = 0;
+static size_t s_capacity = 0;
+static uint32_t *s_free = NULL;
+static size_t s_free_count = 0;
+static uint32_t *s_by_animal = NULL;
+static size_t s_by_animal_len = 0;
+static uint32_t *s_by_expiry = NULL;
+static size_t s_by_expiry_len = 0;
+
+static void docs_lock(void) {
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void docs_unlock(void) {
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+static void *docs_realloc(void *ptr, size_t size) {
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return grown ? grown : realloc(ptr, size);
+}
+
+static esp_err_t docs_reserve(size_t wanted) {
+    if (wanted <= s_capacity) return ESP_OK;
+    size_t new_cap = s_capacity ? s_capacity * 2 : 32;
+    while (new_cap < wanted) new_cap *= 2;
+    document_t *docs = docs_realloc(s_docs, new_cap * sizeof(document_t));
+    if (!docs) return ESP_ERR_NO_MEM;
+    s_docs = docs;
+    // Free list and indexes can each hold every slot; grow them together
+    uint32_t *free_slots = docs_realloc(s_free, new_cap * sizeof(uint32_t));
+    if (!free_slots) return ESP_ERR_NO_MEM;
+    s_free = free_slots;
+    uint32_t *by_animal = docs_realloc(s_by_animal, new_cap * sizeof(uint32_t));
+    if (!by_animal) return ESP_ERR_NO_MEM;
+    s_by_animal = by_animal;
+    uint32_t *by_expiry = docs_realloc(s_by_expiry, new_cap * sizeof(uint32_t));
+    if (!by_expiry) return ESP_ERR_NO_MEM;
+    s_by_expiry = by_expiry;
+    s_capacity = new_cap;
+    return ESP_OK;
+}
+
+// =============================================================================
+// Sorted indexes
+// =============================================================================
+
+static int animal_cmp(uint32_t a, uint32_t b) {
+    int c = strcmp(s_docs[a].linked_animal_id, s_docs[b].linked_animal_id);
+    return c ? c : strcmp(s_docs[a].id, s_docs[b].id);
+}
+
+static int expiry_cmp(uint32_t a, uint32_t b) {
+    uint32_t da = s_docs[a].date_expire, db = s_docs[b].date_expire;
+    if (da != db) return da < db ? -1 : 1;
+    return strcmp(s_docs[a].id, s_docs[b].id);
+}
+
+// First position whose entry is not below slot
+static size_t index_bound(const uint32_t *index, size_t len, uint32_t slot, int (*cmp)(uint32_t, uint32_t)) {
+    size_t lo = 0, hi = len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cmp(index[mid], slot) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void index_insert(uint32_t *index, size_t *len, uint32_t slot, int (*cmp)(uint32_t, uint32_t)) {
+    size_t pos = index_bound(index, *len, slot, cmp);
+    memmove(&index[pos + 1], &index[pos], (*len - pos) * sizeof(uint32_t));
+    index[pos] = slot;
+    (*len)++;
+}
+
+static void index_remove(uint32_t *index, size_t *len, uint32_t slot, int (*cmp)(uint32_t, uint32_t)) {
+    size_t pos = index_bound(index, *len, slot, cmp);
+    if (pos >= *len || index[pos] != slot) return;
+    memmove(&index[pos], &index[pos + 1], (*len - pos - 1) * sizeof(uint32_t));
+    (*len)--;
+}
+
+static void slot_index(uint32_t slot) {
+    if (s_docs[slot].linked_animal_id[0]) index_insert(s_by_animal, &s_by_animal_len, slot, animal_cmp);
+    if (s_docs[slot].date_expire) index_insert(s_by_expiry, &s_by_expiry_len, slot, expiry_cmp);
+}
+
+// Must run before the keys of the slot change
+static void slot_unindex(uint32_t slot) {
+    if (s_docs[slot].linked_animal_id[0]) index_remove(s_by_animal, &s_by_animal_len, slot, animal_cmp);
+    if (s_docs[slot].date_expire) index_remove(s_by_expiry, &s_by_expiry_len, slot, expiry_cmp);
+}
+
+static int32_t slot_find(const char *id) {
+    for (size_t i = 0; i < s_slot_count; i++) {
+        if (s_docs[i].id[0] && strcmp(s_docs[i].id, id) == 0) return (int32_t)i;
+    }
+    return -1;
+}
+
+// Insert or refresh the resident copy of doc (caller holds the lock)
+static esp_err_t docs_put_locked(const document_t *doc) {
+    int32_t slot = slot_find(doc->id);
+    if (slot >= 0) {
+        slot_unindex((uint32_t)slot);
+    } else {
+        esp_err_t ret = docs_reserve(s_slot_count + 1);
+        if (ret != ESP_OK) return ret;
+        slot = s_free_count ? (int32_t)s_free[--s_free_count] : (int32_t)s_slot_count++;
+    }
+    s_docs[slot] = *doc;
+    s_docs[slot].id[sizeof(doc->id) - 1] = '\0';
+    s_docs[slot].linked_animal_id[sizeof(doc->linked_animal_id) - 1] = '\0';
+    slot_index((uint32_t)slot);
+    return ESP_OK;
+}
+
+static esp_err_t copy_run(const uint32_t *index, size_t first, size_t last, document_t **out_list, size_t *out_count) {
+    size_t count = last - first;
+    if (count == 0) return ESP_OK;
+    document_t *list = malloc(count * sizeof(document_t));
+    if (!list) return ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < count; i++) list[i] = s_docs[index[first + i]];
+    *out_list = list;
+    *out_count = count;
+    return ESP_OK;
+}
+
+// =============================================================================
+// Storage
+// =============================================================================
+
+static void row_from_document(document_row_t *row, const document_t *doc) {
+    memset(row, 0, sizeof(*row));
+    row->version = DOCUMENT_ROW_VERSION;
+    strlcpy(row->id, doc->id, sizeof(row->id));
+    strlcpy(row->type, doc->type, sizeof(row->type));
+    strlcpy(row->ref_number, doc->ref_number, sizeof(row->ref_number));
+    row->date_issued = doc->date_issued;
+    row->date_expire = doc->date_expire;
+    strlcpy(row->linked_animal_id, doc->linked_animal_id, sizeof(row->linked_animal_id));
+}
+
+static bool load_document(const char *key, void *ctx) {
+    size_t *loaded = ctx;
+    document_row_t row;
+    size_t len = 0;
+    if (core_collection_get_header(s_store, key, &row, sizeof(row), &len) != ESP_OK) return true;
+    if (len < sizeof(row) || row.version != DOCUMENT_ROW_VERSION) {
+        ESP_LOGW(TAG, "Skipping unreadable document %s", key);
+        return true;
+    }
+    document_t doc;
+    memset(&doc, 0, sizeof(doc));
+    strlcpy(doc.id, key, sizeof(doc.id));
+    memcpy(doc.type, row.type, sizeof(doc.type));
+    doc.type[sizeof(doc.type) - 1] = '\0';
+    memcpy(doc.ref_number, row.ref_number, sizeof(doc.ref_number));
+    doc.ref_number[sizeof(doc.ref_number) - 1] = '\0';
+    doc.date_issued = row.date_issued;
+    doc.date_expire = row.date_expire;
+    memcpy(doc.linked_animal_id, row.linked_animal_id, sizeof(doc.linked_animal_id));
+    if (docs_put_locked(&doc) == ESP_OK) (*loaded)++;
+    return true;
+}
+
+esp_err_t core_documents_init(void) {
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t core_documents_load(void) {
+    char path[FILEPATH_BUF_LEN];
+    esp_err_t ret = storage_path(path, sizeof(path), DOCUMENT_FILE);
+    if (ret != ESP_OK) return ret;
+
+    docs_lock();
+    if (!s_store) s_store = core_collection_open(path);
+    if (!s_store) {
+        docs_unlock();
+        return ESP_FAIL;
+    }
+    s_slot_count = 0;
+    s_free_count = 0;
+    s_by_animal_len = 0;
+    s_by_expiry_len = 0;
+    size_t loaded = 0;
+    core_collection_foreach(s_store, load_document, &loaded);
+    docs_unlock();
+
+    // Seed the alert engine from the expiry index; permanent documents
+    // never raise an alert and are not in it
+    document_t *expiring = NULL;
+    size_t count = 0;
+    if (core_list_expiring_documents(0, UINT32_MAX, &expiring, &count) == ESP_OK) {
+        for (size_t i = 0; i < count; i++) core_alerts_track_document(&expiring[i]);
+        core_free_document_list(expiring);
+    }
+    ESP_LOGI(TAG, "Document store loaded: %u documents, %u expiring", (unsigned)loaded, (unsigned)count);
+    return ESP_OK;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+esp_err_t core_save_document(const document_t *doc) {
+    if (!doc || doc->id[0] == '\0' || strlen(doc->id) >= sizeof(doc->id)) return ESP_ERR_INVALID_ARG;
+    docs_lock();
+    if (!s_store) {
+        docs_unlock();
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    document_row_t row;
+    row_from_document(&row, doc);
+    // Durable first: the resident copy never runs ahead of the card
+    esp_err_t ret = core_collection_put(s_store, doc->id, &row, sizeof(row), NULL, 0);
+    if (ret == ESP_OK) ret = docs_put_locked(doc);
+    docs_unlock();
+    if (ret == ESP_OK) {
+        core_alerts_track_document(doc);
+        core_log_event(LOG_LEVEL_AUDIT, "CORE", "Document saved");
+    }
+    return ret;
+}
+
+esp_err_t core_delete_document(const char *id) {
+    if (!id || id[0] == '\0') return ESP_ERR_INVALID_ARG;
+    docs_lock();
+    int32_t slot = s_store ? slot_find(id) : -1;
+    esp_err_t ret = slot < 0 ? ESP_ERR_NOT_FOUND : core_collection_remove(s_store, id);
+    if (ret == ESP_OK) {
+        slot_unindex((uint32_t)slot);
+        s_docs[slot].id[0] = '\0';
+        s_free[s_free_count++] = (uint32_t)slot;
+    }
+    docs_unlock();
+    if (ret == ESP_OK) {
+        core_alerts_forget_document(id);
+        core_log_event(LOG_LEVEL_AUDIT, "CORE", "Document deleted");
+    }
+    return ret;
+}
+
+esp_err_t core_get_document(const char *id, document_t *out_doc) {
+    if (!id || !out_doc) return ESP_ERR_INVALID_ARG;
+    docs_lock();
+    int32_t slot = slot_find(id);
+    if (slot >= 0) *out_doc = s_docs[slot];
+    docs_unlock();
+    return slot >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t core_list_animal_documents(const char *animal_id, document_t **out_list, size_t *out_count) {
+    if (!animal_id || !out_list || !out_count) return ESP_ERR_INVALID_ARG;
+    *out_list = NULL;
+    *out_count = 0;
+    if (animal_id[0] == '\0') return ESP_OK;
+    docs_lock();
+    // Binary search for the first document of the animal, then walk its run
+    size_t lo = 0, hi = s_by_animal_len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(s_docs[s_by_animal[mid]].linked_animal_id, animal_id) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t last = lo;
+    while (last < s_by_animal_len && strcmp(s_docs[s_by_animal[last]].linked_animal_id, animal_id) == 0) last++;
+    esp_err_t ret = copy_run(s_by_animal, lo, last, out_list, out_count);
+    docs_unlock();
+    return ret;
+}
+
+esp_err_t core_list_expiring_documents(uint32_t from, uint32_t to, document_t **out_list, size_t *out_count) {
+    if (!out_list || !out_count) return ESP_ERR_INVALID_ARG;
+    *out_list = NULL;
+    *out_count = 0;
+    docs_lock();
+    size_t lo = 0, hi = s_by_expiry_len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (s_docs[s_by_expiry[mid]].date_expire < from) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t last = lo;
+    while (last < s_by_expiry_len && s_docs[s_by_expiry[last]].date_expire <= to) last++;
+    esp_err_t ret = copy_run(s_by_expiry, lo, last, out_list, out_count);
+    docs_unlock();
+    return ret;
+}
+
+void core_free_document_list(document_t *list) {
+    free(list);
+}
@@ -0,0 +1,132 @@
+#include "core_internal.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Per-type date columns over an event array: the events of each type are a
+// contiguous range of dates[]/rows[], ascending by date, so a type filter is
+// a slice and a date bound a binary search.
+
+typedef struct {
+    uint32_t date;
+    uint32_t row;
+} date_row_t;
+
+static int cmp_date_row(const void *a, const void *b) {
+    const date_row_t *x = a, *y = b;
+    if (x->date != y->date) return (x->date > y->date) - (x->date < y->date);
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+static void *columns_alloc(size_t size) {
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return ptr ? ptr : malloc(size);
+}
+
+void core_event_columns_init(core_event_columns_t *cols) {
+    memset(cols, 0, sizeof(*cols));
+}
+
+void core_event_columns_free(core_event_columns_t *cols) {
+    free(cols->dates);
+    free(cols->rows);
+    core_event_columns_init(cols);
+}
+
+esp_err_t core_event_columns_build(core_event_columns_t *cols, const event_record_t *events, size_t count) {
+    core_event_columns_free(cols);
+    if (count == 0) return ESP_OK;
+
+    date_row_t *pairs = columns_alloc(count * sizeof(date_row_t));
+    cols->dates = columns_alloc(count * sizeof(uint32_t));
+    cols->rows = columns_alloc(count * sizeof(uint32_t));
+    if (!pairs || !cols->dates || !cols->rows) {
+        free(pairs);
+        core_event_columns_free(cols);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Counting sort by type (unknown types count as EVENT_OTHER), then
+    // each type range by date. Appends are mostly in date order already.
+    size_t fill[CORE_EVENT_TYPE_COUNT] = {0};
+    for (size_t i = 0; i < count; i++) {
+        unsigned type = (unsigned)events[i].type < CORE_EVENT_TYPE_COUNT ? events[i].type : EVENT_OTHER;
+        cols->start[type + 1]++;
+    }
+    for (size_t t = 0; t < CORE_EVENT_TYPE_COUNT; t++) {
+        cols->start[t + 1] += cols->start[t];
+        fill[t] = cols->start[t];
+    }
+    for (size_t i = 0; i < count; i++) {
+        unsigned type = (unsigned)events[i].type < CORE_EVENT_TYPE_COUNT ? events[i].type : EVENT_OTHER;
+        pairs[fill[type]++] = (date_row_t){ .date = events[i].date, .row = (uint32_t)i };
+    }
+    for (size_t t = 0; t < CORE_EVENT_TYPE_COUNT; t++) {
+        size_t n = cols->start[t + 1] - cols->start[t];
+        if (n > 1) qsort(&pairs[cols->start[t]], n, sizeof(date_row_t), cmp_date_row);
+    }
+    for (size_t i = 0; i < count; i++) {
+        cols->dates[i] = pairs[i].date;
+        cols->rows[i] = pairs[i].row;
+    }
+    free(pairs);
+    cols->event_count = count;
+    return ESP_OK;
+}
+
+// First position in [lo, hi) whose date is >= key (or > key when after is set)
+static size_t date_bound(const uint32_t *dates, size_t lo, size_t hi, uint32_t key, bool after) {
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (dates[mid] < key || (after && dates[mid] == key)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+esp_err_t core_event_columns_query(const core_event_columns_t *cols, const event_record_t *events,
+                                   const core_event_query_t *query, core_history_page_t *page) {
+    // The matching slice of each selected type column
+    size_t begin[CORE_EVENT_TYPE_COUNT], end[CORE_EVENT_TYPE_COUNT];
+    size_t total = 0;
+    uint32_t types = query->types ? query->types : UINT32_MAX;
+    for (size_t t = 0; t < CORE_EVENT_TYPE_COUNT; t++) {
+        begin[t] = end[t] = 0;
+        if (!cols->dates || !(types & CORE_EVENT_MASK(t))) continue;
+        size_t lo = cols->start[t], hi = cols->start[t + 1];
+        begin[t] = query->from ? date_bound(cols->dates, lo, hi, query->from, false) : lo;
+        end[t] = query->to ? date_bound(cols->dates, begin[t], hi, query->to, true) : hi;
+        total += end[t] - begin[t];
+    }
+    page->total = total;
+    page->count = 0;
+    size_t n = total > query->offset ? total - query->offset : 0;
+    if (n > query->limit) n = query->limit;
+    if (n == 0) return ESP_OK;
+
+    page->events = columns_alloc(n * sizeof(event_record_t));
+    if (!page->events) return ESP_ERR_NO_MEM;
+
+    // Merge the slices by date, from the requested end, skipping offset
+    bool newest_first = query->order == CORE_HISTORY_NEWEST_FIRST;
+    size_t skip = query->offset;
+    while (page->count < n) {
+        int best = -1;
+        for (size_t t = 0; t < CORE_EVENT_TYPE_COUNT; t++) {
+            if (begin[t] == end[t]) continue;
+            size_t pos = newest_first ? end[t] - 1 : begin[t];
+            if (best < 0) { best = (int)t; continue; }
+            size_t best_pos = newest_first ? end[best] - 1 : begin[best];
+            if (newest_first ? cols->dates[pos] > cols->dates[best_pos] : cols->dates[pos] < cols->dates[best_pos]) {
+                best = (int)t;
+            }
+        }
+        size_t pos = newest_first ? --end[best] : begin[best]++;
+        if (skip) {
+            skip--;
+            continue;
+        }
+        page->events[page->count++] = events[cols->rows[pos]];
+    }
+    return ESP_OK;
+}
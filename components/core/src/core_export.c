@@ -1,12 +1,273 @@
 #include "core_export.h"
 #include "core_service.h"
+#include "core_internal.h"
 #include "core_models.h"
+#include "reptile_storage.h"
 #include "board.h"
+#include "esp_log.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CORE_EXPORT";
+
+void core_animal_write_json(storage_json_writer_t *w, const animal_t *animal)
+{
+    storage_json_begin_object(w, NULL);
+    storage_json_add_string(w, "id", animal->id);
+    storage_json_add_string(w, "name", animal->name);
+    storage_json_add_string(w, "species", animal->species);
+    storage_json_add_int(w, "sex", animal->sex);
+    storage_json_add_int(w, "dob", animal->dob);
+    storage_json_add_string(w, "origin", animal->origin);
+    storage_json_add_string(w, "registry_id", animal->registry_id);
+    storage_json_add_bool(w, "is_deleted", animal->is_deleted);
+    storage_json_add_int(w, "deleted_at", animal->deleted_at);
+
+    if (animal->weight_count > 0 && animal->weights) {
+        // Count hints let core_animal_read_json() size the arrays up front
+        storage_json_add_int(w, "weight_count", animal->weight_count);
+        storage_json_begin_array(w, "weights");
+        for (size_t i = 0; i < animal->weight_count; i++) {
+            storage_json_begin_object(w, NULL);
+            storage_json_add_int(w, "date", animal->weights[i].date);
+            storage_json_add_number(w, "value", animal->weights[i].value);
+            storage_json_add_string(w, "unit", animal->weights[i].unit);
+            storage_json_end_object(w);
+        }
+        storage_json_end_array(w);
+    }
+    if (animal->event_count > 0 && animal->events) {
+        storage_json_add_int(w, "event_count", animal->event_count);
+        storage_json_begin_array(w, "events");
+        for (size_t i = 0; i < animal->event_count; i++) {
+            storage_json_begin_object(w, NULL);
+            storage_json_add_int(w, "date", animal->events[i].date);
+            storage_json_add_int(w, "type", animal->events[i].type);
+            storage_json_add_string(w, "desc", animal->events[i].description);
+            storage_json_end_object(w);
+        }
+        storage_json_end_array(w);
+    }
+    storage_json_end_object(w);
+}
+
+esp_err_t core_animal_save_json(const char *filename, const animal_t *animal)
+{
+    storage_json_writer_t *w = storage_json_writer_open_file(filename);
+    if (!w) return ESP_FAIL;
+    core_animal_write_json(w, animal);
+    return storage_json_writer_close(w);
+}
+
+static void read_str(storage_json_reader_t *r, char *dst, size_t len)
+{
+    if (storage_json_next(r) == STORAGE_JSON_STRING) strlcpy(dst, storage_json_text(r), len);
+}
+
+static double read_num(storage_json_reader_t *r)
+{
+    storage_json_token_t t = storage_json_next(r);
+    if (t == STORAGE_JSON_TRUE) return 1;
+    return t == STORAGE_JSON_NUMBER ? storage_json_number(r) : 0;
+}
+
+// Count hints come from the imported file: past this, arrays grow on demand
+#define HISTORY_HINT_MAX 1024
+
+// Grow one history array to hold index i; the count hint makes this a no-op
+static bool history_reserve(void **array, size_t *cap, size_t i, size_t item_size)
+{
+    if (i < *cap) return true;
+    size_t new_cap = *cap ? *cap : 16;
+    while (new_cap <= i) new_cap *= 2;
+    void *grown = realloc(*array, new_cap * item_size);
+    if (!grown) return false;
+    memset((char *)grown + *cap * item_size, 0, (new_cap - *cap) * item_size);
+    *array = grown;
+    *cap = new_cap;
+    return true;
+}
+
+static size_t history_hint(double n)
+{
+    return n > 0 && n <= HISTORY_HINT_MAX ? (size_t)n : 0;
+}
+
+static esp_err_t read_weights(storage_json_reader_t *r, animal_t *a, size_t hint)
+{
+    if (storage_json_next(r) != STORAGE_JSON_ARRAY_BEGIN) return ESP_ERR_INVALID_RESPONSE;
+    size_t cap = 0;
+    if (hint && !history_reserve((void **)&a->weights, &cap, hint - 1, sizeof(weight_record_t))) return ESP_ERR_NO_MEM;
+    storage_json_token_t t;
+    while ((t = storage_json_next(r)) == STORAGE_JSON_OBJECT_BEGIN) {
+        if (!history_reserve((void **)&a->weights, &cap, a->weight_count, sizeof(weight_record_t))) return ESP_ERR_NO_MEM;
+        weight_record_t *w = &a->weights[a->weight_count++];
+        while ((t = storage_json_next(r)) == STORAGE_JSON_KEY) {
+            const char *key = storage_json_text(r);
+            if (strcmp(key, "date") == 0) w->date = (uint32_t)read_num(r);
+            else if (strcmp(key, "value") == 0) w->value = (float)read_num(r);
+            else if (strcmp(key, "unit") == 0) read_str(r, w->unit, sizeof(w->unit));
+            else storage_json_skip(r);
+        }
+        if (t != STORAGE_JSON_OBJECT_END) return ESP_ERR_INVALID_RESPONSE;
+    }
+    return t == STORAGE_JSON_ARRAY_END ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+static esp_err_t read_events(storage_json_reader_t *r, animal_t *a, size_t hint)
+{
+    if (storage_json_next(r) != STORAGE_JSON_ARRAY_BEGIN) return ESP_ERR_INVALID_RESPONSE;
+    size_t cap = 0;
+    if (hint && !history_reserve((void **)&a->events, &cap, hint - 1, sizeof(event_record_t))) return ESP_ERR_NO_MEM;
+    storage_json_token_t t;
+    while ((t = storage_json_next(r)) == STORAGE_JSON_OBJECT_BEGIN) {
+        if (!history_reserve((void **)&a->events, &cap, a->event_count, sizeof(event_record_t))) return ESP_ERR_NO_MEM;
+        event_record_t *e = &a->events[a->event_count++];
+        while ((t = storage_json_next(r)) == STORAGE_JSON_KEY) {
+            const char *key = storage_json_text(r);
+            if (strcmp(key, "date") == 0) e->date = (uint32_t)read_num(r);
+            else if (strcmp(key, "type") == 0) e->type = (event_type_t)read_num(r);
+            else if (strcmp(key, "desc") == 0) read_str(r, e->description, sizeof(e->description));
+            else storage_json_skip(r);
+        }
+        if (t != STORAGE_JSON_OBJECT_END) return ESP_ERR_INVALID_RESPONSE;
+    }
+    return t == STORAGE_JSON_ARRAY_END ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+esp_err_t core_animal_read_json(storage_json_reader_t *r, animal_t *out_animal, bool summary_only)
+{
+    memset(out_animal, 0, sizeof(animal_t));
+    if (storage_json_next(r) != STORAGE_JSON_OBJECT_BEGIN) return ESP_ERR_INVALID_RESPONSE;
+
+    enum { HAVE_ID = 1, HAVE_NAME = 2, HAVE_SPECIES = 4, HAVE_SUMMARY = 7 };
+    unsigned have = 0;
+    size_t weight_hint = 0, event_hint = 0;
+    esp_err_t ret = ESP_OK;
+    storage_json_token_t t = STORAGE_JSON_ERROR;
+    while (ret == ESP_OK && (t = storage_json_next(r)) == STORAGE_JSON_KEY) {
+        const char *key = storage_json_text(r);
+        if (strcmp(key, "id") == 0) { read_str(r, out_animal->id, sizeof(out_animal->id)); have |= HAVE_ID; }
+        else if (strcmp(key, "name") == 0) { read_str(r, out_animal->name, sizeof(out_animal->name)); have |= HAVE_NAME; }
+        else if (strcmp(key, "species") == 0) { read_str(r, out_animal->species, sizeof(out_animal->species)); have |= HAVE_SPECIES; }
+        else if (strcmp(key, "sex") == 0) out_animal->sex = (animal_sex_t)read_num(r);
+        else if (strcmp(key, "dob") == 0) out_animal->dob = (uint32_t)read_num(r);
+        else if (strcmp(key, "origin") == 0) read_str(r, out_animal->origin, sizeof(out_animal->origin));
+        else if (strcmp(key, "registry_id") == 0) read_str(r, out_animal->registry_id, sizeof(out_animal->registry_id));
+        else if (strcmp(key, "is_deleted") == 0) out_animal->is_deleted = read_num(r) != 0;
+        else if (strcmp(key, "deleted_at") == 0) out_animal->deleted_at = (uint32_t)read_num(r);
+        else if (strcmp(key, "weight_count") == 0) weight_hint = history_hint(read_num(r));
+        else if (strcmp(key, "event_count") == 0) event_hint = history_hint(read_num(r));
+        else if (strcmp(key, "weights") == 0 && !summary_only) ret = read_weights(r, out_animal, weight_hint);
+        else if (strcmp(key, "events") == 0 && !summary_only) ret = read_events(r, out_animal, event_hint);
+        else ret = storage_json_skip(r);
+
+        // The rest of the document is history: not read at all
+        if (summary_only && have == HAVE_SUMMARY) return ESP_OK;
+    }
+    if (ret == ESP_OK && t != STORAGE_JSON_OBJECT_END) ret = ESP_ERR_INVALID_RESPONSE;
+    if (ret == ESP_OK) ret = storage_json_reader_error(r);
+    if (ret != ESP_OK) core_free_animal_content(out_animal);
+    return ret;
+}
+
+esp_err_t core_animal_load_json(const char *filename, animal_t *out_animal, bool summary_only)
+{
+    storage_json_reader_t *r = storage_json_reader_open_file(filename);
+    if (!r) return ESP_ERR_NOT_FOUND;
+    esp_err_t ret = core_animal_read_json(r, out_animal, summary_only);
+    storage_json_reader_close(r);
+    if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to parse %s: %s", filename, esp_err_to_name(ret));
+    return ret;
+}
+
+esp_err_t core_animal_from_json(const cJSON *root, animal_t *out_animal)
+{
+    memset(out_animal, 0, sizeof(animal_t));
+
+    cJSON *item = cJSON_GetObjectItem(root, "id"); if (cJSON_IsString(item)) strncpy(out_animal->id, item->valuestring, 36);
+    item = cJSON_GetObjectItem(root, "name"); if (cJSON_IsString(item)) strncpy(out_animal->name, item->valuestring, 63);
+    item = cJSON_GetObjectItem(root, "species"); if (cJSON_IsString(item)) strncpy(out_animal->species, item->valuestring, 127);
+    item = cJSON_GetObjectItem(root, "sex"); if (item) out_animal->sex = (animal_sex_t)item->valueint;
+    item = cJSON_GetObjectItem(root, "dob"); if (item) out_animal->dob = item->valueint;
+    item = cJSON_GetObjectItem(root, "origin"); if (cJSON_IsString(item)) strncpy(out_animal->origin, item->valuestring, 15);
+    item = cJSON_GetObjectItem(root, "registry_id"); if (cJSON_IsString(item)) strncpy(out_animal->registry_id, item->valuestring, 31);
+    item = cJSON_GetObjectItem(root, "is_deleted"); if (item) out_animal->is_deleted = cJSON_IsTrue(item);
+    item = cJSON_GetObjectItem(root, "deleted_at"); if (item) out_animal->deleted_at = (uint32_t)item->valuedouble;
+
+    cJSON *weights = cJSON_GetObjectItem(root, "weights");
+    if (weights && cJSON_IsArray(weights)) {
+        int count = cJSON_GetArraySize(weights);
+        if (count > 0) {
+            out_animal->weights = calloc(count, sizeof(weight_record_t));
+            if (!out_animal->weights) return ESP_ERR_NO_MEM;
+            out_animal->weight_count = count;
+            for (int i = 0; i < count; i++) {
+                cJSON *w = cJSON_GetArrayItem(weights, i);
+                cJSON *d = cJSON_GetObjectItem(w, "date");
+                cJSON *v = cJSON_GetObjectItem(w, "value");
+                cJSON *u = cJSON_GetObjectItem(w, "unit");
+                if (d) out_animal->weights[i].date = d->valueint;
+                if (v) out_animal->weights[i].value = v->valuedouble;
+                if (cJSON_IsString(u)) strncpy(out_animal->weights[i].unit, u->valuestring, 7);
+            }
+        }
+    }
+    cJSON *events = cJSON_GetObjectItem(root, "events");
+    if (events && cJSON_IsArray(events)) {
+        int count = cJSON_GetArraySize(events);
+        if (count > 0) {
+            out_animal->events = calloc(count, sizeof(event_record_t));
+            if (!out_animal->events) { core_free_animal_content(out_animal); return ESP_ERR_NO_MEM; }
+            out_animal->event_count = count;
+            for (int i = 0; i < count; i++) {
+                cJSON *e = cJSON_GetArrayItem(events, i);
+                cJSON *d = cJSON_GetObjectItem(e, "date");
+                cJSON *t = cJSON_GetObjectItem(e, "type");
+                cJSON *desc = cJSON_GetObjectItem(e, "desc");
+                if (d) out_animal->events[i].date = d->valueint;
+                if (t) out_animal->events[i].type = (event_type_t)t->valueint;
+                if (cJSON_IsString(desc)) strncpy(out_animal->events[i].description, desc->valuestring, 63);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t core_export_animal_json(const char *animal_id, const char *filename)
+{
+    animal_t animal;
+    esp_err_t ret = core_get_animal(animal_id, &animal);
+    if (ret != ESP_OK) return ret;
+
+    // Streamed: memory stays bounded whatever the history length
+    ret = core_animal_save_json(filename, &animal);
+    core_free_animal_content(&animal);
+    return ret;
+}
+
+esp_err_t core_import_animal_json(const char *filename)
+{
+    animal_t animal;
+    esp_err_t ret = core_animal_load_json(filename, &animal, false);
+    if (ret != ESP_OK) return ret;
+
+    ret = core_save_animal(&animal);
+    core_free_animal_content(&animal);
+    return ret;
+}
+
+static bool csv_visitor(const animal_t *a, void *ctx)
+{
+    FILE *f = ctx;
+    return fprintf(f, "%s,%s,%s,%d,%s,%s\n",
+        a->id, a->name, a->species, a->sex, a->origin, a->registry_id) >= 0;
+}
 
 esp_err_t core_export_csv(const char *filename)
 {
-    if (!board_sd_is_mounted()) {
+    if (!storage_is_ready()) {
         return ESP_ERR_NOT_SUPPORTED;
     }
 
@@ -16,20 +277,10 @@ esp_err_t core_export_csv(const char *filename)
     // Header
     fprintf(f, "ID,Name,Species,Sex,Origin,RegistryID\n");
 
-    animal_summary_t *list = NULL;
-    size_t count = 0;
-    if (core_list_animals(&list, &count) == ESP_OK) {
-        for (size_t i = 0; i < count; i++) {
-            animal_t a;
-            if (core_get_animal(list[i].id, &a) == ESP_OK) {
-                fprintf(f, "%s,%s,%s,%d,%s,%s\n", 
-                    a.id, a.name, a.species, a.sex, a.origin, a.registry_id);
-                core_free_animal_content(&a);
-            }
-        }
-        core_free_animal_list(list);
-    }
+    // Header-level scan: origin/registry come from one read per record
+    core_scan_filter_t filter = { .level = CORE_SCAN_HEADER };
+    esp_err_t ret = core_scan(&filter, csv_visitor, f);
 
     fclose(f);
-    return ESP_OK;
-}
\ No newline at end of file
+    return ret;
+}
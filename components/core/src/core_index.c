@@ -0,0 +1,659 @@
+#include "core_index.h"
+#include "core_internal.h"
+#include "core_species.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CORE_INDEX";
+
+#define INDEX_INITIAL_CAPACITY 32
+
+// Trigram postings are (trigram, slot) pairs sorted by trigram then slot, so
+// the posting list of one trigram is a contiguous, slot-ordered range.
+#define TRIGRAM_MAGIC         0x49525452u // "RTRI"
+#define TRIGRAM_VERSION       1
+#define TRIGRAM_QUERY_MAX     64
+#define TRIGRAM_MAX_PER_ENTRY (sizeof(((core_index_entry_t *)0)->summary.name) + \
+                               sizeof(((animal_t *)0)->species) + \
+                               sizeof(((core_index_entry_t *)0)->registry_id))
+
+typedef struct {
+    uint32_t tri;
+    uint16_t slot;
+    uint16_t reserved;
+} tri_posting_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t entry_count;
+    uint32_t fingerprint;   // CRC32 of the indexed text of every slot, in order
+    uint32_t posting_count;
+    uint32_t posting_crc;
+} tri_file_header_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static core_index_entry_t *s_entries = NULL;
+static size_t s_count = 0;
+static size_t s_capacity = 0;
+
+static tri_posting_t *s_postings = NULL;
+static size_t s_posting_count = 0;
+static size_t s_posting_capacity = 0;
+static bool s_postings_ready = false; // false until core_index_finish_load()
+static uint32_t s_generation = 0;     // bumped on every change, invalidates slot lists
+static bool s_postings_dirty = false; // changed since last persisted
+static esp_timer_handle_t s_persist_timer = NULL;
+
+static void index_lock(void) {
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void index_unlock(void) {
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+static void *index_realloc(void *ptr, size_t size) {
+    // Large collections live in PSRAM; fall back to internal RAM if absent
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!grown) grown = realloc(ptr, size);
+    return grown;
+}
+
+// Case-insensitive substring test without temporary copies
+static bool contains_ignore_case(const char *haystack, const char *needle) {
+    if (!needle || !*needle) return true;
+    if (!haystack) return false;
+    size_t nlen = strlen(needle);
+    for (const char *h = haystack; *h; h++) {
+        size_t i = 0;
+        while (i < nlen && h[i] &&
+               tolower((unsigned char)h[i]) == tolower((unsigned char)needle[i])) {
+            i++;
+        }
+        if (i == nlen) return true;
+        if (!h[i]) return false;
+    }
+    return false;
+}
+
+// Species hit by a query, tested once per species instead of once per entry
+typedef struct {
+    uint8_t *bits;
+    size_t count;
+} species_hits_t;
+
+// Without memory (count 0) every entry resolves its own species name
+static void species_hits_build(species_hits_t *hits, const char *query) {
+    hits->count = core_species_count();
+    hits->bits = calloc((hits->count + 7) / 8, 1);
+    if (!hits->bits) hits->count = 0;
+    for (size_t id = 0; id < hits->count; id++) {
+        if (contains_ignore_case(core_species_name((species_id_t)id), query)) {
+            hits->bits[id / 8] |= (uint8_t)(1u << (id % 8));
+        }
+    }
+}
+
+// Vacant slots (archived animals) are never listed, even with the deleted ones
+static bool entry_listed(const core_index_entry_t *e, bool include_deleted) {
+    return e->summary.id[0] != '\0' && (include_deleted || !e->is_deleted);
+}
+
+static bool entry_matches(const core_index_entry_t *e, const char *query, const species_hits_t *hits) {
+    species_id_t id = e->summary.species_id;
+    bool species_hit = id < hits->count ? (hits->bits[id / 8] >> (id % 8)) & 1
+                                        : contains_ignore_case(core_species_name(id), query);
+    return species_hit ||
+           contains_ignore_case(e->summary.name, query) ||
+           contains_ignore_case(e->registry_id, query);
+}
+
+static esp_err_t index_reserve(size_t wanted) {
+    if (wanted <= s_capacity) return ESP_OK;
+    size_t new_cap = s_capacity ? s_capacity * 2 : INDEX_INITIAL_CAPACITY;
+    while (new_cap < wanted) new_cap *= 2;
+    core_index_entry_t *grown = index_realloc(s_entries, new_cap * sizeof(core_index_entry_t));
+    if (!grown) return ESP_ERR_NO_MEM;
+    s_entries = grown;
+    s_capacity = new_cap;
+    return ESP_OK;
+}
+
+static esp_err_t postings_reserve(size_t wanted) {
+    if (wanted <= s_posting_capacity) return ESP_OK;
+    size_t new_cap = s_posting_capacity ? s_posting_capacity * 2 : 1024;
+    while (new_cap < wanted) new_cap *= 2;
+    tri_posting_t *grown = index_realloc(s_postings, new_cap * sizeof(tri_posting_t));
+    if (!grown) return ESP_ERR_NO_MEM;
+    s_postings = grown;
+    s_posting_capacity = new_cap;
+    return ESP_OK;
+}
+
+// =============================================================================
+// Trigrams
+// =============================================================================
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_posting(const void *a, const void *b) {
+    const tri_posting_t *x = a, *y = b;
+    if (x->tri != y->tri) return (x->tri > y->tri) - (x->tri < y->tri);
+    return (x->slot > y->slot) - (x->slot < y->slot);
+}
+
+// Append the lowercased trigrams of text; trigrams never span two fields
+static size_t tri_extract(const char *text, uint32_t *out, size_t n, size_t max) {
+    size_t len = strlen(text);
+    for (size_t i = 0; i + 3 <= len && n < max; i++) {
+        out[n++] = ((uint32_t)(uint8_t)tolower((unsigned char)text[i]) << 16) |
+                   ((uint32_t)(uint8_t)tolower((unsigned char)text[i + 1]) << 8) |
+                   (uint32_t)(uint8_t)tolower((unsigned char)text[i + 2]);
+    }
+    return n;
+}
+
+static size_t tri_sort_unique(uint32_t *tris, size_t n) {
+    if (n < 2) return n;
+    qsort(tris, n, sizeof(uint32_t), cmp_u32);
+    size_t out = 1;
+    for (size_t i = 1; i < n; i++) {
+        if (tris[i] != tris[out - 1]) tris[out++] = tris[i];
+    }
+    return out;
+}
+
+static size_t entry_trigrams(const core_index_entry_t *e, uint32_t *out) {
+    size_t n = 0;
+    n = tri_extract(e->summary.name, out, n, TRIGRAM_MAX_PER_ENTRY);
+    n = tri_extract(core_species_name(e->summary.species_id), out, n, TRIGRAM_MAX_PER_ENTRY);
+    n = tri_extract(e->registry_id, out, n, TRIGRAM_MAX_PER_ENTRY);
+    return tri_sort_unique(out, n);
+}
+
+static void postings_remove_slot(uint16_t slot) {
+    size_t out = 0;
+    for (size_t i = 0; i < s_posting_count; i++) {
+        if (s_postings[i].slot != slot) s_postings[out++] = s_postings[i];
+    }
+    s_posting_count = out;
+}
+
+// Merge the sorted trigrams of one slot into the sorted posting array, back to front
+static esp_err_t postings_insert_slot(uint16_t slot, const uint32_t *tris, size_t n) {
+    if (n == 0) return ESP_OK;
+    esp_err_t ret = postings_reserve(s_posting_count + n);
+    if (ret != ESP_OK) return ret;
+
+    size_t src = s_posting_count;
+    size_t dst = s_posting_count + n;
+    size_t k = n;
+    while (k > 0) {
+        tri_posting_t add = { .tri = tris[k - 1], .slot = slot };
+        if (src > 0 && cmp_posting(&s_postings[src - 1], &add) > 0) {
+            s_postings[--dst] = s_postings[--src];
+        } else {
+            s_postings[--dst] = add;
+            k--;
+        }
+    }
+    s_posting_count += n;
+    return ESP_OK;
+}
+
+// First posting with tri >= key
+static size_t postings_lower_bound(uint32_t key) {
+    size_t lo = 0, hi = s_posting_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (s_postings[mid].tri < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static bool postings_range_has_slot(size_t begin, size_t end, uint16_t slot) {
+    size_t stop = end;
+    while (begin < end) {
+        size_t mid = begin + (end - begin) / 2;
+        if (s_postings[mid].slot < slot) begin = mid + 1;
+        else end = mid;
+    }
+    return begin < stop && s_postings[begin].slot == slot;
+}
+
+static uint32_t index_fingerprint(void) {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        const core_index_entry_t *e = &s_entries[i];
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)e->summary.name, strlen(e->summary.name) + 1);
+        const char *species = core_species_name(e->summary.species_id);
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)species, strlen(species) + 1);
+        crc = esp_rom_crc32_le(crc, (const uint8_t *)e->registry_id, strlen(e->registry_id) + 1);
+    }
+    return crc;
+}
+
+static const char *trigram_file(void) {
+    static char path[FILEPATH_BUF_LEN];
+    snprintf(path, sizeof(path), "%s/search.tri", ANIMAL_DIR);
+    return path;
+}
+
+static esp_err_t trigrams_persist(void) {
+    tri_file_header_t hdr = {
+        .magic = TRIGRAM_MAGIC,
+        .version = TRIGRAM_VERSION,
+        .entry_count = s_count,
+        .fingerprint = index_fingerprint(),
+        .posting_count = s_posting_count,
+        .posting_crc = esp_rom_crc32_le(0, (const uint8_t *)s_postings,
+                                        s_posting_count * sizeof(tri_posting_t)),
+    };
+    // Called under the index lock: hand a snapshot to the commit writer
+    // rather than holding the lock across the flash write
+    size_t postings_len = s_posting_count * sizeof(tri_posting_t);
+    size_t len = sizeof(hdr) + postings_len;
+    uint8_t *image = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!image) image = malloc(len);
+    if (!image) {
+        ESP_LOGW(TAG, "Out of memory, trigram index not persisted");
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(image, &hdr, sizeof(hdr));
+    if (postings_len) memcpy(image + sizeof(hdr), s_postings, postings_len);
+    esp_err_t ret = storage_commit_write(trigram_file(), image, len, false);
+    if (ret != ESP_OK) ESP_LOGW(TAG, "Cannot persist trigram index to %s", trigram_file());
+    free(image);
+    return ret;
+}
+
+// Adopt the persisted postings only if they were built from exactly these entries
+static bool trigrams_load_persisted(void) {
+    FILE *f = fopen(trigram_file(), "rb");
+    if (!f) return false;
+
+    tri_file_header_t hdr;
+    bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+              hdr.magic == TRIGRAM_MAGIC && hdr.version == TRIGRAM_VERSION &&
+              hdr.entry_count == s_count && hdr.fingerprint == index_fingerprint();
+    if (ok) ok = postings_reserve(hdr.posting_count) == ESP_OK;
+    if (ok && hdr.posting_count) {
+        ok = fread(s_postings, sizeof(tri_posting_t), hdr.posting_count, f) == hdr.posting_count &&
+             esp_rom_crc32_le(0, (const uint8_t *)s_postings,
+                              hdr.posting_count * sizeof(tri_posting_t)) == hdr.posting_crc;
+    }
+    fclose(f);
+    s_posting_count = ok ? hdr.posting_count : 0;
+    return ok;
+}
+
+static esp_err_t trigrams_rebuild(void) {
+    s_posting_count = 0;
+    uint32_t *tris = malloc(TRIGRAM_MAX_PER_ENTRY * sizeof(uint32_t));
+    if (!tris) return ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < s_count; i++) {
+        size_t n = entry_trigrams(&s_entries[i], tris);
+        if (postings_reserve(s_posting_count + n) != ESP_OK) {
+            free(tris);
+            s_posting_count = 0;
+            return ESP_ERR_NO_MEM;
+        }
+        for (size_t k = 0; k < n; k++) {
+            s_postings[s_posting_count++] = (tri_posting_t){ .tri = tris[k], .slot = (uint16_t)i };
+        }
+    }
+    free(tris);
+    qsort(s_postings, s_posting_count, sizeof(tri_posting_t), cmp_posting);
+    return ESP_OK;
+}
+
+// The persisted copy only spares the rebuild at boot: edits mark it stale and
+// a burst of them is written once (caller holds the lock)
+static void trigrams_mark_dirty(void) {
+    s_postings_dirty = true;
+    // Already armed: the pending persist covers this edit too
+    if (s_persist_timer && !esp_timer_is_active(s_persist_timer)) {
+        esp_timer_start_once(s_persist_timer, (uint64_t)CONFIG_CORE_INDEX_PERSIST_DELAY_MS * 1000);
+    }
+}
+
+static void persist_timer_cb(void *arg) {
+    core_index_flush();
+}
+
+// Re-post one slot after its text changed; drops the trigram index on failure
+static void trigrams_update_slot(uint16_t slot) {
+    uint32_t *tris = malloc(TRIGRAM_MAX_PER_ENTRY * sizeof(uint32_t));
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (tris) {
+        size_t n = entry_trigrams(&s_entries[slot], tris);
+        postings_remove_slot(slot);
+        ret = postings_insert_slot(slot, tris, n);
+        free(tris);
+    }
+    if (ret == ESP_OK) {
+        trigrams_mark_dirty();
+    } else {
+        ESP_LOGW(TAG, "Trigram index dropped (out of memory), searches fall back to a linear pass");
+        s_postings_ready = false;
+        s_posting_count = 0;
+        s_postings_dirty = false;
+        // Queued behind any pending persist of the same file
+        storage_commit_remove(trigram_file(), false);
+    }
+}
+
+// Candidate slots for query: intersection of the posting lists of its
+// trigrams, walking the shortest list. Returns the number of candidates.
+static size_t trigram_candidates(const char *query, uint16_t *out) {
+    uint32_t tris[TRIGRAM_QUERY_MAX];
+    size_t n = tri_sort_unique(tris, tri_extract(query, tris, 0, TRIGRAM_QUERY_MAX));
+
+    size_t begin[TRIGRAM_QUERY_MAX], end[TRIGRAM_QUERY_MAX];
+    size_t shortest = 0;
+    for (size_t k = 0; k < n; k++) {
+        begin[k] = postings_lower_bound(tris[k]);
+        end[k] = postings_lower_bound(tris[k] + 1);
+        if (begin[k] == end[k]) return 0;
+        if (end[k] - begin[k] < end[shortest] - begin[shortest]) shortest = k;
+    }
+
+    size_t count = 0;
+    for (size_t p = begin[shortest]; p < end[shortest]; p++) {
+        uint16_t slot = s_postings[p].slot;
+        bool in_all = true;
+        for (size_t k = 0; k < n && in_all; k++) {
+            if (k != shortest) in_all = postings_range_has_slot(begin[k], end[k], slot);
+        }
+        if (in_all) out[count++] = slot;
+    }
+    return count;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+esp_err_t core_index_init(void) {
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+    if (!s_persist_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = persist_timer_cb,
+            .name = "core_index",
+        };
+        if (esp_timer_create(&args, &s_persist_timer) != ESP_OK) {
+            ESP_LOGW(TAG, "No persist timer, search index saved by core_flush() only");
+            s_persist_timer = NULL;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t core_index_flush(void) {
+    esp_err_t ret = ESP_OK;
+    index_lock();
+    if (s_postings_ready && s_postings_dirty) {
+        // Left dirty on failure: the next edit or flush tries again
+        ret = trigrams_persist();
+        if (ret == ESP_OK) s_postings_dirty = false;
+    }
+    index_unlock();
+    return ret;
+}
+
+void core_index_clear(void) {
+    index_lock();
+    s_count = 0;
+    s_posting_count = 0;
+    s_postings_ready = false;
+    s_postings_dirty = false;
+    s_generation++;
+    index_unlock();
+}
+
+void core_index_finish_load(void) {
+    index_lock();
+    if (trigrams_load_persisted()) {
+        ESP_LOGI(TAG, "Trigram index loaded: %u postings", (unsigned)s_posting_count);
+        s_postings_ready = true;
+    } else if (trigrams_rebuild() == ESP_OK) {
+        ESP_LOGI(TAG, "Trigram index rebuilt: %u postings", (unsigned)s_posting_count);
+        s_postings_ready = true;
+        trigrams_persist();
+    } else {
+        ESP_LOGW(TAG, "Trigram index unavailable, searches fall back to a linear pass");
+    }
+    index_unlock();
+}
+
+esp_err_t core_index_upsert(const animal_t *animal) {
+    if (!animal || animal->id[0] == '\0') return ESP_ERR_INVALID_ARG;
+
+    species_id_t species_id;
+    esp_err_t ret = core_species_intern(animal->species, &species_id);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot intern species of %s", animal->id);
+        return ret;
+    }
+
+    index_lock();
+    core_index_entry_t *entry = NULL;
+    for (size_t i = 0; i < s_count; i++) {
+        if (strcmp(s_entries[i].summary.id, animal->id) == 0) {
+            entry = &s_entries[i];
+            break;
+        }
+    }
+    if (!entry) {
+        // Posting slots are 16-bit
+        if (s_count >= UINT16_MAX || index_reserve(s_count + 1) != ESP_OK) {
+            index_unlock();
+            ESP_LOGE(TAG, "Out of memory growing index to %u entries", (unsigned)(s_count + 1));
+            return ESP_ERR_NO_MEM;
+        }
+        entry = &s_entries[s_count++];
+        memset(entry, 0, sizeof(*entry));
+    }
+
+    core_index_entry_t updated;
+    memset(&updated, 0, sizeof(updated));
+    strlcpy(updated.summary.id, animal->id, sizeof(updated.summary.id));
+    strlcpy(updated.summary.name, animal->name, sizeof(updated.summary.name));
+    updated.summary.species_id = species_id;
+    strlcpy(updated.registry_id, animal->registry_id, sizeof(updated.registry_id));
+    updated.sex = animal->sex;
+    updated.dob = animal->dob;
+    updated.is_deleted = animal->is_deleted;
+    updated.deleted_at = animal->is_deleted ? animal->deleted_at : 0;
+
+    bool text_changed = strcmp(entry->summary.name, updated.summary.name) != 0 ||
+                        entry->summary.species_id != updated.summary.species_id ||
+                        strcmp(entry->registry_id, updated.registry_id) != 0;
+    *entry = updated;
+    s_generation++;
+
+    // Only text edits touch the postings (and their copy on storage)
+    if (s_postings_ready && text_changed) {
+        trigrams_update_slot((uint16_t)(entry - s_entries));
+    }
+    index_unlock();
+    return ESP_OK;
+}
+
+esp_err_t core_index_remove(const char *id) {
+    if (!id || id[0] == '\0') return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    index_lock();
+    for (size_t i = 0; i < s_count; i++) {
+        core_index_entry_t *e = &s_entries[i];
+        if (strcmp(e->summary.id, id) != 0) continue;
+        memset(e, 0, sizeof(*e));
+        e->is_deleted = true;
+        s_generation++;
+        if (s_postings_ready) {
+            postings_remove_slot((uint16_t)i);
+            trigrams_mark_dirty();
+        }
+        ret = ESP_OK;
+        break;
+    }
+    index_unlock();
+    return ret;
+}
+
+esp_err_t core_index_list_deleted(uint32_t cutoff, animal_summary_t **out_list, size_t *out_count) {
+    *out_list = NULL; *out_count = 0;
+    index_lock();
+    size_t n = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        const core_index_entry_t *e = &s_entries[i];
+        if (e->is_deleted && e->summary.id[0] && e->deleted_at < cutoff) n++;
+    }
+    animal_summary_t *list = n ? malloc(n * sizeof(animal_summary_t)) : NULL;
+    if (n && !list) { index_unlock(); return ESP_ERR_NO_MEM; }
+    size_t k = 0;
+    for (size_t i = 0; i < s_count && k < n; i++) {
+        const core_index_entry_t *e = &s_entries[i];
+        if (e->is_deleted && e->summary.id[0] && e->deleted_at < cutoff) list[k++] = e->summary;
+    }
+    index_unlock();
+    *out_list = list; *out_count = n;
+    return ESP_OK;
+}
+
+bool core_index_contains(const char *id) {
+    bool found = false;
+    index_lock();
+    for (size_t i = 0; i < s_count && !found; i++) {
+        found = (strcmp(s_entries[i].summary.id, id) == 0);
+    }
+    index_unlock();
+    return found;
+}
+
+esp_err_t core_index_find_slot(const char *id, uint16_t *out_slot) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    index_lock();
+    for (size_t i = 0; i < s_count; i++) {
+        if (strcmp(s_entries[i].summary.id, id) == 0) {
+            *out_slot = (uint16_t)i;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    index_unlock();
+    return ret;
+}
+
+size_t core_index_count(void) {
+    index_lock();
+    size_t count = s_count;
+    index_unlock();
+    return count;
+}
+
+// Collect the slots of every entry matching query, in slot order.
+// within == NULL searches the whole index, otherwise only the listed slots.
+// Caller holds the lock; out must have room for s_count (or within_count) slots.
+static size_t match_slots_locked(const char *query, bool include_deleted,
+                                 const uint16_t *within, size_t within_count, uint16_t *out) {
+    size_t n = 0;
+    species_hits_t hits;
+    species_hits_build(&hits, query);
+    if (within) {
+        for (size_t k = 0; k < within_count; k++) {
+            if (within[k] >= s_count) continue;
+            const core_index_entry_t *e = &s_entries[within[k]];
+            if (!entry_listed(e, include_deleted)) continue;
+            if (entry_matches(e, query, &hits)) out[n++] = within[k];
+        }
+    } else if (s_postings_ready && query && strlen(query) >= 3) {
+        // Queries shorter than a trigram cannot use the postings
+        size_t candidates = trigram_candidates(query, out);
+        for (size_t k = 0; k < candidates; k++) {
+            const core_index_entry_t *e = &s_entries[out[k]];
+            if (!entry_listed(e, include_deleted)) continue;
+            // Shared trigrams do not imply adjacency: confirm the substring
+            if (entry_matches(e, query, &hits)) out[n++] = out[k];
+        }
+    } else {
+        for (size_t i = 0; i < s_count; i++) {
+            const core_index_entry_t *e = &s_entries[i];
+            if (!entry_listed(e, include_deleted)) continue;
+            if (entry_matches(e, query, &hits)) out[n++] = (uint16_t)i;
+        }
+    }
+    free(hits.bits);
+    return n;
+}
+
+esp_err_t core_index_snapshot(const char *query, bool include_deleted,
+                              core_index_entry_t **out_entries, size_t *out_count) {
+    *out_entries = NULL; *out_count = 0;
+
+    index_lock();
+    if (s_count == 0) { index_unlock(); return ESP_OK; }
+    uint16_t *slots = malloc(s_count * sizeof(uint16_t));
+    if (!slots) { index_unlock(); return ESP_ERR_NO_MEM; }
+    size_t n = match_slots_locked(query, include_deleted, NULL, 0, slots);
+    core_index_entry_t *snap = n ? index_realloc(NULL, n * sizeof(core_index_entry_t)) : NULL;
+    if (n && !snap) { index_unlock(); free(slots); return ESP_ERR_NO_MEM; }
+    for (size_t k = 0; k < n; k++) snap[k] = s_entries[slots[k]];
+    index_unlock();
+    free(slots);
+
+    *out_entries = snap; *out_count = n;
+    return ESP_OK;
+}
+
+uint32_t core_index_generation(void) {
+    index_lock();
+    uint32_t generation = s_generation;
+    index_unlock();
+    return generation;
+}
+
+esp_err_t core_index_match_slots(const char *query, bool include_deleted,
+                                 const uint16_t *within, size_t within_count,
+                                 uint16_t **out_slots, size_t *out_count) {
+    *out_slots = NULL; *out_count = 0;
+
+    index_lock();
+    size_t room = within ? within_count : s_count;
+    if (room == 0) { index_unlock(); return ESP_OK; }
+    uint16_t *slots = index_realloc(NULL, room * sizeof(uint16_t));
+    if (!slots) { index_unlock(); return ESP_ERR_NO_MEM; }
+    size_t n = match_slots_locked(query, include_deleted, within, within_count, slots);
+    index_unlock();
+
+    if (n == 0) { free(slots); return ESP_OK; }
+    *out_slots = slots; *out_count = n;
+    return ESP_OK;
+}
+
+size_t core_index_copy_summaries(const uint16_t *slots, size_t count, animal_summary_t *out) {
+    size_t n = 0;
+    index_lock();
+    for (size_t k = 0; k < count; k++) {
+        if (slots[k] < s_count && s_entries[slots[k]].summary.id[0]) out[n++] = s_entries[slots[k]].summary;
+    }
+    index_unlock();
+    return n;
+}
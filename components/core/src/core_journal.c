@@ -0,0 +1,134 @@
+#include "core_internal.h"
+#include "esp_log.h"
+#include "reptile_storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *TAG = "CORE_JOURNAL";
+
+// Journal = flat sequence of fixed-size entries appended after the base record
+typedef enum {
+    JOURNAL_KIND_WEIGHT = 1,
+    JOURNAL_KIND_EVENT = 2,
+} journal_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t reserved[3];
+    union {
+        weight_record_t weight;
+        event_record_t event;
+    } rec;
+} journal_entry_t;
+
+static esp_err_t journal_path(char *buf, size_t len, const char *animal_id) {
+    int n = snprintf(buf, len, "%s/%s.jnl", ANIMAL_DIR, animal_id);
+    if (n < 0 || n >= (int)len) {
+        ESP_LOGW(TAG, "Path too long for journal: dir=%s id=%s", ANIMAL_DIR, animal_id);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t journal_append(const char *animal_id, const journal_entry_t *entry) {
+    if (!animal_id || animal_id[0] == '\0') return ESP_ERR_INVALID_ARG;
+    char filepath[FILEPATH_BUF_LEN];
+    esp_err_t ret = journal_path(filepath, sizeof(filepath), animal_id);
+    if (ret != ESP_OK) return ret;
+
+    // Deferred: a burst of appends is flushed as one batch. Readers below
+    // call storage_commit_flush() first so they still see every entry.
+    return storage_commit_append(filepath, entry, sizeof(*entry), false);
+}
+
+esp_err_t core_journal_append_weight(const char *animal_id, const weight_record_t *weight) {
+    journal_entry_t entry = { .kind = JOURNAL_KIND_WEIGHT };
+    entry.rec.weight = *weight;
+    return journal_append(animal_id, &entry);
+}
+
+esp_err_t core_journal_append_event(const char *animal_id, const event_record_t *event) {
+    journal_entry_t entry = { .kind = JOURNAL_KIND_EVENT };
+    entry.rec.event = *event;
+    return journal_append(animal_id, &entry);
+}
+
+esp_err_t core_journal_merge(animal_t *animal) {
+    char filepath[FILEPATH_BUF_LEN];
+    esp_err_t ret = journal_path(filepath, sizeof(filepath), animal->id);
+    if (ret != ESP_OK) return ret;
+
+    storage_commit_flush();
+    FILE *f = fopen(filepath, "rb");
+    if (!f) return ESP_OK; // Nothing journaled since last compaction
+
+    // Size the arrays once from the journal length, then fill in a single read pass
+    struct stat st;
+    size_t total = 0;
+    if (fstat(fileno(f), &st) == 0 && st.st_size > 0) {
+        total = (size_t)st.st_size / sizeof(journal_entry_t);
+    }
+    if (total == 0) { fclose(f); return ESP_OK; }
+
+    weight_record_t *weights = realloc(animal->weights, (animal->weight_count + total) * sizeof(weight_record_t));
+    if (weights) animal->weights = weights;
+    event_record_t *events = realloc(animal->events, (animal->event_count + total) * sizeof(event_record_t));
+    if (events) animal->events = events;
+    if (!weights || !events) { fclose(f); return ESP_ERR_NO_MEM; }
+
+    journal_entry_t entry;
+    size_t merged = 0;
+    while (merged < total && fread(&entry, sizeof(entry), 1, f) == 1) {
+        if (entry.kind == JOURNAL_KIND_WEIGHT) {
+            animal->weights[animal->weight_count++] = entry.rec.weight;
+        } else if (entry.kind == JOURNAL_KIND_EVENT) {
+            animal->events[animal->event_count++] = entry.rec.event;
+        } else {
+            ESP_LOGW(TAG, "Unknown journal entry kind %u in %s", entry.kind, filepath);
+        }
+        merged++;
+    }
+    fclose(f);
+    return ESP_OK;
+}
+
+void core_journal_discard(const char *animal_id) {
+    char filepath[FILEPATH_BUF_LEN];
+    if (journal_path(filepath, sizeof(filepath), animal_id) != ESP_OK) return;
+    // Queued behind any pending append of the same journal
+    storage_commit_remove(filepath, false);
+}
+
+bool core_journal_needs_compaction(const char *animal_id) {
+    char jnl_path[FILEPATH_BUF_LEN];
+    if (journal_path(jnl_path, sizeof(jnl_path), animal_id) != ESP_OK) return false;
+
+    // Pending appends are not counted: at worst compaction runs one batch late
+    struct stat jst;
+    size_t base_size;
+    if (stat(jnl_path, &jst) != 0) return false;
+    if (core_record_size(animal_id, &base_size) != ESP_OK) return true;
+    // Fold the journal back once it outweighs the base record: the rewrite
+    // cost is then paid for by at least as many bytes of cheap appends.
+    return (size_t)jst.st_size >= base_size;
+}
+
+void core_journal_last_events(const char *animal_id, uint32_t last_event[CORE_EVENT_TYPE_COUNT]) {
+    char filepath[FILEPATH_BUF_LEN];
+    if (journal_path(filepath, sizeof(filepath), animal_id) != ESP_OK) return;
+    storage_commit_flush();
+    FILE *f = fopen(filepath, "rb");
+    if (!f) return;
+
+    journal_entry_t entry;
+    while (fread(&entry, sizeof(entry), 1, f) == 1) {
+        if (entry.kind != JOURNAL_KIND_EVENT) continue;
+        const event_record_t *ev = &entry.rec.event;
+        if ((unsigned)ev->type < CORE_EVENT_TYPE_COUNT && ev->date > last_event[ev->type]) {
+            last_event[ev->type] = ev->date;
+        }
+    }
+    fclose(f);
+}
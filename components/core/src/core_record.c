@@ -0,0 +1,572 @@
+#include "core_internal.h"
+#include "core_service.h"
+#include "core_weights.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+#include "reptile_storage.h"
+#include "sdkconfig.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+static const char *TAG = "CORE_RECORD";
+
+// On-disk layout (little endian, version 1):
+//   record_header_t | weight_bytes of packed weights | event_count * event_record_t
+// Events use the in-memory struct as fixed-stride rows and weights the packed
+// varint series of core_weights.h (weight_stride 0), so a full load is three
+// fread() calls and a summary load is one. The header also carries the latest
+// date of each event type, so the alert engine is seeded without reading the
+// history, and the deletion date the tombstone archiver (core_archive.c)
+// counts the retention from.
+// With CONFIG_CORE_RECORD_COLLECTION records are keys of ANIMAL_DIR/animals.col
+// instead (core_collection.c): the header sits in the key's slot and the two
+// sections in its extent, at the same offsets minus header_size.
+#define RECORD_MAGIC   0x52505452u // "RTPR"
+#define RECORD_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t header_crc;    // CRC32 of the header with both CRC fields zeroed
+    uint32_t payload_crc;   // CRC32 of the weight then event sections
+    char id[37];
+    char name[64];
+    char species[128];
+    char origin[16];
+    char registry_id[32];
+    uint32_t dob;
+    uint8_t sex;
+    uint8_t is_deleted;
+    uint16_t weight_stride;
+    uint16_t event_stride;
+    uint32_t weight_count;
+    uint32_t event_count;
+    uint32_t last_event[CORE_EVENT_TYPE_COUNT]; // Latest date of each event type
+    uint32_t weight_bytes;                      // Packed weight section
+    uint32_t deleted_at;
+} record_header_t;
+
+_Static_assert(sizeof(weight_record_t) == 16, "weight_record_t layout is part of the record format");
+_Static_assert(sizeof(event_record_t) == 72, "event_record_t layout is part of the record format");
+_Static_assert(sizeof(record_header_t) <= CORE_COLLECTION_HEADER_MAX, "record header must fit a collection slot");
+
+#define COLLECTION_FILE "animals.col"   // Under ANIMAL_DIR
+
+#if CONFIG_CORE_RECORD_COLLECTION
+static core_collection_t *s_collection = NULL;
+#endif
+
+// Where a record lives: its own file, or a key of a collection that keeps
+// the header in the slot and the history sections in the extent
+typedef struct {
+    FILE *f;
+    core_collection_t *col;
+    const char *key;
+    const char *name;      // Path or key, for logs
+    size_t header_size;    // Collection payload offsets start after it
+    char path[FILEPATH_BUF_LEN];
+} record_src_t;
+
+static uint32_t record_header_crc(const record_header_t *hdr) {
+    record_header_t tmp = *hdr;
+    tmp.header_crc = 0;
+    tmp.payload_crc = 0;
+    return esp_rom_crc32_le(0, (const uint8_t *)&tmp, sizeof(tmp));
+}
+
+void core_animal_last_events(const animal_t *animal, uint32_t last_event[CORE_EVENT_TYPE_COUNT]) {
+    memset(last_event, 0, CORE_EVENT_TYPE_COUNT * sizeof(uint32_t));
+    for (size_t i = 0; animal->events && i < animal->event_count; i++) {
+        const event_record_t *ev = &animal->events[i];
+        if ((unsigned)ev->type < CORE_EVENT_TYPE_COUNT && ev->date > last_event[ev->type]) {
+            last_event[ev->type] = ev->date;
+        }
+    }
+}
+
+static void record_src_file(record_src_t *src, const char *path) {
+    memset(src, 0, sizeof(*src));
+    src->name = path;
+}
+
+static void record_src_collection(record_src_t *src, core_collection_t *col, const char *animal_id) {
+    memset(src, 0, sizeof(*src));
+    src->col = col;
+    src->key = animal_id;
+    src->name = animal_id;
+}
+
+// The record of animal_id in the configured layout
+static esp_err_t record_src_id(record_src_t *src, const char *animal_id) {
+#if CONFIG_CORE_RECORD_COLLECTION
+    record_src_collection(src, s_collection, animal_id);
+    return s_collection ? ESP_OK : ESP_ERR_INVALID_STATE;
+#else
+    record_src_file(src, NULL);
+    src->name = src->path;
+    return core_record_path(src->path, sizeof(src->path), animal_id);
+#endif
+}
+
+static esp_err_t src_read(record_src_t *src, size_t pos, void *buf, size_t len) {
+    if (len == 0) return ESP_OK;
+    if (src->col) {
+        if (pos < src->header_size) return ESP_ERR_INVALID_ARG;
+        return core_collection_read(src->col, src->key, pos - src->header_size, buf, len);
+    }
+    if (fseek(src->f, (long)pos, SEEK_SET) != 0 || fread(buf, 1, len, src->f) != len) return ESP_FAIL;
+    return ESP_OK;
+}
+
+static void src_close(record_src_t *src) {
+    if (src->f) fclose(src->f);
+    src->f = NULL;
+}
+
+esp_err_t core_record_path(char *buf, size_t len, const char *animal_id) {
+    int n = snprintf(buf, len, "%s/%s.rec", ANIMAL_DIR, animal_id);
+    if (n < 0 || n >= (int)len) {
+        ESP_LOGW(TAG, "Path too long for record: dir=%s id=%s", ANIMAL_DIR, animal_id);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+// Serialize a record image: header, packed weights, event rows
+static esp_err_t record_image(const animal_t *animal, const core_weight_series_t *weights,
+                              uint8_t **out_image, size_t *out_len) {
+    record_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = RECORD_MAGIC;
+    hdr.version = RECORD_VERSION;
+    hdr.header_size = sizeof(hdr);
+    strlcpy(hdr.id, animal->id, sizeof(hdr.id));
+    strlcpy(hdr.name, animal->name, sizeof(hdr.name));
+    strlcpy(hdr.species, animal->species, sizeof(hdr.species));
+    strlcpy(hdr.origin, animal->origin, sizeof(hdr.origin));
+    strlcpy(hdr.registry_id, animal->registry_id, sizeof(hdr.registry_id));
+    hdr.dob = animal->dob;
+    hdr.sex = (uint8_t)animal->sex;
+    hdr.is_deleted = animal->is_deleted ? 1 : 0;
+    hdr.deleted_at = animal->is_deleted ? animal->deleted_at : 0;
+    hdr.weight_stride = 0;
+    hdr.event_stride = sizeof(event_record_t);
+    hdr.weight_count = weights->count;
+    hdr.weight_bytes = weights->len;
+    hdr.event_count = animal->events ? animal->event_count : 0;
+    uint32_t last_event[CORE_EVENT_TYPE_COUNT];
+    core_animal_last_events(animal, last_event);
+    memcpy(hdr.last_event, last_event, sizeof(hdr.last_event));
+
+    uint32_t crc = 0;
+    crc = esp_rom_crc32_le(crc, weights->data, hdr.weight_bytes);
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)animal->events, hdr.event_count * sizeof(event_record_t));
+    hdr.payload_crc = crc;
+    hdr.header_crc = record_header_crc(&hdr);
+
+    size_t weight_bytes = hdr.weight_bytes;
+    size_t event_bytes = hdr.event_count * sizeof(event_record_t);
+    size_t total = sizeof(hdr) + weight_bytes + event_bytes;
+    uint8_t *image = heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!image) image = malloc(total);
+    if (!image) return ESP_ERR_NO_MEM;
+    memcpy(image, &hdr, sizeof(hdr));
+    if (weight_bytes) memcpy(image + sizeof(hdr), weights->data, weight_bytes);
+    if (event_bytes) memcpy(image + sizeof(hdr) + weight_bytes, animal->events, event_bytes);
+    *out_image = image;
+    *out_len = total;
+    return ESP_OK;
+}
+
+static esp_err_t record_write(record_src_t *dst, const animal_t *animal, const core_weight_series_t *weights) {
+    uint8_t *image;
+    size_t total;
+    esp_err_t ret = record_image(animal, weights, &image, &total);
+    if (ret != ESP_OK) return ret;
+    if (dst->col) {
+        ret = core_collection_put(dst->col, animal->id, image, sizeof(record_header_t),
+                                  image + sizeof(record_header_t), total - sizeof(record_header_t));
+    } else {
+        // The group commit layer replaces the file atomically (temp + rename)
+        // and batches concurrent saves
+        ret = storage_commit_write(dst->name, image, total, true);
+    }
+    free(image);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write %s", dst->name);
+    }
+    return ret;
+}
+
+static esp_err_t record_write_animal(record_src_t *dst, const animal_t *animal) {
+    core_weight_series_t weights;
+    core_weight_series_init(&weights);
+    esp_err_t ret = ESP_OK;
+    if (animal->weights && animal->weight_count) {
+        ret = core_weight_series_encode(&weights, animal->weights, animal->weight_count);
+    }
+    if (ret == ESP_OK) ret = record_write(dst, animal, &weights);
+    core_weight_series_free(&weights);
+    return ret;
+}
+
+esp_err_t core_record_write_file(const char *path, const animal_t *animal) {
+    record_src_t dst;
+    record_src_file(&dst, path);
+    return record_write_animal(&dst, animal);
+}
+
+esp_err_t core_record_write_collection(core_collection_t *c, const animal_t *animal) {
+    record_src_t dst;
+    record_src_collection(&dst, c, animal->id);
+    return record_write_animal(&dst, animal);
+}
+
+// Open a record and read its validated header
+static esp_err_t record_open(record_src_t *src, record_header_t *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    size_t got = 0;
+    if (src->col) {
+        uint8_t buf[CORE_COLLECTION_HEADER_MAX];
+        esp_err_t ret = core_collection_get_header(src->col, src->key, buf, sizeof(buf), &got);
+        if (ret != ESP_OK) return ret;
+        if (got > sizeof(*hdr)) got = sizeof(*hdr);
+        memcpy(hdr, buf, got);
+    } else {
+        src->f = fopen(src->name, "rb");
+        if (!src->f) return ESP_ERR_NOT_FOUND;
+        got = fread(hdr, 1, sizeof(*hdr), src->f);
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (got < offsetof(record_header_t, header_size) + sizeof(hdr->header_size) ||
+        hdr->magic != RECORD_MAGIC) {
+        ESP_LOGE(TAG, "Not a record: %s", src->name);
+        ret = ESP_ERR_INVALID_RESPONSE;
+        goto fail;
+    }
+    if (hdr->version != RECORD_VERSION || hdr->header_size < sizeof(*hdr)) {
+        ESP_LOGE(TAG, "Unsupported record version %u in %s", hdr->version, src->name);
+        ret = ESP_ERR_INVALID_VERSION;
+        goto fail;
+    }
+    if (got < sizeof(*hdr)) {
+        ret = ESP_ERR_INVALID_RESPONSE;
+        goto fail;
+    }
+    if (record_header_crc(hdr) != hdr->header_crc) {
+        ESP_LOGE(TAG, "Header checksum mismatch in %s", src->name);
+        ret = ESP_ERR_INVALID_CRC;
+        goto fail;
+    }
+    src->header_size = hdr->header_size;
+    return ESP_OK;
+
+fail:
+    src_close(src);
+    return ret;
+}
+
+static bool record_strides_ok(const record_header_t *hdr) {
+    return hdr->weight_stride == 0 && hdr->event_stride == sizeof(event_record_t);
+}
+
+static esp_err_t record_read(record_src_t *src, animal_t *out, bool with_history,
+                             uint32_t *last_event) {
+    memset(out, 0, sizeof(animal_t));
+    record_header_t hdr;
+    esp_err_t ret = record_open(src, &hdr);
+    if (ret != ESP_OK) return ret;
+
+    memcpy(out->id, hdr.id, sizeof(out->id));
+    memcpy(out->name, hdr.name, sizeof(out->name));
+    memcpy(out->species, hdr.species, sizeof(out->species));
+    memcpy(out->origin, hdr.origin, sizeof(out->origin));
+    memcpy(out->registry_id, hdr.registry_id, sizeof(out->registry_id));
+    out->id[sizeof(out->id) - 1] = '\0';
+    out->name[sizeof(out->name) - 1] = '\0';
+    out->species[sizeof(out->species) - 1] = '\0';
+    out->origin[sizeof(out->origin) - 1] = '\0';
+    out->registry_id[sizeof(out->registry_id) - 1] = '\0';
+    out->dob = hdr.dob;
+    out->sex = (animal_sex_t)hdr.sex;
+    out->is_deleted = hdr.is_deleted != 0;
+    out->deleted_at = hdr.deleted_at;
+    if (last_event) memcpy(last_event, hdr.last_event, sizeof(hdr.last_event));
+    if (!with_history) goto done;
+
+    if (!record_strides_ok(&hdr)) {
+        ESP_LOGE(TAG, "Unexpected history stride in %s", src->name);
+        ret = ESP_ERR_INVALID_SIZE;
+        goto done;
+    }
+    size_t pos = hdr.header_size;
+    uint32_t crc = 0;
+    if (hdr.weight_bytes) {
+        uint8_t *packed_weights = malloc(hdr.weight_bytes);
+        if (!packed_weights) { ret = ESP_ERR_NO_MEM; goto done; }
+        ret = src_read(src, pos, packed_weights, hdr.weight_bytes);
+        if (ret == ESP_OK) {
+            crc = esp_rom_crc32_le(crc, packed_weights, hdr.weight_bytes);
+            ret = core_weight_series_decode(packed_weights, hdr.weight_bytes, hdr.weight_count,
+                                            &out->weights, &out->weight_count);
+        }
+        free(packed_weights);
+        if (ret != ESP_OK) goto done;
+        pos += hdr.weight_bytes;
+    }
+    if (hdr.event_count) {
+        out->events = malloc(hdr.event_count * sizeof(event_record_t));
+        if (!out->events) { ret = ESP_ERR_NO_MEM; goto done; }
+        ret = src_read(src, pos, out->events, hdr.event_count * sizeof(event_record_t));
+        if (ret != ESP_OK) goto done;
+        out->event_count = hdr.event_count;
+    }
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)out->events, out->event_count * sizeof(event_record_t));
+    if (crc != hdr.payload_crc) {
+        ESP_LOGE(TAG, "History checksum mismatch in %s", src->name);
+        ret = ESP_ERR_INVALID_CRC;
+        goto done;
+    }
+
+done:
+    src_close(src);
+    if (ret != ESP_OK) core_free_animal_content(out);
+    return ret;
+}
+
+esp_err_t core_record_read_file(const char *path, animal_t *out, bool with_history) {
+    record_src_t src;
+    record_src_file(&src, path);
+    return record_read(&src, out, with_history, NULL);
+}
+
+esp_err_t core_record_read_collection(core_collection_t *c, const char *animal_id, animal_t *out,
+                                      bool with_history) {
+    record_src_t src;
+    record_src_collection(&src, c, animal_id);
+    return record_read(&src, out, with_history, NULL);
+}
+
+esp_err_t core_record_write(const animal_t *animal) {
+    record_src_t dst;
+    esp_err_t ret = record_src_id(&dst, animal->id);
+    if (ret != ESP_OK) return ret;
+    return record_write_animal(&dst, animal);
+}
+
+esp_err_t core_record_write_packed(const animal_t *animal, const core_weight_series_t *weights) {
+    record_src_t dst;
+    esp_err_t ret = record_src_id(&dst, animal->id);
+    if (ret != ESP_OK) return ret;
+    return record_write(&dst, animal, weights);
+}
+
+esp_err_t core_record_read(const char *animal_id, animal_t *out, bool with_history) {
+    record_src_t src;
+    esp_err_t ret = record_src_id(&src, animal_id);
+    if (ret != ESP_OK) return ret;
+    return record_read(&src, out, with_history, NULL);
+}
+
+esp_err_t core_record_read_header(const char *animal_id, animal_t *out,
+                                  uint32_t last_event[CORE_EVENT_TYPE_COUNT]) {
+    record_src_t src;
+    esp_err_t ret = record_src_id(&src, animal_id);
+    if (ret != ESP_OK) return ret;
+    memset(last_event, 0, CORE_EVENT_TYPE_COUNT * sizeof(uint32_t));
+    return record_read(&src, out, false, last_event);
+}
+
+// Open an animal's record with its header read and its strides checked
+static esp_err_t record_open_id(record_src_t *src, const char *animal_id, record_header_t *hdr) {
+    esp_err_t ret = record_src_id(src, animal_id);
+    if (ret != ESP_OK) return ret;
+    ret = record_open(src, hdr);
+    if (ret == ESP_OK && !record_strides_ok(hdr)) {
+        ESP_LOGE(TAG, "Unexpected history stride in %s", src->name);
+        src_close(src);
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    return ret;
+}
+
+esp_err_t core_record_read_weights(const char *animal_id, size_t first, size_t max,
+                                   weight_record_t *out, size_t *out_count, size_t *out_total) {
+    *out_count = 0;
+    *out_total = 0;
+    record_header_t hdr;
+    record_src_t src;
+    esp_err_t ret = record_open_id(&src, animal_id, &hdr);
+    if (ret != ESP_OK) return ret;
+
+    *out_total = hdr.weight_count;
+    size_t n = first < hdr.weight_count ? hdr.weight_count - first : 0;
+    if (n > max) n = max;
+    if (n == 0) goto done;
+
+    // Varints cannot be seeked into: walk the section up to the slice
+    uint8_t *packed = malloc(hdr.weight_bytes);
+    if (!packed) { ret = ESP_ERR_NO_MEM; goto done; }
+    ret = src_read(&src, hdr.header_size, packed, hdr.weight_bytes);
+    if (ret == ESP_OK) {
+        core_weight_iter_t it;
+        core_weight_iter_init(&it, packed, hdr.weight_bytes, hdr.weight_count);
+        uint32_t date;
+        int32_t mg;
+        for (size_t i = 0; *out_count < n && core_weight_iter_next(&it, &date, &mg); i++) {
+            if (i < first) continue;
+            weight_record_t *w = &out[(*out_count)++];
+            memset(w, 0, sizeof(*w));
+            w->date = date;
+            w->value = mg / 1000.0f;
+            w->unit[0] = 'g';
+        }
+        if (*out_count != n) ret = ESP_ERR_INVALID_SIZE;
+    }
+    free(packed);
+
+done:
+    src_close(&src);
+    return ret;
+}
+
+esp_err_t core_record_read_events(const char *animal_id, size_t first, size_t max,
+                                  event_record_t *out, size_t *out_count, size_t *out_total) {
+    *out_count = 0;
+    *out_total = 0;
+    record_header_t hdr;
+    record_src_t src;
+    esp_err_t ret = record_open_id(&src, animal_id, &hdr);
+    if (ret != ESP_OK) return ret;
+
+    *out_total = hdr.event_count;
+    size_t n = first < hdr.event_count ? hdr.event_count - first : 0;
+    if (n > max) n = max;
+    if (n > 0) {
+        size_t offset = hdr.header_size + hdr.weight_bytes + first * sizeof(event_record_t);
+        ret = src_read(&src, offset, out, n * sizeof(event_record_t));
+        if (ret == ESP_OK) *out_count = n;
+    }
+    src_close(&src);
+    return ret;
+}
+
+bool core_record_exists(const char *animal_id) {
+#if CONFIG_CORE_RECORD_COLLECTION
+    return s_collection && core_collection_contains(s_collection, animal_id);
+#else
+    char filepath[FILEPATH_BUF_LEN];
+    if (core_record_path(filepath, sizeof(filepath), animal_id) != ESP_OK) return false;
+    struct stat st;
+    return stat(filepath, &st) == 0;
+#endif
+}
+
+esp_err_t core_record_size(const char *animal_id, size_t *out_size) {
+#if CONFIG_CORE_RECORD_COLLECTION
+    if (!s_collection) return ESP_ERR_INVALID_STATE;
+    return core_collection_size(s_collection, animal_id, out_size);
+#else
+    char filepath[FILEPATH_BUF_LEN];
+    esp_err_t ret = core_record_path(filepath, sizeof(filepath), animal_id);
+    if (ret != ESP_OK) return ret;
+    struct stat st;
+    if (stat(filepath, &st) != 0) return ESP_ERR_NOT_FOUND;
+    *out_size = (size_t)st.st_size;
+    return ESP_OK;
+#endif
+}
+
+esp_err_t core_record_remove(const char *animal_id) {
+#if CONFIG_CORE_RECORD_COLLECTION
+    if (!s_collection) return ESP_ERR_INVALID_STATE;
+    return core_collection_remove(s_collection, animal_id);
+#else
+    char filepath[FILEPATH_BUF_LEN];
+    esp_err_t ret = core_record_path(filepath, sizeof(filepath), animal_id);
+    if (ret != ESP_OK) return ret;
+    return remove(filepath) == 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+#endif
+}
+
+// =============================================================================
+// Record store
+// =============================================================================
+
+// Id of a "<id>.rec" file name, false for anything else
+static bool record_file_id(const char *name, char id[CORE_COLLECTION_KEY_LEN]) {
+    size_t len = strlen(name);
+    if (len <= 4 || len - 4 >= CORE_COLLECTION_KEY_LEN || strcmp(name + len - 4, ".rec") != 0) return false;
+    memcpy(id, name, len - 4);
+    id[len - 4] = '\0';
+    return true;
+}
+
+static esp_err_t record_files_foreach(core_record_id_cb_t cb, void *ctx) {
+    DIR *dir = opendir(ANIMAL_DIR);
+    if (!dir) return ESP_FAIL;
+    struct dirent *entry;
+    char id[CORE_COLLECTION_KEY_LEN];
+    while ((entry = readdir(dir)) != NULL) {
+        if (record_file_id(entry->d_name, id) && !cb(id, ctx)) break;
+    }
+    closedir(dir);
+    return ESP_OK;
+}
+
+#if CONFIG_CORE_RECORD_COLLECTION
+// Move a loose record file into the collection, dropping the file only once
+// the collection copy reads back
+static bool import_record_file(const char *animal_id, void *ctx) {
+    size_t *imported = ctx;
+    char path[FILEPATH_BUF_LEN];
+    if (core_record_path(path, sizeof(path), animal_id) != ESP_OK) return true;
+    animal_t animal;
+    if (core_record_read_file(path, &animal, true) != ESP_OK) return true;
+    // The collection is keyed by file name, whatever the header claims
+    strlcpy(animal.id, animal_id, sizeof(animal.id));
+    esp_err_t ret = core_record_write_collection(s_collection, &animal);
+    core_free_animal_content(&animal);
+
+    animal_t check;
+    if (ret == ESP_OK && core_record_read_collection(s_collection, animal_id, &check, true) == ESP_OK) {
+        core_free_animal_content(&check);
+        remove(path);
+        (*imported)++;
+    } else {
+        ESP_LOGE(TAG, "Import of %s into the collection failed, file kept", animal_id);
+    }
+    return true;
+}
+#endif
+
+esp_err_t core_record_store_init(void) {
+#if CONFIG_CORE_RECORD_COLLECTION
+    if (s_collection) return ESP_OK;
+    char path[FILEPATH_BUF_LEN];
+    int n = snprintf(path, sizeof(path), "%s/" COLLECTION_FILE, ANIMAL_DIR);
+    if (n < 0 || n >= (int)sizeof(path)) return ESP_ERR_INVALID_SIZE;
+    s_collection = core_collection_open(path);
+    if (!s_collection) return ESP_FAIL;
+    size_t imported = 0;
+    record_files_foreach(import_record_file, &imported);
+    if (imported) ESP_LOGI(TAG, "Moved %u record files into %s", (unsigned)imported, path);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t core_record_foreach_id(core_record_id_cb_t cb, void *ctx) {
+#if CONFIG_CORE_RECORD_COLLECTION
+    if (!s_collection) return ESP_ERR_INVALID_STATE;
+    return core_collection_foreach(s_collection, cb, ctx);
+#else
+    return record_files_foreach(cb, ctx);
+#endif
+}
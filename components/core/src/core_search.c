@@ -0,0 +1,117 @@
+#include "core_service.h"
+#include "core_index.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "CORE_SEARCH";
+
+// One cached result set per typed prefix: typing "pyt" after "py" refines
+// the "py" slots, deleting back to "py" reuses them as they are.
+#define SEARCH_SESSION_DEPTH 16
+#define SEARCH_QUERY_MAX     64
+
+typedef struct {
+    char query[SEARCH_QUERY_MAX];
+    uint16_t *slots;
+    size_t count;
+} search_level_t;
+
+struct core_search_session {
+    uint32_t generation;
+    search_level_t levels[SEARCH_SESSION_DEPTH];
+    size_t depth;
+    animal_summary_t *visible;
+    size_t visible_cap;
+};
+
+static void session_pop(core_search_session_t *session) {
+    search_level_t *top = &session->levels[--session->depth];
+    free(top->slots);
+    memset(top, 0, sizeof(*top));
+}
+
+static void session_reset(core_search_session_t *session) {
+    while (session->depth > 0) session_pop(session);
+}
+
+static bool is_prefix_ignore_case(const char *prefix, const char *query) {
+    size_t len = strlen(prefix);
+    return strlen(query) >= len && strncasecmp(prefix, query, len) == 0;
+}
+
+core_search_session_t *core_search_session_create(void) {
+    return calloc(1, sizeof(core_search_session_t));
+}
+
+void core_search_session_destroy(core_search_session_t *session) {
+    if (!session) return;
+    session_reset(session);
+    free(session->visible);
+    free(session);
+}
+
+esp_err_t core_search_session_update(core_search_session_t *session, const char *query,
+                                     size_t max_results, const animal_summary_t **out_list,
+                                     size_t *out_count, size_t *out_total) {
+    if (!session || !out_list || !out_count) return ESP_ERR_INVALID_ARG;
+    *out_list = NULL; *out_count = 0;
+    if (out_total) *out_total = 0;
+    if (!query) query = "";
+    if (strlen(query) >= SEARCH_QUERY_MAX) return ESP_ERR_INVALID_SIZE;
+
+    // Any save renumbers or edits entries: cached slot lists are then stale
+    uint32_t generation = core_index_generation();
+    if (generation != session->generation) {
+        session_reset(session);
+        session->generation = generation;
+    }
+
+    // Drop cached levels the new query no longer extends (deleted characters)
+    while (session->depth > 0 &&
+           !is_prefix_ignore_case(session->levels[session->depth - 1].query, query)) {
+        session_pop(session);
+    }
+
+    search_level_t *top = session->depth ? &session->levels[session->depth - 1] : NULL;
+    if (!top || strcasecmp(top->query, query) != 0) {
+        uint16_t *slots = NULL;
+        size_t count = 0;
+        // Extending a cached query only needs to re-test its matches; an
+        // empty level has none, and a NULL subset would mean the whole index
+        if (!top || top->count > 0) {
+            esp_err_t ret = core_index_match_slots(query, false,
+                                                   top ? top->slots : NULL, top ? top->count : 0,
+                                                   &slots, &count);
+            if (ret != ESP_OK) return ret;
+        }
+        if (session->depth == SEARCH_SESSION_DEPTH) {
+            // Full: the new level replaces the deepest one, which it extends anyway
+            session_pop(session);
+        }
+        top = &session->levels[session->depth++];
+        strlcpy(top->query, query, sizeof(top->query));
+        top->slots = slots;
+        top->count = count;
+    }
+
+    // Only the visible window is materialised into summaries
+    size_t wanted = (max_results && max_results < top->count) ? max_results : top->count;
+    if (wanted > session->visible_cap) {
+        animal_summary_t *grown = heap_caps_realloc(session->visible, wanted * sizeof(animal_summary_t),
+                                                    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!grown) grown = realloc(session->visible, wanted * sizeof(animal_summary_t));
+        if (!grown) {
+            ESP_LOGE(TAG, "Out of memory for %u visible results", (unsigned)wanted);
+            return ESP_ERR_NO_MEM;
+        }
+        session->visible = grown;
+        session->visible_cap = wanted;
+    }
+    *out_count = core_index_copy_summaries(top->slots, wanted, session->visible);
+    *out_list = session->visible;
+    if (out_total) *out_total = top->count;
+    return ESP_OK;
+}
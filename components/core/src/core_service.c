@@ -1,7 +1,11 @@
 #include "core_service.h"
+#include "core_index.h"
+#include "core_species.h"
+#include "core_internal.h"
 #include "reptile_storage.h"
 #include "board.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -9,23 +13,25 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <stdlib.h>
-#include <ctype.h>
 
 static const char *TAG = "CORE";
-#define ANIMAL_DIR "/sdcard/animals"
-#define REPORT_DIR "/sdcard/reports"
-#define LOG_FILE   "/sdcard/audit.log"
-#define FILEPATH_BUF_LEN 512
 
 static bool s_storage_ready = false;
+static char s_animal_dir[64];
+static char s_report_dir[64];
+static char s_log_file[64];
 
 static bool core_storage_ready(void) {
     return s_storage_ready;
 }
 
+const char *core_animal_dir(void) { return s_animal_dir; }
+const char *core_report_dir(void) { return s_report_dir; }
+const char *core_log_file(void) { return s_log_file; }
+
 static esp_err_t ensure_dirs(void) {
     if (!core_storage_ready()) {
-        ESP_LOGW(TAG, "Skipping directory creation: SD storage unavailable");
+        ESP_LOGW(TAG, "Skipping directory creation: storage unavailable");
         return ESP_ERR_NOT_SUPPORTED;
     }
     struct stat st = {0};
@@ -34,15 +40,122 @@ static esp_err_t ensure_dirs(void) {
     return ESP_OK;
 }
 
+// Returns the length of the id part when name is "<id><ext>", 0 otherwise
+static size_t record_id_len(const char *name, const char *ext) {
+    size_t len = strlen(name);
+    size_t ext_len = strlen(ext);
+    if (len <= ext_len || len - ext_len >= 37) return 0;
+    if (strcmp(name + len - ext_len, ext) != 0) return 0;
+    return len - ext_len;
+}
+
+// One-time conversion of legacy JSON records to the binary format
+static void core_migrate_json_records(void) {
+    DIR *dir = opendir(ANIMAL_DIR);
+    if (!dir) return;
+
+    size_t migrated = 0; struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t id_len = record_id_len(entry->d_name, ".json");
+        if (id_len == 0) continue;
+        char id[37];
+        memcpy(id, entry->d_name, id_len);
+        id[id_len] = '\0';
+
+        char filepath[FILEPATH_BUF_LEN];
+        int n = snprintf(filepath, sizeof(filepath), "%s/%s", ANIMAL_DIR, entry->d_name);
+        if (n < 0 || n >= (int)sizeof(filepath)) continue;
+        if (core_record_exists(id)) {
+            ESP_LOGW(TAG, "Binary record already present, leaving %s untouched", entry->d_name);
+            continue;
+        }
+
+        animal_t animal;
+        esp_err_t ret = core_animal_load_json(filepath, &animal, false);
+        if (ret != ESP_OK) continue;
+        // The record is keyed by its file name, whatever the JSON claims
+        strlcpy(animal.id, id, sizeof(animal.id));
+
+        ret = core_journal_merge(&animal);
+        if (ret == ESP_OK) ret = core_record_write(&animal);
+        core_free_animal_content(&animal);
+
+        // Only drop the JSON once the binary copy reads back cleanly
+        animal_t check;
+        if (ret == ESP_OK && core_record_read(id, &check, true) == ESP_OK) {
+            core_free_animal_content(&check);
+            core_journal_discard(id);
+            remove(filepath);
+            migrated++;
+        } else {
+            ESP_LOGE(TAG, "Migration failed for %s, JSON kept", entry->d_name);
+        }
+    }
+    closedir(dir);
+    if (migrated) ESP_LOGI(TAG, "Migrated %u JSON records to binary format", (unsigned)migrated);
+}
+
+// Header-only read: the summary never needs the history sections
+static bool index_load_record(const char *id, void *ctx) {
+    size_t *loaded = ctx;
+    animal_t animal;
+    uint32_t last_event[CORE_EVENT_TYPE_COUNT];
+    if (core_record_read_header(id, &animal, last_event) != ESP_OK) return true;
+    core_journal_last_events(id, last_event);
+    if (core_index_upsert(&animal) == ESP_OK) (*loaded)++;
+    core_alerts_track(&animal, last_event);
+    core_free_animal_content(&animal);
+    return true;
+}
+
+// Walk the record store once and populate the resident summary index
+static esp_err_t core_index_load(void) {
+    core_index_clear();
+    core_alerts_clear();
+    size_t loaded = 0;
+    esp_err_t ret = core_record_foreach_id(index_load_record, &loaded);
+    core_index_finish_load();
+    ESP_LOGI(TAG, "Summary index built: %u animals", (unsigned)loaded);
+    return ret;
+}
+
 esp_err_t core_init(void) {
     ESP_LOGI(TAG, "Initializing Core Service...");
-    s_storage_ready = board_sd_is_mounted();
+    esp_err_t ret = core_species_init();
+    if (ret == ESP_OK) ret = core_index_init();
+    if (ret == ESP_OK) ret = core_timeline_init();
+    if (ret == ESP_OK) ret = core_alerts_init();
+    if (ret == ESP_OK) ret = core_documents_init();
+    if (ret == ESP_OK) ret = core_cache_init();
+    if (ret != ESP_OK) return ret;
+
+    // SD card when present, internal flash otherwise (see STORAGE_BACKEND)
+    s_storage_ready = storage_backend_mount() == ESP_OK &&
+                      storage_path(s_animal_dir, sizeof(s_animal_dir), "animals") == ESP_OK &&
+                      storage_path(s_report_dir, sizeof(s_report_dir), "reports") == ESP_OK &&
+                      storage_path(s_log_file, sizeof(s_log_file), "audit.log") == ESP_OK;
     if (!s_storage_ready) {
-        ESP_LOGW(TAG, "Core storage disabled: SD not mounted");
+        ESP_LOGW(TAG, "Core storage disabled: no storage backend");
         return ESP_OK;
     }
 
     ensure_dirs();
+    // Finish or drop record writes interrupted by a power loss
+    storage_recover_dir(ANIMAL_DIR);
+    storage_recover_dir(REPORT_DIR);
+    if (core_record_store_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Record store unavailable");
+    }
+    core_migrate_json_records();
+    core_index_load();
+    if (core_documents_load() != ESP_OK) {
+        ESP_LOGE(TAG, "Document store unavailable");
+    }
+    core_timeline_start_build();
+    core_archive_start();
+#if CONFIG_CORE_BENCHMARK_AT_BOOT
+    core_bench_run();
+#endif
     return ESP_OK;
 }
 
@@ -67,364 +180,389 @@ esp_err_t core_save_animal(const animal_t *animal) {
     }
     if (!animal || strlen(animal->id) == 0) return ESP_ERR_INVALID_ARG;
     ensure_dirs();
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "id", animal->id);
-    cJSON_AddStringToObject(root, "name", animal->name);
-    cJSON_AddStringToObject(root, "species", animal->species);
-    cJSON_AddNumberToObject(root, "sex", animal->sex);
-    cJSON_AddNumberToObject(root, "dob", animal->dob);
-    cJSON_AddStringToObject(root, "origin", animal->origin);
-    cJSON_AddStringToObject(root, "registry_id", animal->registry_id);
-    cJSON_AddBoolToObject(root, "is_deleted", animal->is_deleted);
-
-    if (animal->weight_count > 0 && animal->weights) {
-        cJSON *w_array = cJSON_CreateArray();
-        for (size_t i = 0; i < animal->weight_count; i++) {
-            cJSON *item = cJSON_CreateObject();
-            cJSON_AddNumberToObject(item, "date", animal->weights[i].date);
-            cJSON_AddNumberToObject(item, "value", animal->weights[i].value);
-            cJSON_AddStringToObject(item, "unit", animal->weights[i].unit);
-            cJSON_AddItemToArray(w_array, item);
-        }
-        cJSON_AddItemToObject(root, "weights", w_array);
-    }
-    if (animal->event_count > 0 && animal->events) {
-        cJSON *e_array = cJSON_CreateArray();
-        for (size_t i = 0; i < animal->event_count; i++) {
-            cJSON *item = cJSON_CreateObject();
-            cJSON_AddNumberToObject(item, "date", animal->events[i].date);
-            cJSON_AddNumberToObject(item, "type", animal->events[i].type);
-            cJSON_AddStringToObject(item, "desc", animal->events[i].description);
-            cJSON_AddItemToArray(e_array, item);
-        }
-        cJSON_AddItemToObject(root, "events", e_array);
+    // The archive retention runs from the first save of the tombstone
+    animal_t stamped = *animal;
+    if (!stamped.is_deleted) stamped.deleted_at = 0;
+    else if (stamped.deleted_at == 0) stamped.deleted_at = (uint32_t)time(NULL);
+    animal = &stamped;
+    // Written back later by the cache; the journal is discarded with it
+    core_timeline_lock();
+    esp_err_t ret = core_cache_store(animal);
+    if (ret == ESP_OK) {
+        core_index_upsert(animal);
+        core_timeline_replace(animal);
+    }
+    core_timeline_unlock();
+    if (ret == ESP_OK) {
+        uint32_t last_event[CORE_EVENT_TYPE_COUNT];
+        core_animal_last_events(animal, last_event);
+        core_alerts_track(animal, last_event);
+        core_log_event(LOG_LEVEL_AUDIT, "CORE", "Animal saved");
     }
+    return ret;
+}
 
-    char filepath[FILEPATH_BUF_LEN];
-    int n = snprintf(filepath, sizeof(filepath), "%s/%s.json", ANIMAL_DIR, animal->id);
-    if (n < 0 || n >= (int)sizeof(filepath)) {
-        ESP_LOGW(TAG, "Path too long, skipping save: dir=%s id=%s", ANIMAL_DIR, animal->id);
-        cJSON_Delete(root);
-        return ESP_ERR_INVALID_SIZE;
+// populate: keep the decoded animal cached (single lookups, not full scans)
+esp_err_t core_load_animal(const char *id, animal_t *out_animal, bool populate) {
+    if (core_cache_get(id, out_animal, true) == ESP_OK) return ESP_OK;
+
+    // Appends take the timeline lock too: none can reach the journal between
+    // the merge and the fill, where the cached copy would miss it for good
+    core_timeline_lock();
+    esp_err_t ret = core_cache_get(id, out_animal, true);
+    if (ret == ESP_OK) goto done;
+    ret = core_record_read(id, out_animal, true);
+    if (ret != ESP_OK) {
+        if (ret == ESP_ERR_NOT_FOUND) ret = ESP_FAIL;
+        goto done;
+    }
+    ret = core_journal_merge(out_animal);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to merge history journal for %s", id);
+        core_free_animal_content(out_animal);
+        goto done;
     }
-    esp_err_t ret = storage_json_save(filepath, root);
-    cJSON_Delete(root);
-    if (ret == ESP_OK) core_log_event(LOG_LEVEL_AUDIT, "CORE", "Animal saved");
+    if (populate) core_cache_fill(out_animal);
+
+done:
+    core_timeline_unlock();
     return ret;
 }
 
+esp_err_t core_foreach_weight(const char *animal_id, core_weight_cb_t cb, void *ctx) {
+    if (!core_storage_ready()) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!animal_id || !cb) return ESP_ERR_INVALID_ARG;
+    if (core_cache_foreach_weight(animal_id, cb, ctx) == ESP_OK) return ESP_OK;
+
+    // Miss: the load caches the animal, then its packed weights are streamed
+    animal_t animal;
+    esp_err_t ret = core_load_animal(animal_id, &animal, true);
+    if (ret != ESP_OK) return ret;
+    if (core_cache_foreach_weight(animal_id, cb, ctx) != ESP_OK) {
+        for (size_t i = 0; i < animal.weight_count; i++) {
+            int32_t mg;
+            if (core_weight_to_mg(animal.weights[i].value, animal.weights[i].unit, &mg) != ESP_OK) continue;
+            if (!cb(animal.weights[i].date, mg, ctx)) break;
+        }
+    }
+    core_free_animal_content(&animal);
+    return ESP_OK;
+}
+
 esp_err_t core_get_animal(const char *id, animal_t *out_animal) {
     if (!core_storage_ready()) {
         return ESP_ERR_NOT_SUPPORTED;
     }
-    char filepath[FILEPATH_BUF_LEN];
-    int n = snprintf(filepath, sizeof(filepath), "%s/%s.json", ANIMAL_DIR, id);
-    if (n < 0 || n >= (int)sizeof(filepath)) {
-        ESP_LOGW(TAG, "Path too long when loading animal: dir=%s id=%s", ANIMAL_DIR, id);
-        return ESP_ERR_INVALID_SIZE;
+    return core_load_animal(id, out_animal, true);
+}
+
+esp_err_t core_query_events(const char *animal_id, const core_event_query_t *query, core_history_page_t *out_page) {
+    if (!core_storage_ready()) {
+        return ESP_ERR_NOT_SUPPORTED;
     }
-    cJSON *root = storage_json_load(filepath);
-    if (!root) return ESP_FAIL;
-    memset(out_animal, 0, sizeof(animal_t));
-
-    cJSON *item = cJSON_GetObjectItem(root, "id"); if (item) strncpy(out_animal->id, item->valuestring, 36);
-    item = cJSON_GetObjectItem(root, "name"); if (item) strncpy(out_animal->name, item->valuestring, 63);
-    item = cJSON_GetObjectItem(root, "species"); if (item) strncpy(out_animal->species, item->valuestring, 127);
-    item = cJSON_GetObjectItem(root, "sex"); if (item) out_animal->sex = (animal_sex_t)item->valueint;
-    item = cJSON_GetObjectItem(root, "dob"); if (item) out_animal->dob = item->valueint;
-    item = cJSON_GetObjectItem(root, "origin"); if (item) strncpy(out_animal->origin, item->valuestring, 15);
-    item = cJSON_GetObjectItem(root, "registry_id"); if (item) strncpy(out_animal->registry_id, item->valuestring, 31);
-    item = cJSON_GetObjectItem(root, "is_deleted"); if (item) out_animal->is_deleted = cJSON_IsTrue(item);
-
-    cJSON *weights = cJSON_GetObjectItem(root, "weights");
-    if (weights && cJSON_IsArray(weights)) {
-        int count = cJSON_GetArraySize(weights);
-        if (count > 0) {
-            out_animal->weights = malloc(count * sizeof(weight_record_t));
-            out_animal->weight_count = count;
-            for (int i = 0; i < count; i++) {
-                cJSON *w = cJSON_GetArrayItem(weights, i);
-                cJSON *d = cJSON_GetObjectItem(w, "date");
-                cJSON *v = cJSON_GetObjectItem(w, "value");
-                cJSON *u = cJSON_GetObjectItem(w, "unit");
-                if (d) out_animal->weights[i].date = d->valueint;
-                if (v) out_animal->weights[i].value = v->valuedouble;
-                if (u) strncpy(out_animal->weights[i].unit, u->valuestring, 7);
-            }
-        }
+    if (!animal_id || !query || !out_page) return ESP_ERR_INVALID_ARG;
+    memset(out_page, 0, sizeof(*out_page));
+    out_page->kind = CORE_HISTORY_EVENTS;
+    esp_err_t ret = core_cache_query_events(animal_id, query, out_page);
+    if (ret != ESP_ERR_NOT_FOUND) goto done;
+
+    // Miss: the load caches the animal, whose columns then serve the query
+    animal_t animal;
+    ret = core_load_animal(animal_id, &animal, true);
+    if (ret != ESP_OK) return ret;
+    ret = core_cache_query_events(animal_id, query, out_page);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        // Caching disabled: index this copy just for the query
+        core_event_columns_t cols;
+        core_event_columns_init(&cols);
+        ret = core_event_columns_build(&cols, animal.events, animal.event_count);
+        if (ret == ESP_OK) ret = core_event_columns_query(&cols, animal.events, query, out_page);
+        core_event_columns_free(&cols);
     }
-    cJSON *events = cJSON_GetObjectItem(root, "events");
-    if (events && cJSON_IsArray(events)) {
-        int count = cJSON_GetArraySize(events);
-        if (count > 0) {
-            out_animal->events = malloc(count * sizeof(event_record_t));
-            out_animal->event_count = count;
-            for (int i = 0; i < count; i++) {
-                cJSON *e = cJSON_GetArrayItem(events, i);
-                cJSON *d = cJSON_GetObjectItem(e, "date");
-                cJSON *t = cJSON_GetObjectItem(e, "type");
-                cJSON *desc = cJSON_GetObjectItem(e, "desc");
-                if (d) out_animal->events[i].date = d->valueint;
-                if (t) out_animal->events[i].type = (event_type_t)t->valueint;
-                if (desc) strncpy(out_animal->events[i].description, desc->valuestring, 63);
-            }
-        }
+    core_free_animal_content(&animal);
+
+done:
+    if (ret != ESP_OK) core_free_history_page(out_page);
+    return ret;
+}
+
+esp_err_t core_get_animal_header(const char *id, animal_t *out_animal) {
+    if (!core_storage_ready()) {
+        return ESP_ERR_NOT_SUPPORTED;
     }
-    cJSON_Delete(root);
-    return ESP_OK;
+    if (!id || !out_animal) return ESP_ERR_INVALID_ARG;
+    if (core_cache_get(id, out_animal, false) == ESP_OK) return ESP_OK;
+    esp_err_t ret = core_record_read(id, out_animal, false);
+    return ret == ESP_ERR_NOT_FOUND ? ESP_FAIL : ret;
+}
+
+size_t core_history_slice(size_t total, size_t offset, size_t limit, bool newest_first, size_t *first) {
+    size_t n = offset < total ? total - offset : 0;
+    if (n > limit) n = limit;
+    *first = n == 0 ? 0 : newest_first ? total - offset - n : offset;
+    return n;
 }
 
-// Helper for case-insensitive substring search
-static int str_contains_ignore_case(const char *haystack, const char *needle) {
-    if (!needle || !*needle) return 1;
-    if (!haystack || !*haystack) return 0;
-    
-    char *h = strdup(haystack);
-    char *n = strdup(needle);
-    for(int i=0; h[i]; i++) h[i] = tolower((unsigned char)h[i]);
-    for(int i=0; n[i]; i++) n[i] = tolower((unsigned char)n[i]);
-    
-    int ret = (strstr(h, n) != NULL);
-    free(h); free(n);
+// Miss: seek to the slice in the record, then take the rest from the journal,
+// whose entries follow the record's. The journal stays smaller than the record.
+// Caller holds the timeline lock, so no write-back or compaction folds the
+// journal into the record between the two reads.
+static esp_err_t history_page_from_disk(const char *animal_id, size_t offset, size_t limit,
+                                        bool newest_first, core_history_page_t *page) {
+    animal_t journal;
+    memset(&journal, 0, sizeof(journal));
+    strlcpy(journal.id, animal_id, sizeof(journal.id));
+    esp_err_t ret = core_journal_merge(&journal);
+    if (ret != ESP_OK) goto done;
+
+    bool weights = page->kind == CORE_HISTORY_WEIGHTS;
+    size_t item_size = weights ? sizeof(weight_record_t) : sizeof(event_record_t);
+    size_t journaled = weights ? journal.weight_count : journal.event_count;
+    size_t in_record = 0, got = 0;
+    ret = weights ? core_record_read_weights(animal_id, 0, 0, NULL, &got, &in_record)
+                  : core_record_read_events(animal_id, 0, 0, NULL, &got, &in_record);
+    if (ret != ESP_OK) goto done;
+
+    page->total = in_record + journaled;
+    size_t first;
+    size_t n = core_history_slice(page->total, offset, limit, newest_first, &first);
+    if (n == 0) goto done;
+    uint8_t *items = malloc(n * item_size);
+    if (!items) { ret = ESP_ERR_NO_MEM; goto done; }
+    if (weights) page->weights = (weight_record_t *)items;
+    else page->events = (event_record_t *)items;
+
+    size_t from_record = first < in_record ? in_record - first : 0;
+    if (from_record > n) from_record = n;
+    if (from_record) {
+        ret = weights ? core_record_read_weights(animal_id, first, from_record, page->weights, &got, &in_record)
+                      : core_record_read_events(animal_id, first, from_record, page->events, &got, &in_record);
+        if (ret == ESP_OK && got != from_record) ret = ESP_ERR_INVALID_SIZE;
+        if (ret != ESP_OK) goto done;
+    }
+    if (n > from_record) {
+        size_t from_journal = first + from_record - in_record;
+        const uint8_t *src = weights ? (const uint8_t *)journal.weights : (const uint8_t *)journal.events;
+        memcpy(items + from_record * item_size, src + from_journal * item_size, (n - from_record) * item_size);
+    }
+    for (size_t i = from_record; weights && i < n; i++) core_weight_normalize(&page->weights[i]);
+    page->count = n;
+
+done:
+    core_free_animal_content(&journal);
     return ret;
 }
 
-esp_err_t core_list_animals(animal_summary_t **out_list, size_t *out_count) {
-    return core_search_animals(NULL, out_list, out_count);
+static esp_err_t history_page_from_cache(const char *animal_id, size_t offset, size_t limit,
+                                         bool newest_first, core_history_page_t *page) {
+    return page->kind == CORE_HISTORY_WEIGHTS
+        ? core_cache_page_weights(animal_id, offset, limit, newest_first,
+                                  &page->weights, &page->count, &page->total)
+        : core_cache_page_events(animal_id, offset, limit, newest_first,
+                                 &page->events, &page->count, &page->total);
 }
 
-esp_err_t core_search_animals(const char *query, animal_summary_t **out_list, size_t *out_count) {
+esp_err_t core_get_history_page(const char *animal_id, core_history_kind_t kind, size_t offset,
+                                size_t limit, core_history_order_t order, core_history_page_t *out_page) {
     if (!core_storage_ready()) {
         return ESP_ERR_NOT_SUPPORTED;
     }
-    *out_list = NULL; *out_count = 0;
-    DIR *dir = opendir(ANIMAL_DIR);
-    if (!dir) return ESP_FAIL;
-    
-    // First pass: count matches
-    size_t count = 0; struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".json")) {
-            if (query == NULL || strlen(query) == 0) {
-                count++;
-            } else {
-                // Need to load to check name/species
-                char filepath[FILEPATH_BUF_LEN];
-                int path_len = snprintf(filepath, sizeof(filepath), "%s/%s", ANIMAL_DIR, entry->d_name);
-                if (path_len < 0 || path_len >= (int)sizeof(filepath)) {
-                    ESP_LOGW(TAG, "Path too long, skipping entry: dir=%s name=%s", ANIMAL_DIR, entry->d_name);
-                    continue;
-                }
-                cJSON *root = storage_json_load(filepath);
-                if (root) {
-                    cJSON *name = cJSON_GetObjectItem(root, "name");
-                    cJSON *species = cJSON_GetObjectItem(root, "species");
-                    if (name && species) {
-                        if (str_contains_ignore_case(name->valuestring, query) || 
-                            str_contains_ignore_case(species->valuestring, query)) {
-                            count++;
-                        }
-                    }
-                    cJSON_Delete(root);
-                }
-            }
+    if (!animal_id || !out_page) return ESP_ERR_INVALID_ARG;
+    memset(out_page, 0, sizeof(*out_page));
+    out_page->kind = kind;
+    bool newest_first = order == CORE_HISTORY_NEWEST_FIRST;
+
+    // A hit is served from memory; a miss does not populate the cache, so
+    // paging through a long history never decodes all of it
+    esp_err_t ret = history_page_from_cache(animal_id, offset, limit, newest_first, out_page);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        // Cached meanwhile by a save: the copy on disk may be behind it
+        core_timeline_lock();
+        ret = history_page_from_cache(animal_id, offset, limit, newest_first, out_page);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            ret = history_page_from_disk(animal_id, offset, limit, newest_first, out_page);
         }
+        core_timeline_unlock();
+    }
+    if (ret != ESP_OK) {
+        core_free_history_page(out_page);
+        return ret == ESP_ERR_NOT_FOUND ? ESP_FAIL : ret;
     }
-    rewinddir(dir);
-
-    if (count == 0) { closedir(dir); return ESP_OK; }
-    animal_summary_t *list = malloc(count * sizeof(animal_summary_t));
-    if (!list) { closedir(dir); return ESP_ERR_NO_MEM; }
 
-    size_t idx = 0;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".json")) {
-            char filepath[FILEPATH_BUF_LEN];
-            int path_len = snprintf(filepath, sizeof(filepath), "%s/%s", ANIMAL_DIR, entry->d_name);
-            if (path_len < 0 || path_len >= (int)sizeof(filepath)) {
-                ESP_LOGW(TAG, "Path too long, skipping entry: dir=%s name=%s", ANIMAL_DIR, entry->d_name);
-                continue;
-            }
-            cJSON *root = storage_json_load(filepath);
-            if (root) {
-                if (!cJSON_IsTrue(cJSON_GetObjectItem(root, "is_deleted"))) {
-                    cJSON *id = cJSON_GetObjectItem(root, "id");
-                    cJSON *name = cJSON_GetObjectItem(root, "name");
-                    cJSON *species = cJSON_GetObjectItem(root, "species");
-                    
-                    bool match = false;
-                    if (query == NULL || strlen(query) == 0) match = true;
-                    else if (name && species) {
-                        if (str_contains_ignore_case(name->valuestring, query) || 
-                            str_contains_ignore_case(species->valuestring, query)) {
-                            match = true;
-                        }
-                    }
-
-                    if (match && id && name && species) {
-                        strncpy(list[idx].id, id->valuestring, 36); list[idx].id[36]=0;
-                        strncpy(list[idx].name, name->valuestring, 63); list[idx].name[63]=0;
-                        strncpy(list[idx].species, species->valuestring, 127); list[idx].species[127]=0;
-                        idx++;
-                    }
-                }
-                cJSON_Delete(root);
-            }
+    // Slices are chronological; reverse in place for newest first
+    for (size_t i = 0, j = out_page->count; newest_first && i + 1 < j; i++, j--) {
+        if (kind == CORE_HISTORY_WEIGHTS) {
+            weight_record_t tmp = out_page->weights[i];
+            out_page->weights[i] = out_page->weights[j - 1];
+            out_page->weights[j - 1] = tmp;
+        } else {
+            event_record_t tmp = out_page->events[i];
+            out_page->events[i] = out_page->events[j - 1];
+            out_page->events[j - 1] = tmp;
         }
     }
-    closedir(dir);
-    *out_list = list; *out_count = idx;
     return ESP_OK;
 }
 
-void core_free_animal_list(animal_summary_t *list) { if (list) free(list); }
+void core_free_history_page(core_history_page_t *page) {
+    if (!page) return;
+    free(page->weights);
+    free(page->events);
+    page->weights = NULL;
+    page->events = NULL;
+    page->count = 0;
+}
 
-esp_err_t core_add_weight(const char *animal_id, float weight, const char *unit) {
+esp_err_t core_scan(const core_scan_filter_t *filter, core_scan_visitor_t visitor, void *ctx) {
     if (!core_storage_ready()) {
         return ESP_ERR_NOT_SUPPORTED;
     }
-    animal_t animal;
-    if (core_get_animal(animal_id, &animal) != ESP_OK) return ESP_FAIL;
-    size_t new_count = animal.weight_count + 1;
-    weight_record_t *new_weights = realloc(animal.weights, new_count * sizeof(weight_record_t));
-    if (!new_weights) { core_free_animal_content(&animal); return ESP_ERR_NO_MEM; }
-    animal.weights = new_weights;
-    animal.weights[animal.weight_count].date = time(NULL);
-    animal.weights[animal.weight_count].value = weight;
-    strncpy(animal.weights[animal.weight_count].unit, unit, 7);
-    animal.weight_count = new_count;
-    esp_err_t ret = core_save_animal(&animal);
-    core_free_animal_content(&animal);
-    return ret;
+    if (!visitor) return ESP_ERR_INVALID_ARG;
+    static const core_scan_filter_t s_default_filter = { .level = CORE_SCAN_SUMMARY };
+    if (!filter) filter = &s_default_filter;
+
+    core_index_entry_t *entries = NULL;
+    size_t count = 0;
+    esp_err_t ret = core_index_snapshot(filter->query, filter->include_deleted, &entries, &count);
+    if (ret != ESP_OK) return ret;
+
+    for (size_t i = 0; i < count; i++) {
+        const core_index_entry_t *e = &entries[i];
+        animal_t animal;
+        if (filter->level == CORE_SCAN_SUMMARY) {
+            memset(&animal, 0, sizeof(animal));
+            memcpy(animal.id, e->summary.id, sizeof(animal.id));
+            memcpy(animal.name, e->summary.name, sizeof(animal.name));
+            strlcpy(animal.species, core_species_name(e->summary.species_id), sizeof(animal.species));
+            animal.sex = e->sex;
+            animal.dob = e->dob;
+            memcpy(animal.registry_id, e->registry_id, sizeof(animal.registry_id));
+            animal.is_deleted = e->is_deleted;
+        } else if (filter->level == CORE_SCAN_HEADER) {
+            // A cached copy may hold a save not yet written back
+            if (core_cache_get(e->summary.id, &animal, false) != ESP_OK &&
+                core_record_read(e->summary.id, &animal, false) != ESP_OK) continue;
+        } else {
+            // Full scans must not flush the working set out of the cache
+            if (core_load_animal(e->summary.id, &animal, false) != ESP_OK) continue;
+        }
+        bool keep_going = visitor(&animal, ctx);
+        core_free_animal_content(&animal);
+        if (!keep_going) break;
+    }
+    free(entries);
+    return ESP_OK;
 }
 
-esp_err_t core_add_event(const char *animal_id, event_type_t type, const char *description) {
+esp_err_t core_list_animals(animal_summary_t **out_list, size_t *out_count) {
+    return core_search_animals(NULL, out_list, out_count);
+}
+
+esp_err_t core_search_animals(const char *query, animal_summary_t **out_list, size_t *out_count) {
+    *out_list = NULL; *out_count = 0;
     if (!core_storage_ready()) {
         return ESP_ERR_NOT_SUPPORTED;
     }
+    // Served from the resident index, no file I/O. Summaries carry the
+    // species id; callers resolve it with core_species_name() on output.
+    uint16_t *slots = NULL;
+    size_t count = 0;
+    esp_err_t ret = core_index_match_slots(query, false, NULL, 0, &slots, &count);
+    if (ret != ESP_OK || count == 0) return ret;
+
+    animal_summary_t *list = malloc(count * sizeof(animal_summary_t));
+    if (!list) { free(slots); return ESP_ERR_NO_MEM; }
+    *out_count = core_index_copy_summaries(slots, count, list);
+    *out_list = list;
+    free(slots);
+    return ESP_OK;
+}
+
+static bool stats_visitor(const animal_t *animal, void *ctx) {
+    core_stats_t *stats = ctx;
+    stats->animal_count++;
+    if (animal->sex == SEX_MALE) stats->male_count++;
+    else if (animal->sex == SEX_FEMALE) stats->female_count++;
+    else stats->unknown_sex_count++;
+    return true;
+}
+
+esp_err_t core_get_stats(core_stats_t *out_stats) {
+    memset(out_stats, 0, sizeof(*out_stats));
+    return core_scan(NULL, stats_visitor, out_stats);
+}
+
+void core_free_animal_list(animal_summary_t *list) { if (list) free(list); }
+
+// Fold the journal into the base record once it outgrows it
+// The get and the save hold the timeline lock so that no append lands
+// between them, to be dropped with the journal the save folds in
+static esp_err_t core_compact_history(const char *animal_id) {
+    core_timeline_lock();
     animal_t animal;
-    if (core_get_animal(animal_id, &animal) != ESP_OK) return ESP_FAIL;
-    size_t new_count = animal.event_count + 1;
-    event_record_t *new_events = realloc(animal.events, new_count * sizeof(event_record_t));
-    if (!new_events) { core_free_animal_content(&animal); return ESP_ERR_NO_MEM; }
-    animal.events = new_events;
-    animal.events[animal.event_count].date = time(NULL);
-    animal.events[animal.event_count].type = type;
-    strncpy(animal.events[animal.event_count].description, description, 63);
-    animal.event_count = new_count;
-    esp_err_t ret = core_save_animal(&animal);
-    core_free_animal_content(&animal);
+    esp_err_t ret = core_get_animal(animal_id, &animal);
+    if (ret == ESP_OK) {
+        ret = core_save_animal(&animal);
+        core_free_animal_content(&animal);
+    }
+    core_timeline_unlock();
     return ret;
 }
 
-esp_err_t core_get_alerts(char ***out_list, size_t *out_count) {
+esp_err_t core_add_weight(const char *animal_id, float weight, const char *unit) {
     if (!core_storage_ready()) {
         return ESP_ERR_NOT_SUPPORTED;
     }
-    *out_list = NULL; *out_count = 0;
-    DIR *dir = opendir(ANIMAL_DIR);
-    if (!dir) return ESP_FAIL;
-
-    // We can't easily pre-count alerts without loading files.
-    // So we'll use a dynamic list approach or just 2 passes. 2 passes is safer for memory on embedded.
-    
-    size_t count = 0; struct dirent *entry;
-    time_t now = time(NULL);
-    const double ALERT_SECONDS = 21 * 24 * 3600; // 21 days
-
-    // Pass 1: Count
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".json")) {
-            char filepath[FILEPATH_BUF_LEN];
-            int path_len = snprintf(filepath, sizeof(filepath), "%s/%s", ANIMAL_DIR, entry->d_name);
-            if (path_len < 0 || path_len >= (int)sizeof(filepath)) {
-                ESP_LOGW(TAG, "Path too long, skipping entry: dir=%s name=%s", ANIMAL_DIR, entry->d_name);
-                continue;
-            }
-            cJSON *root = storage_json_load(filepath);
-            if (root) {
-                if (!cJSON_IsTrue(cJSON_GetObjectItem(root, "is_deleted"))) {
-                    cJSON *events = cJSON_GetObjectItem(root, "events");
-                    time_t last_feed = 0;
-                    if (events && cJSON_IsArray(events)) {
-                        int n = cJSON_GetArraySize(events);
-                        for (int i=0; i<n; i++) {
-                            cJSON *e = cJSON_GetArrayItem(events, i);
-                            cJSON *t = cJSON_GetObjectItem(e, "type");
-                            cJSON *d = cJSON_GetObjectItem(e, "date");
-                            if (t && t->valueint == EVENT_FEEDING && d) {
-                                if (d->valueint > last_feed) last_feed = d->valueint;
-                            }
-                        }
-                    }
-                    // If never fed or fed long ago
-                    if (last_feed == 0 || difftime(now, last_feed) > ALERT_SECONDS) {
-                        count++;
-                    }
-                }
-                cJSON_Delete(root);
-            }
-        }
-    }
-    rewinddir(dir);
-
-    if (count == 0) { closedir(dir); return ESP_OK; }
-    char **list = malloc(count * sizeof(char*));
-    
-    size_t idx = 0;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".json")) {
-            char filepath[FILEPATH_BUF_LEN];
-            int path_len = snprintf(filepath, sizeof(filepath), "%s/%s", ANIMAL_DIR, entry->d_name);
-            if (path_len < 0 || path_len >= (int)sizeof(filepath)) {
-                ESP_LOGW(TAG, "Path too long, skipping entry: dir=%s name=%s", ANIMAL_DIR, entry->d_name);
-                continue;
-            }
-            cJSON *root = storage_json_load(filepath);
-            if (root) {
-                if (!cJSON_IsTrue(cJSON_GetObjectItem(root, "is_deleted"))) {
-                    cJSON *events = cJSON_GetObjectItem(root, "events");
-                    time_t last_feed = 0;
-                    if (events && cJSON_IsArray(events)) {
-                        int n = cJSON_GetArraySize(events);
-                        for (int i=0; i<n; i++) {
-                            cJSON *e = cJSON_GetArrayItem(events, i);
-                            cJSON *t = cJSON_GetObjectItem(e, "type");
-                            cJSON *d = cJSON_GetObjectItem(e, "date");
-                            if (t && t->valueint == EVENT_FEEDING && d) {
-                                if (d->valueint > last_feed) last_feed = d->valueint;
-                            }
-                        }
-                    }
-                    
-                    if (last_feed == 0 || difftime(now, last_feed) > ALERT_SECONDS) {
-                        cJSON *name = cJSON_GetObjectItem(root, "name");
-                        char buf[128];
-                        int days = (last_feed == 0) ? -1 : (int)(difftime(now, last_feed) / (24*3600));
-                        if (days == -1) snprintf(buf, sizeof(buf), "%s: Jamais nourri", name ? name->valuestring : "?");
-                        else snprintf(buf, sizeof(buf), "%s: Jeun de %d jours", name ? name->valuestring : "?", days);
-                        
-                        list[idx] = strdup(buf);
-                        idx++;
-                    }
-                }
-                cJSON_Delete(root);
-            }
-        }
+    if (!animal_id || !core_index_contains(animal_id)) return ESP_FAIL;
+
+    // Normalized at ingest: history is kept in grams, packed as milligrams
+    int32_t mg;
+    if (core_weight_to_mg(weight, unit, &mg) != ESP_OK) return ESP_ERR_INVALID_ARG;
+    weight_record_t record = {0};
+    record.date = time(NULL);
+    record.value = mg / 1000.0f;
+    strlcpy(record.unit, "g", sizeof(record.unit));
+    core_timeline_lock();
+    esp_err_t ret = core_cache_append_weight(animal_id, &record);
+    if (ret == ESP_OK) core_timeline_note(animal_id, CORE_TIMELINE_WEIGHT, record.date);
+    core_timeline_unlock();
+    // A pending write-back already folds the journal in
+    if (ret == ESP_OK && !core_cache_dirty(animal_id) && core_journal_needs_compaction(animal_id)) {
+        ret = core_compact_history(animal_id);
     }
-    closedir(dir);
-    *out_list = list; *out_count = idx;
-    return ESP_OK;
+    return ret;
 }
 
-void core_free_alert_list(char **list, size_t count) {
-    if (list) {
-        for (size_t i = 0; i < count; i++) free(list[i]);
-        free(list);
+esp_err_t core_add_event(const char *animal_id, event_type_t type, const char *description) {
+    if (!core_storage_ready()) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!animal_id || !core_index_contains(animal_id)) return ESP_FAIL;
+
+    event_record_t record = {0};
+    record.date = time(NULL);
+    record.type = type;
+    strncpy(record.description, description, 63);
+    core_timeline_lock();
+    esp_err_t ret = core_cache_append_event(animal_id, &record);
+    if (ret == ESP_OK) core_timeline_note(animal_id, (uint8_t)type, record.date);
+    core_timeline_unlock();
+    if (ret == ESP_OK) core_alerts_note_event(animal_id, type, record.date);
+    // A pending write-back already folds the journal in
+    if (ret == ESP_OK && !core_cache_dirty(animal_id) && core_journal_needs_compaction(animal_id)) {
+        ret = core_compact_history(animal_id);
     }
+    return ret;
 }
 
-esp_err_t core_save_document(const document_t *doc) { return ESP_OK; }
+static bool report_weight_line(uint32_t date, int32_t mg, void *ctx) {
+    char value[24];
+    core_weight_format(mg, value, sizeof(value));
+    fprintf((FILE *)ctx, "- %s (ts: %lu)\n", value, (unsigned long)date);
+    return true;
+}
 
 esp_err_t core_generate_report(const char *animal_id) {
     if (!core_storage_ready()) {
@@ -445,9 +583,19 @@ esp_err_t core_generate_report(const char *animal_id) {
     fprintf(f, "FICHE D'IDENTIFICATION\n======================\n\nNom: %s\nEspece: %s\n", animal.name, animal.species);
     fprintf(f, "Sexe: %s\nOrigine: %s\nI-FAP: %s\n", (animal.sex==SEX_MALE?"Male":(animal.sex==SEX_FEMALE?"Femelle":"Inconnu")), animal.origin, animal.registry_id);
     fprintf(f, "\n--- Historique Poids ---\n");
-    if (animal.weights) for(size_t i=0; i<animal.weight_count; i++) fprintf(f, "- %.1f %s (ts: %lu)\n", animal.weights[i].value, animal.weights[i].unit, (unsigned long)animal.weights[i].date);
+    core_foreach_weight(animal_id, report_weight_line, f);
     fprintf(f, "\n--- Evenements ---\n");
     if (animal.events) for(size_t i=0; i<animal.event_count; i++) fprintf(f, "- [%d] %s (ts: %lu)\n", animal.events[i].type, animal.events[i].description, (unsigned long)animal.events[i].date);
+    fprintf(f, "\n--- Documents ---\n");
+    document_t *docs = NULL;
+    size_t doc_count = 0;
+    if (core_list_animal_documents(animal_id, &docs, &doc_count) == ESP_OK) {
+        for (size_t i = 0; i < doc_count; i++) {
+            fprintf(f, "- %s %s (emis: %lu, expire: %lu)\n", docs[i].type, docs[i].ref_number,
+                    (unsigned long)docs[i].date_issued, (unsigned long)docs[i].date_expire);
+        }
+        core_free_document_list(docs);
+    }
     fprintf(f, "\nGenere le: %lu\n", (unsigned long)time(NULL));
     fclose(f);
     core_free_animal_content(&animal);
@@ -0,0 +1,94 @@
+#include "core_species.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CORE_SPECIES";
+
+// Slot 0 is SPECIES_ID_NONE. A collection holds a handful of species, so a
+// linear lookup on intern (saves and index loads only) is enough.
+static const char **s_names = NULL;
+static size_t s_count = 0;
+static size_t s_capacity = 0;
+static SemaphoreHandle_t s_lock = NULL;
+
+static void species_lock(void) {
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void species_unlock(void) {
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+static esp_err_t table_reserve(size_t wanted) {
+    if (wanted <= s_capacity) return ESP_OK;
+    size_t new_cap = s_capacity ? s_capacity * 2 : 16;
+    const char **grown = heap_caps_realloc(s_names, new_cap * sizeof(*s_names), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!grown) grown = realloc(s_names, new_cap * sizeof(*s_names));
+    if (!grown) return ESP_ERR_NO_MEM;
+    if (s_capacity == 0) grown[s_count++] = "";
+    s_names = grown;
+    s_capacity = new_cap;
+    return ESP_OK;
+}
+
+esp_err_t core_species_init(void) {
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t core_species_intern(const char *name, species_id_t *out_id) {
+    *out_id = SPECIES_ID_NONE;
+    if (!name || !*name) return ESP_OK;
+    species_lock();
+
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 1; i < s_count; i++) {
+        if (strcmp(s_names[i], name) == 0) {
+            *out_id = (species_id_t)i;
+            goto done;
+        }
+    }
+    if (s_count > UINT16_MAX) {
+        ESP_LOGE(TAG, "Species table full");
+        ret = ESP_ERR_NO_MEM;
+        goto done;
+    }
+    ret = table_reserve(s_count + 1);
+    if (ret != ESP_OK) goto done;
+    size_t len = strlen(name) + 1;
+    char *copy = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!copy) copy = malloc(len);
+    if (!copy) {
+        ret = ESP_ERR_NO_MEM;
+        goto done;
+    }
+    memcpy(copy, name, len);
+    *out_id = (species_id_t)s_count;
+    s_names[s_count++] = copy;
+
+done:
+    species_unlock();
+    return ret;
+}
+
+const char *core_species_name(species_id_t id) {
+    if (id == SPECIES_ID_NONE) return "";
+    species_lock();
+    const char *name = id < s_count ? s_names[id] : "";
+    species_unlock();
+    return name;
+}
+
+size_t core_species_count(void) {
+    species_lock();
+    size_t count = s_count ? s_count : 1;
+    species_unlock();
+    return count;
+}
@@ -0,0 +1,324 @@
+#include "core_internal.h"
+#include "core_index.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CORE_TIMELINE";
+
+// One entry per weighing and event of every animal, sorted by
+// (date, slot, type, offset). Slots are core_index slots; offset is the
+// position of the entry in that animal's weight or event history.
+typedef struct {
+    uint32_t date;
+    uint16_t slot;
+    uint8_t type;      // event_type_t or CORE_TIMELINE_WEIGHT
+    uint8_t reserved;
+    uint32_t offset;
+} timeline_entry_t;
+
+// History lengths of a slot, to number the entries appended to it
+typedef struct {
+    uint32_t weights;
+    uint32_t events;
+    bool indexed;
+    bool deleted;      // Soft-deleted: no entries until restored
+} slot_state_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static timeline_entry_t *s_entries = NULL;
+static size_t s_count = 0;
+static size_t s_capacity = 0;
+static slot_state_t *s_slots = NULL;
+static size_t s_slot_capacity = 0;
+// Until the boot build finishes entries are appended unsorted and queries
+// are refused; slots it has not reached yet are left to it.
+static bool s_ready = false;
+
+void core_timeline_lock(void) {
+    if (s_lock) xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+}
+
+void core_timeline_unlock(void) {
+    if (s_lock) xSemaphoreGiveRecursive(s_lock);
+}
+
+static void *timeline_realloc(void *ptr, size_t size) {
+    void *grown = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return grown ? grown : realloc(ptr, size);
+}
+
+static int cmp_entry(const timeline_entry_t *x, const timeline_entry_t *y) {
+    if (x->date != y->date) return (x->date > y->date) - (x->date < y->date);
+    if (x->slot != y->slot) return (x->slot > y->slot) - (x->slot < y->slot);
+    if (x->type != y->type) return (x->type > y->type) - (x->type < y->type);
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+static int cmp_entry_qsort(const void *a, const void *b) {
+    return cmp_entry(a, b);
+}
+
+// First entry > key (or >= key when inclusive is set)
+static size_t entry_bound(const timeline_entry_t *key, bool inclusive) {
+    size_t lo = 0, hi = s_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = cmp_entry(&s_entries[mid], key);
+        if (c < 0 || (c == 0 && !inclusive)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static esp_err_t entries_reserve(size_t wanted) {
+    if (wanted <= s_capacity) return ESP_OK;
+    size_t new_cap = s_capacity ? s_capacity * 2 : 256;
+    while (new_cap < wanted) new_cap *= 2;
+    timeline_entry_t *grown = timeline_realloc(s_entries, new_cap * sizeof(timeline_entry_t));
+    if (!grown) return ESP_ERR_NO_MEM;
+    s_entries = grown;
+    s_capacity = new_cap;
+    return ESP_OK;
+}
+
+static slot_state_t *slot_state(uint16_t slot) {
+    if (slot >= s_slot_capacity) {
+        size_t new_cap = s_slot_capacity ? s_slot_capacity : 32;
+        while (new_cap <= slot) new_cap *= 2;
+        slot_state_t *grown = timeline_realloc(s_slots, new_cap * sizeof(slot_state_t));
+        if (!grown) return NULL;
+        memset(grown + s_slot_capacity, 0, (new_cap - s_slot_capacity) * sizeof(slot_state_t));
+        s_slots = grown;
+        s_slot_capacity = new_cap;
+    }
+    return &s_slots[slot];
+}
+
+// Merge a sorted batch into the sorted entries, back to front; during the
+// boot build it is only appended
+static void entries_insert(const timeline_entry_t *batch, size_t n) {
+    if (!s_ready) {
+        memcpy(&s_entries[s_count], batch, n * sizeof(timeline_entry_t));
+        s_count += n;
+        return;
+    }
+    size_t src = s_count, dst = s_count + n, k = n;
+    while (k > 0) {
+        if (src > 0 && cmp_entry(&s_entries[src - 1], &batch[k - 1]) > 0) {
+            s_entries[--dst] = s_entries[--src];
+        } else {
+            s_entries[--dst] = batch[--k];
+        }
+    }
+    s_count += n;
+}
+
+static void entries_remove_slot(uint16_t slot) {
+    size_t out = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        if (s_entries[i].slot != slot) s_entries[out++] = s_entries[i];
+    }
+    s_count = out;
+}
+
+// Re-index every entry of one animal, none if it is deleted (caller holds
+// the lock)
+static esp_err_t replace_locked(uint16_t slot, const animal_t *animal) {
+    slot_state_t *state = slot_state(slot);
+    if (!state) return ESP_ERR_NO_MEM;
+    size_t n = animal->is_deleted ? 0 : animal->weight_count + animal->event_count;
+    timeline_entry_t *batch = n ? malloc(n * sizeof(timeline_entry_t)) : NULL;
+    if (n && (!batch || entries_reserve(s_count + n) != ESP_OK)) {
+        free(batch);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t k = 0;
+    for (size_t i = 0; n && i < animal->weight_count; i++) {
+        batch[k++] = (timeline_entry_t){ .date = animal->weights[i].date, .slot = slot,
+                                         .type = CORE_TIMELINE_WEIGHT, .offset = (uint32_t)i };
+    }
+    for (size_t i = 0; n && i < animal->event_count; i++) {
+        batch[k++] = (timeline_entry_t){ .date = animal->events[i].date, .slot = slot,
+                                         .type = (uint8_t)animal->events[i].type, .offset = (uint32_t)i };
+    }
+    if (s_ready && n > 1) qsort(batch, n, sizeof(timeline_entry_t), cmp_entry_qsort);
+
+    entries_remove_slot(slot);
+    if (n) entries_insert(batch, n);
+    free(batch);
+    state->weights = animal->weight_count;
+    state->events = animal->event_count;
+    state->indexed = true;
+    state->deleted = animal->is_deleted;
+    return ESP_OK;
+}
+
+static void timeline_build_task(void *arg) {
+    int64_t start = esp_timer_get_time();
+    // Animals saved meanwhile get new slots: the count is re-read each turn
+    for (size_t i = 0; i < core_index_count(); i++) {
+        uint16_t slot = (uint16_t)i;
+        animal_summary_t summary;
+        if (core_index_copy_summaries(&slot, 1, &summary) != 1) continue;
+        // Held across the read: an append to this animal lands either before
+        // it (and is read) or after it (and is added to an indexed slot)
+        core_timeline_lock();
+        animal_t animal;
+        if (core_load_animal(summary.id, &animal, false) == ESP_OK) {
+            if (replace_locked(slot, &animal) != ESP_OK) {
+                ESP_LOGW(TAG, "Out of memory indexing %s", summary.id);
+            }
+            core_free_animal_content(&animal);
+        }
+        core_timeline_unlock();
+        // Background work: let the UI and the network run between animals
+        vTaskDelay(1);
+    }
+
+    core_timeline_lock();
+    qsort(s_entries, s_count, sizeof(timeline_entry_t), cmp_entry_qsort);
+    s_ready = true;
+    ESP_LOGI(TAG, "Timeline built: %u entries in %lld ms", (unsigned)s_count,
+             (long long)((esp_timer_get_time() - start) / 1000));
+    core_timeline_unlock();
+    vTaskDelete(NULL);
+}
+
+esp_err_t core_timeline_init(void) {
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateRecursiveMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void core_timeline_start_build(void) {
+    if (xTaskCreate(timeline_build_task, "core_timeline", 4096, NULL, 1, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "Timeline build task not started, timeline queries unavailable");
+    }
+}
+
+void core_timeline_note(const char *animal_id, uint8_t type, uint32_t date) {
+    uint16_t slot;
+    if (core_index_find_slot(animal_id, &slot) != ESP_OK) return;
+    core_timeline_lock();
+    slot_state_t *state = slot_state(slot);
+    if (state && (s_ready || state->indexed) && !state->deleted) {
+        uint32_t *length = type == CORE_TIMELINE_WEIGHT ? &state->weights : &state->events;
+        timeline_entry_t entry = { .date = date, .slot = slot, .type = type, .offset = *length };
+        if (entries_reserve(s_count + 1) == ESP_OK) {
+            entries_insert(&entry, 1);
+            (*length)++;
+        } else {
+            ESP_LOGW(TAG, "Out of memory, entry of %s not indexed", animal_id);
+        }
+    }
+    core_timeline_unlock();
+}
+
+void core_timeline_replace(const animal_t *animal) {
+    uint16_t slot;
+    if (core_index_find_slot(animal->id, &slot) != ESP_OK) return;
+    core_timeline_lock();
+    slot_state_t *state = slot_state(slot);
+    if (state && (s_ready || state->indexed) && replace_locked(slot, animal) != ESP_OK) {
+        ESP_LOGW(TAG, "Out of memory re-indexing %s", animal->id);
+    }
+    core_timeline_unlock();
+}
+
+void core_timeline_forget(const char *animal_id) {
+    uint16_t slot;
+    if (core_index_find_slot(animal_id, &slot) != ESP_OK) return;
+    core_timeline_lock();
+    slot_state_t *state = slot_state(slot);
+    entries_remove_slot(slot);
+    // Indexed and empty: the boot build has nothing left to add for it
+    if (state) *state = (slot_state_t){ .indexed = true };
+    core_timeline_unlock();
+}
+
+// =============================================================================
+// Queries
+// =============================================================================
+
+void core_timeline_cursor_init(core_timeline_cursor_t *cursor, uint32_t from, uint32_t to,
+                               uint32_t type_mask, core_history_order_t order) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->from = from;
+    cursor->to = to ? to : UINT32_MAX;
+    cursor->types = type_mask ? type_mask : UINT32_MAX;
+    cursor->order = order;
+}
+
+bool core_timeline_ready(void) {
+    core_timeline_lock();
+    bool ready = s_ready;
+    core_timeline_unlock();
+    return ready;
+}
+
+esp_err_t core_timeline_next(core_timeline_cursor_t *cursor, core_timeline_item_t *out,
+                             size_t max, size_t *out_count) {
+    if (!cursor || !out || !out_count) return ESP_ERR_INVALID_ARG;
+    *out_count = 0;
+    core_timeline_lock();
+    if (!s_ready) {
+        core_timeline_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Resume right after the last returned entry: positions move with
+    // inserts, keys do not. The first call seeks to the range bound.
+    bool newest_first = cursor->order == CORE_HISTORY_NEWEST_FIRST;
+    timeline_entry_t key = { .date = cursor->last_date, .slot = cursor->last_slot,
+                             .type = cursor->last_type, .offset = cursor->last_offset };
+    size_t pos;
+    if (newest_first) {
+        if (!cursor->started) {
+            timeline_entry_t bound = { .date = cursor->to, .slot = UINT16_MAX,
+                                       .type = UINT8_MAX, .offset = UINT32_MAX };
+            pos = entry_bound(&bound, false);
+        } else {
+            pos = entry_bound(&key, true);
+        }
+    } else {
+        timeline_entry_t bound = { .date = cursor->from };
+        pos = cursor->started ? entry_bound(&key, false) : entry_bound(&bound, true);
+    }
+
+    size_t n = 0;
+    while (n < max) {
+        if (newest_first ? pos == 0 : pos >= s_count) break;
+        const timeline_entry_t *e = newest_first ? &s_entries[--pos] : &s_entries[pos++];
+        if (e->date < cursor->from || e->date > cursor->to) break;
+        cursor->started = true;
+        cursor->last_date = e->date;
+        cursor->last_slot = e->slot;
+        cursor->last_type = e->type;
+        cursor->last_offset = e->offset;
+        if (!(cursor->types & CORE_EVENT_MASK(e->type))) continue;
+
+        core_timeline_item_t *item = &out[n++];
+        item->date = e->date;
+        item->type = e->type;
+        item->offset = e->offset;
+        animal_summary_t summary;
+        if (core_index_copy_summaries(&e->slot, 1, &summary) == 1) {
+            memcpy(item->animal_id, summary.id, sizeof(item->animal_id));
+            memcpy(item->name, summary.name, sizeof(item->name));
+        } else {
+            item->animal_id[0] = '\0';
+            item->name[0] = '\0';
+        }
+    }
+    core_timeline_unlock();
+    *out_count = n;
+    return ESP_OK;
+}
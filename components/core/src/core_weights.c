@@ -0,0 +1,189 @@
+#include "core_weights.h"
+#include "esp_heap_caps.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const struct {
+    const char *unit;
+    float mg;
+} s_units[] = {
+    { "mg", 1.0f },
+    { "g",  1000.0f },
+    { "kg", 1000000.0f },
+    { "oz", 28349.523f },
+    { "lb", 453592.37f },
+};
+
+esp_err_t core_weight_to_mg(float value, const char *unit, int32_t *out_mg) {
+    if (!unit || !*unit) unit = "g";
+    for (size_t i = 0; i < sizeof(s_units) / sizeof(s_units[0]); i++) {
+        if (strcasecmp(unit, s_units[i].unit) != 0) continue;
+        double mg = (double)value * s_units[i].mg;
+        if (!(mg > -2147483647.0 && mg < 2147483647.0)) return ESP_ERR_INVALID_ARG;
+        *out_mg = (int32_t)lround(mg);
+        return ESP_OK;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+void core_weight_normalize(weight_record_t *weight) {
+    int32_t mg;
+    if (core_weight_to_mg(weight->value, weight->unit, &mg) != ESP_OK &&
+        core_weight_to_mg(weight->value, "g", &mg) != ESP_OK) {
+        return;
+    }
+    weight->value = mg / 1000.0f;
+    memset(weight->unit, 0, sizeof(weight->unit));
+    weight->unit[0] = 'g';
+}
+
+void core_weight_format(int32_t mg, char *buf, size_t len) {
+    if (mg >= 1000000 || mg <= -1000000) {
+        snprintf(buf, len, "%.2f kg", mg / 1000000.0);
+    } else if (mg % 1000 == 0) {
+        snprintf(buf, len, "%ld g", (long)(mg / 1000));
+    } else {
+        snprintf(buf, len, "%.1f g", mg / 1000.0);
+    }
+}
+
+// =============================================================================
+// Varint encoding
+// =============================================================================
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *out) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// =============================================================================
+// Series
+// =============================================================================
+
+void core_weight_series_init(core_weight_series_t *series) {
+    memset(series, 0, sizeof(*series));
+}
+
+void core_weight_series_free(core_weight_series_t *series) {
+    free(series->data);
+    core_weight_series_init(series);
+}
+
+esp_err_t core_weight_series_reserve(core_weight_series_t *series, size_t extra_samples) {
+    size_t need = series->len + extra_samples * CORE_WEIGHT_SAMPLE_MAX;
+    if (need <= series->cap) return ESP_OK;
+    size_t cap = series->cap ? series->cap : 64;
+    while (cap < need) cap *= 2;
+    uint8_t *grown = heap_caps_realloc(series->data, cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!grown) grown = realloc(series->data, cap);
+    if (!grown) return ESP_ERR_NO_MEM;
+    series->data = grown;
+    series->cap = cap;
+    return ESP_OK;
+}
+
+esp_err_t core_weight_series_append(core_weight_series_t *series, uint32_t date, int32_t mg) {
+    esp_err_t ret = core_weight_series_reserve(series, 1);
+    if (ret != ESP_OK) return ret;
+    series->len += put_varint(series->data + series->len, zigzag((int64_t)date - series->last_date));
+    series->len += put_varint(series->data + series->len, zigzag((int64_t)mg - series->last_mg));
+    series->last_date = date;
+    series->last_mg = mg;
+    series->count++;
+    return ESP_OK;
+}
+
+esp_err_t core_weight_series_encode(core_weight_series_t *series, const weight_record_t *weights, size_t count) {
+    esp_err_t ret = core_weight_series_reserve(series, count);
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        int32_t mg = 0;
+        // Unknown units from old imports are kept as grams rather than dropped
+        if (core_weight_to_mg(weights[i].value, weights[i].unit, &mg) != ESP_OK) {
+            core_weight_to_mg(weights[i].value, "g", &mg);
+        }
+        ret = core_weight_series_append(series, weights[i].date, mg);
+    }
+    return ret;
+}
+
+esp_err_t core_weight_series_decode(const uint8_t *data, size_t len, uint32_t count,
+                                    weight_record_t **out, size_t *out_count) {
+    *out = NULL;
+    *out_count = 0;
+    if (!count) return ESP_OK;
+    weight_record_t *rows = heap_caps_malloc(count * sizeof(weight_record_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!rows) rows = malloc(count * sizeof(weight_record_t));
+    if (!rows) return ESP_ERR_NO_MEM;
+
+    core_weight_iter_t it;
+    core_weight_iter_init(&it, data, len, count);
+    size_t n = 0;
+    uint32_t date;
+    int32_t mg;
+    while (core_weight_iter_next(&it, &date, &mg)) {
+        rows[n].date = date;
+        rows[n].value = mg / 1000.0f;
+        memset(rows[n].unit, 0, sizeof(rows[n].unit));
+        rows[n].unit[0] = 'g';
+        n++;
+    }
+    if (n != count) {
+        free(rows);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out = rows;
+    *out_count = n;
+    return ESP_OK;
+}
+
+void core_weight_iter_init(core_weight_iter_t *it, const uint8_t *data, size_t len, uint32_t count) {
+    it->p = data;
+    it->end = data ? data + len : NULL;
+    it->remaining = data ? count : 0;
+    it->date = 0;
+    it->mg = 0;
+}
+
+bool core_weight_iter_next(core_weight_iter_t *it, uint32_t *date, int32_t *mg) {
+    if (!it->remaining) return false;
+    uint64_t d, m;
+    if (!get_varint(&it->p, it->end, &d) || !get_varint(&it->p, it->end, &m)) {
+        it->remaining = 0;
+        return false;
+    }
+    it->date = (uint32_t)((int64_t)it->date + unzigzag(d));
+    it->mg = (int32_t)((int64_t)it->mg + unzigzag(m));
+    it->remaining--;
+    *date = it->date;
+    *mg = it->mg;
+    return true;
+}
@@ -11,8 +11,10 @@
 #include "esp_timer.h"
 #include "esp_wifi.h"
 #include "cJSON.h"
+#include "json_arena.h"
 #include "core_service.h"
 #include "net_manager.h"
+#include "reptile_storage.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -174,23 +176,42 @@ void iot_mqtt_publish_stats(void)
 {
     if (!mqtt_client) return;
 
+    // Small, periodic document: internal RAM arena, reset after each publish
+    static json_arena_t *s_stats_arena = NULL;
+    if (!s_stats_arena) s_stats_arena = json_arena_create(1024, JSON_ARENA_INTERNAL);
+    json_arena_t *prev = json_arena_bind(s_stats_arena);
+
     cJSON *root = cJSON_CreateObject();
     cJSON_AddNumberToObject(root, "uptime", esp_timer_get_time() / 1000000);
     cJSON_AddNumberToObject(root, "free_heap", esp_get_free_heap_size());
     
-    // Get animal count
-    animal_summary_t *list = NULL;
-    size_t count = 0;
-    if (core_list_animals(&list, &count) == ESP_OK) {
-        cJSON_AddNumberToObject(root, "animal_count", count);
-        core_free_animal_list(list);
+    // Collection stats come from the resident index (no list allocation)
+    core_stats_t stats;
+    if (core_get_stats(&stats) == ESP_OK) {
+        cJSON_AddNumberToObject(root, "animal_count", stats.animal_count);
+        cJSON_AddNumberToObject(root, "male_count", stats.male_count);
+        cJSON_AddNumberToObject(root, "female_count", stats.female_count);
     }
 
+    // Hit ratio against capacity: CONFIG_CORE_CACHE_ENTRIES sizing
+    core_cache_stats_t cache;
+    core_get_cache_stats(&cache);
+    cJSON_AddNumberToObject(root, "cache_hits", cache.hits);
+    cJSON_AddNumberToObject(root, "cache_misses", cache.misses);
+    cJSON_AddNumberToObject(root, "cache_used", cache.used);
+
+    storage_nvs_stats_t nvs;
+    storage_nvs_get_stats(&nvs);
+    cJSON_AddNumberToObject(root, "nvs_commits", nvs.commits);
+    cJSON_AddNumberToObject(root, "nvs_commits_avoided", nvs.commits_avoided);
+
     char *json_str = cJSON_PrintUnformatted(root);
     esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_STATS, json_str, 0, 1, 0);
     
-    free(json_str);
+    cJSON_free(json_str);
     cJSON_Delete(root);
+    json_arena_bind(prev);
+    json_arena_reset(s_stats_arena);
     ESP_LOGI(TAG, "Stats published");
 }
 
@@ -215,6 +236,7 @@ esp_err_t iot_ota_start(const char *url)
     esp_err_t ret = esp_https_ota(&ota_cfg);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "OTA Successful, restarting...");
+        core_flush();
         esp_restart();
     } else {
         ESP_LOGE(TAG, "OTA Failed");
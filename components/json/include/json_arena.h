@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Resettable bump-pointer arena. While an arena is bound to the calling task
+ * (json_arena_bind()), every cJSON allocation of that task comes from it and
+ * cJSON_Delete()/cJSON_free() on its memory are no-ops; json_arena_reset()
+ * releases everything at once. Other tasks keep using the heap.
+ *
+ * Strings returned by cJSON_Print*() must be released with cJSON_free(),
+ * never free(), since they may live in an arena.
+ */
+typedef struct json_arena json_arena_t;
+
+typedef enum {
+    JSON_ARENA_PSRAM = 0,    // Large or long documents (falls back to internal RAM)
+    JSON_ARENA_INTERNAL,     // Small, latency-sensitive work
+} json_arena_mem_t;
+
+typedef struct {
+    size_t chunks;           // Chunks currently held
+    size_t used;             // Bytes handed out since the last reset
+    size_t peak;             // Largest 'used' seen, to size chunk_size
+} json_arena_stats_t;
+
+/**
+ * @brief Create an arena growing by chunk_size bytes (larger requests get a
+ *        chunk of their own). Installs the cJSON hooks on first use.
+ */
+json_arena_t *json_arena_create(size_t chunk_size, json_arena_mem_t mem);
+
+void json_arena_destroy(json_arena_t *arena);
+
+/**
+ * @brief 8-byte aligned scratch memory, valid until the next reset.
+ */
+void *json_arena_alloc(json_arena_t *arena, size_t size);
+
+/**
+ * @brief Release every allocation; the first chunk is kept for reuse.
+ */
+void json_arena_reset(json_arena_t *arena);
+
+/**
+ * @brief Route the calling task's cJSON allocations to arena (NULL: heap).
+ * @return The previously bound arena, to restore afterwards.
+ */
+json_arena_t *json_arena_bind(json_arena_t *arena);
+
+/**
+ * @brief Arena bound to the calling task, or NULL.
+ */
+json_arena_t *json_arena_current(void);
+
+void json_arena_get_stats(const json_arena_t *arena, json_arena_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
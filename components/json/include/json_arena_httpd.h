@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_http_server.h"
+#include "json_arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Context of a URI registered with json_arena_httpd_handler as its handler:
+ * the real handler, and the server's arena (a pointer to it, so that it can
+ * be created when the server starts; NULL arena: the heap is used).
+ */
+typedef struct {
+    esp_err_t (*handler)(httpd_req_t *req);
+    json_arena_t *const *arena;
+} json_arena_httpd_ctx_t;
+
+/**
+ * @brief httpd handler running the json_arena_httpd_ctx_t of req->user_ctx
+ *        with its arena bound: the handler's cJSON work and any
+ *        json_arena_alloc(json_arena_current(), ...) scratch is released by
+ *        one reset once the response is sent.
+ */
+esp_err_t json_arena_httpd_handler(httpd_req_t *req);
+
+#ifdef __cplusplus
+}
+#endif
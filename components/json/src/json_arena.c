@@ -0,0 +1,171 @@
+#include "json_arena.h"
+#include "cJSON.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 8
+
+// Every arena block is preceded by this tag. The word before a heap block is
+// the allocator's own size field, which never holds it: heap frees then skip
+// the chunk walk, the one cost most cJSON frees paid for the arenas.
+#define ARENA_TAG       0xA7E9A0B1u
+#define ARENA_TAG_SIZE  ARENA_ALIGN
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    uint8_t data[] __attribute__((aligned(ARENA_ALIGN)));
+} arena_chunk_t;
+
+struct json_arena {
+    arena_chunk_t *first;    // Kept across resets
+    arena_chunk_t *current;  // Last chunk of the list, the one being filled
+    size_t chunk_size;
+    uint32_t caps;
+    size_t used;
+    size_t peak;
+    json_arena_t *next;      // Registry of live arenas, see arena_owns()
+};
+
+// cJSON's free hook must tell arena memory from heap memory whichever task
+// frees it, so chunk lists are only changed under this lock.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static json_arena_t *s_arenas = NULL;
+static bool s_hooks_installed = false;
+static __thread json_arena_t *s_bound = NULL;
+
+static bool arena_owns(const void *ptr) {
+    const uint8_t *p = ptr;
+    uint32_t tag;
+    memcpy(&tag, p - sizeof(tag), sizeof(tag));
+    if (tag != ARENA_TAG) return false;
+
+    // Tagged: confirm against the live chunks, a stale tag must not leak
+    bool owned = false;
+    taskENTER_CRITICAL(&s_lock);
+    for (json_arena_t *a = s_arenas; a && !owned; a = a->next) {
+        for (arena_chunk_t *c = a->first; c; c = c->next) {
+            if (p >= c->data && p < c->data + c->size) { owned = true; break; }
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return owned;
+}
+
+static void *hook_malloc(size_t size) {
+    return s_bound ? json_arena_alloc(s_bound, size) : malloc(size);
+}
+
+static void hook_free(void *ptr) {
+    if (ptr && !arena_owns(ptr)) free(ptr);
+}
+
+static arena_chunk_t *chunk_new(size_t size, uint32_t caps) {
+    arena_chunk_t *c = heap_caps_malloc(sizeof(*c) + size, caps);
+    if (!c && (caps & MALLOC_CAP_SPIRAM)) c = malloc(sizeof(*c) + size);
+    if (!c) return NULL;
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+json_arena_t *json_arena_create(size_t chunk_size, json_arena_mem_t mem) {
+    json_arena_t *a = calloc(1, sizeof(*a));
+    if (!a) return NULL;
+    a->chunk_size = chunk_size ? chunk_size : 4096;
+    a->caps = (mem == JSON_ARENA_PSRAM ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL) | MALLOC_CAP_8BIT;
+    a->first = a->current = chunk_new(a->chunk_size, a->caps);
+    if (!a->first) { free(a); return NULL; }
+
+    taskENTER_CRITICAL(&s_lock);
+    a->next = s_arenas;
+    s_arenas = a;
+    bool install = !s_hooks_installed;
+    s_hooks_installed = true;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (install) {
+        // Heap behaviour is unchanged for tasks without a bound arena
+        cJSON_Hooks hooks = { .malloc_fn = hook_malloc, .free_fn = hook_free };
+        cJSON_InitHooks(&hooks);
+    }
+    return a;
+}
+
+void json_arena_destroy(json_arena_t *arena) {
+    if (!arena) return;
+    taskENTER_CRITICAL(&s_lock);
+    for (json_arena_t **pp = &s_arenas; *pp; pp = &(*pp)->next) {
+        if (*pp == arena) { *pp = arena->next; break; }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (s_bound == arena) s_bound = NULL;
+
+    arena_chunk_t *c = arena->first;
+    while (c) {
+        arena_chunk_t *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(arena);
+}
+
+void *json_arena_alloc(json_arena_t *arena, size_t size) {
+    size = ARENA_TAG_SIZE + ((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    arena_chunk_t *c = arena->current;
+    if (c->size - c->used < size) {
+        c = chunk_new(size > arena->chunk_size ? size : arena->chunk_size, arena->caps);
+        if (!c) return NULL;
+        taskENTER_CRITICAL(&s_lock);
+        arena->current->next = c;
+        arena->current = c;
+        taskEXIT_CRITICAL(&s_lock);
+    }
+    uint8_t *ptr = c->data + c->used + ARENA_TAG_SIZE;
+    const uint32_t tag = ARENA_TAG;
+    memcpy(ptr - sizeof(tag), &tag, sizeof(tag));
+    c->used += size;
+    arena->used += size;
+    if (arena->used > arena->peak) arena->peak = arena->used;
+    return ptr;
+}
+
+void json_arena_reset(json_arena_t *arena) {
+    if (!arena) return;
+    taskENTER_CRITICAL(&s_lock);
+    arena_chunk_t *extra = arena->first->next;
+    arena->first->next = NULL;
+    arena->first->used = 0;
+    arena->current = arena->first;
+    taskEXIT_CRITICAL(&s_lock);
+    arena->used = 0;
+
+    while (extra) {
+        arena_chunk_t *next = extra->next;
+        free(extra);
+        extra = next;
+    }
+}
+
+json_arena_t *json_arena_bind(json_arena_t *arena) {
+    json_arena_t *prev = s_bound;
+    s_bound = arena;
+    return prev;
+}
+
+json_arena_t *json_arena_current(void) {
+    return s_bound;
+}
+
+void json_arena_get_stats(const json_arena_t *arena, json_arena_stats_t *out) {
+    out->chunks = 0;
+    for (const arena_chunk_t *c = arena->first; c; c = c->next) out->chunks++;
+    out->used = arena->used;
+    out->peak = arena->peak;
+}
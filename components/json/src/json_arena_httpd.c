@@ -0,0 +1,11 @@
+#include "json_arena_httpd.h"
+
+esp_err_t json_arena_httpd_handler(httpd_req_t *req) {
+    const json_arena_httpd_ctx_t *ctx = req->user_ctx;
+    json_arena_t *arena = *ctx->arena;
+    json_arena_t *prev = json_arena_bind(arena);
+    esp_err_t ret = ctx->handler(req);
+    json_arena_bind(prev);
+    json_arena_reset(arena);
+    return ret;
+}
@@ -3,13 +3,24 @@
 #include "esp_log.h"
 #include "core_service.h"
 #include "cJSON.h"
+#include "json_arena_httpd.h"
+#include "reptile_storage.h"
 #include "board.h"
 #include <sys/stat.h>
+#include <ctype.h>
+#include <errno.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 static const char *TAG = "NET_SERVER";
 static httpd_handle_t server = NULL;
+static json_arena_t *s_arena = NULL;
+
+#define NET_ARENA_CHUNK_SIZE (32 * 1024)
+#define NET_EVENTS_BATCH 16
+#define NET_EVENTS_DEFAULT_RANGE (7 * 24 * 3600)
 
 static esp_err_t httpd_resp_send_503(httpd_req_t *req, const char *msg)
 {
@@ -42,7 +53,7 @@ static esp_err_t api_animals_handler(httpd_req_t *req)
         cJSON *item = cJSON_CreateObject();
         cJSON_AddStringToObject(item, "id", animals[i].id);
         cJSON_AddStringToObject(item, "name", animals[i].name);
-        cJSON_AddStringToObject(item, "species", animals[i].species);
+        cJSON_AddStringToObject(item, "species", core_species_name(animals[i].species_id));
         cJSON_AddItemToArray(root, item);
     }
     core_free_animal_list(animals);
@@ -52,15 +63,95 @@ static esp_err_t api_animals_handler(httpd_req_t *req)
     httpd_resp_send(req, json_str, HTTPD_RESP_USE_STRLEN);
     
     cJSON_Delete(root);
-    free((void*)json_str);
+    cJSON_free((void*)json_str);
+    return ESP_OK;
+}
+
+static esp_err_t chunk_sink(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// Decimal value of key, def when absent; false on anything else
+static bool query_u32(const char *query, const char *key, uint32_t def, uint32_t *out)
+{
+    char value[16];
+    *out = def;
+    if (!query) return true;
+    esp_err_t err = httpd_query_key_value(query, key, value, sizeof(value));
+    if (err == ESP_ERR_NOT_FOUND) return true;
+    if (err != ESP_OK || !isdigit((unsigned char)value[0])) return false;
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(value, &end, 10);
+    if (*end != '\0' || errno == ERANGE || n > UINT32_MAX) return false;
+    *out = (uint32_t)n;
+    return true;
+}
+
+// GET /api/events?from=&to=&types=
+// Weighings and events of every animal, newest first, streamed in batches.
+// from/to are epoch seconds (default: the last 7 days), types a mask of
+// event types with bit 31 for weighings (default: all).
+static esp_err_t api_events_handler(httpd_req_t *req)
+{
+    if (!core_timeline_ready()) {
+        return httpd_resp_send_503(req, "Timeline indexing");
+    }
+
+    char query[96];
+    const char *q = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK ? query : NULL;
+    uint32_t now = (uint32_t)time(NULL);
+    uint32_t to, from, types;
+    if (!query_u32(q, "to", now, &to) ||
+        !query_u32(q, "from", to > NET_EVENTS_DEFAULT_RANGE ? to - NET_EVENTS_DEFAULT_RANGE : 0, &from) ||
+        !query_u32(q, "types", 0, &types)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid from, to or types");
+    }
+
+    storage_json_writer_t *w = storage_json_writer_create(chunk_sink, req, false);
+    if (!w) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+
+    core_timeline_cursor_t cursor;
+    core_timeline_cursor_init(&cursor, from, to, types, CORE_HISTORY_NEWEST_FIRST);
+    core_timeline_item_t items[NET_EVENTS_BATCH];
+    size_t n = 0;
+    storage_json_begin_array(w, NULL);
+    while (core_timeline_next(&cursor, items, NET_EVENTS_BATCH, &n) == ESP_OK && n > 0) {
+        for (size_t i = 0; i < n; i++) {
+            storage_json_begin_object(w, NULL);
+            storage_json_add_int(w, "date", items[i].date);
+            if (items[i].type == CORE_TIMELINE_WEIGHT) {
+                storage_json_add_string(w, "kind", "weight");
+            } else {
+                storage_json_add_string(w, "kind", "event");
+                storage_json_add_int(w, "type", items[i].type);
+            }
+            storage_json_add_int(w, "offset", items[i].offset);
+            storage_json_add_string(w, "animal_id", items[i].animal_id);
+            storage_json_add_string(w, "name", items[i].name);
+            storage_json_end_object(w);
+        }
+    }
+    storage_json_end_array(w);
+    esp_err_t ret = storage_json_writer_close(w);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Event stream aborted: %s", esp_err_to_name(ret));
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
 // GET /reports
 static esp_err_t reports_list_handler(httpd_req_t *req)
 {
-    if (!board_sd_is_mounted()) {
-        return httpd_resp_send_503(req, "SD card unavailable");
+    if (!storage_is_ready()) {
+        return httpd_resp_send_503(req, "Storage unavailable");
     }
 
     char **reports = NULL;
@@ -90,13 +181,13 @@ static esp_err_t reports_list_handler(httpd_req_t *req)
 // GET /reports/*
 static esp_err_t report_download_handler(httpd_req_t *req)
 {
-    if (!board_sd_is_mounted()) {
-        return httpd_resp_send_503(req, "SD card unavailable");
+    if (!storage_is_ready()) {
+        return httpd_resp_send_503(req, "Storage unavailable");
     }
 
     char filepath[256];
     // Skip "/reports/" prefix (length 9)
-    snprintf(filepath, sizeof(filepath), "/sdcard/reports/%s", req->uri + 9);
+    snprintf(filepath, sizeof(filepath), "%s/reports/%s", storage_root(), req->uri + 9);
 
     FILE *f = fopen(filepath, "r");
     if (!f) {
@@ -104,21 +195,34 @@ static esp_err_t report_download_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    char *chunk = malloc(1024);
+    // Pooled buffer: no allocation per download
+    size_t chunk_cap = 0;
+    char *chunk = storage_io_buf_borrow(&chunk_cap);
+    if (!chunk) {
+        fclose(f);
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
     size_t chunksize;
-    while ((chunksize = fread(chunk, 1, 1024, f)) > 0) {
+    while ((chunksize = fread(chunk, 1, chunk_cap, f)) > 0) {
         if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
             fclose(f);
-            free(chunk);
+            storage_io_buf_return(chunk);
             return ESP_FAIL;
         }
     }
-    free(chunk);
+    storage_io_buf_return(chunk);
     fclose(f);
     httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
+// Every handler runs with the server arena bound (json_arena_httpd.h)
+static json_arena_httpd_ctx_t api_animals_ctx = { api_animals_handler, &s_arena };
+static json_arena_httpd_ctx_t api_events_ctx = { api_events_handler, &s_arena };
+static json_arena_httpd_ctx_t reports_list_ctx = { reports_list_handler, &s_arena };
+static json_arena_httpd_ctx_t report_download_ctx = { report_download_handler, &s_arena };
+
 // =============================================================================
 // Server Control
 // =============================================================================
@@ -131,30 +235,41 @@ esp_err_t net_server_start(void)
     config.stack_size = 8192;
     config.uri_match_fn = httpd_uri_match_wildcard;
 
+    if (!s_arena) s_arena = json_arena_create(NET_ARENA_CHUNK_SIZE, JSON_ARENA_PSRAM);
+    if (!s_arena) ESP_LOGW(TAG, "No request arena, handlers use the heap");
+
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
         
         httpd_uri_t api_animals = {
             .uri       = "/api/animals",
             .method    = HTTP_GET,
-            .handler   = api_animals_handler,
-            .user_ctx  = NULL
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &api_animals_ctx
         };
         httpd_register_uri_handler(server, &api_animals);
 
+        httpd_uri_t api_events = {
+            .uri       = "/api/events",
+            .method    = HTTP_GET,
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &api_events_ctx
+        };
+        httpd_register_uri_handler(server, &api_events);
+
         httpd_uri_t reports_list = {
             .uri       = "/reports",
             .method    = HTTP_GET,
-            .handler   = reports_list_handler,
-            .user_ctx  = NULL
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &reports_list_ctx
         };
         httpd_register_uri_handler(server, &reports_list);
 
         httpd_uri_t report_download = {
             .uri       = "/reports/*",
             .method    = HTTP_GET,
-            .handler   = report_download_handler,
-            .user_ctx  = NULL
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &report_download_ctx
         };
         httpd_register_uri_handler(server, &report_download);
 
@@ -171,5 +286,7 @@ esp_err_t net_server_stop(void)
         httpd_stop(server);
         server = NULL;
     }
+    json_arena_destroy(s_arena);
+    s_arena = NULL;
     return ESP_OK;
 }
\ No newline at end of file
@@ -4,25 +4,136 @@
 #include "cJSON.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Initialize the storage system (NVS).
+ * @brief Initialize the storage system (NVS) and start the group commit task.
  *        Note: SD Card mounting is handled by the board component.
  * 
  * @return esp_err_t ESP_OK on success
  */
 esp_err_t storage_init(void);
 
+// =============================================================================
+// Storage backend (where data files live)
+// =============================================================================
+
+typedef enum {
+    STORAGE_BACKEND_NONE = 0,
+    STORAGE_BACKEND_SD,      // /sdcard, mounted by the board component
+    STORAGE_BACKEND_FLASH,   // Wear-levelled FAT on the "storage" partition
+    STORAGE_BACKEND_HOST,    // Directory on the host (linux target)
+} storage_backend_t;
+
+/**
+ * @brief Select and mount the data backend per CONFIG_STORAGE_BACKEND_*
+ *        (default: SD when mounted, internal flash otherwise). Call after
+ *        board_init(); idempotent.
+ *
+ * @return ESP_ERR_NOT_FOUND if no backend could be mounted.
+ */
+esp_err_t storage_backend_mount(void);
+
+storage_backend_t storage_backend_active(void);
+const char *storage_backend_name(storage_backend_t backend);
+
+/**
+ * @brief True once a backend is mounted.
+ */
+bool storage_is_ready(void);
+
+/**
+ * @brief Root directory of the active backend ("" when none).
+ */
+const char *storage_root(void);
+
+/**
+ * @brief Format "<root>/<relative>" into buf.
+ */
+esp_err_t storage_path(char *buf, size_t len, const char *relative);
+
+typedef struct {
+    storage_backend_t backend;
+    uint32_t write_kbps;          // Sequential, synced
+    uint32_t read_kbps;
+    uint32_t small_write_avg_us;  // Atomic 512-byte replace (record save)
+    uint32_t small_write_max_us;
+} storage_bench_result_t;
+
+/**
+ * @brief Measure one backend with CONFIG_STORAGE_BENCH_KB of scratch data
+ *        (mounting it if needed). ESP_ERR_NOT_SUPPORTED on this target.
+ */
+esp_err_t storage_backend_bench(storage_backend_t backend, storage_bench_result_t *out);
+
+/**
+ * @brief Benchmark every available backend and log the results.
+ */
+void storage_backend_bench_all(void);
+
+// =============================================================================
+// Internal flash filesystems
+// =============================================================================
+
+typedef enum {
+    STORAGE_FS_FAT = 0,      // FAT over wear levelling
+    STORAGE_FS_LITTLEFS,     // Power-safe, copy-on-write; cheap appends
+} storage_fs_t;
+
+const char *storage_fs_name(storage_fs_t fs);
+
+/**
+ * @brief Mount a flash data partition at base_path, formatting it if it
+ *        holds no valid filesystem of that type. format=true wipes it first.
+ *
+ * @return ESP_ERR_INVALID_STATE if the partition is mounted with another fs.
+ */
+esp_err_t storage_fs_mount(storage_fs_t fs, const char *label, const char *base_path, bool format);
+
+esp_err_t storage_fs_unmount(const char *label);
+
+typedef struct {
+    uint32_t create_ops_s;       // Atomic record creates per second
+    uint32_t event_ops_s;        // Journal appends per second
+    uint32_t log_ops_s;          // Audit log appends per second
+    uint64_t logical_bytes;      // Bytes handed to the filesystem
+    uint64_t flash_written;      // Bytes programmed on the partition
+    uint64_t flash_erased;       // Bytes erased on the partition
+    float write_amplification;   // flash_written / logical_bytes
+} storage_fs_bench_result_t;
+
+/**
+ * @brief Replay CONFIG_STORAGE_FS_BENCH_* record creates, journal appends and
+ *        audit log lines on a freshly formatted CONFIG_STORAGE_FS_BENCH_PARTITION.
+ *        Destroys that partition's content; requires CONFIG_STORAGE_FS_BENCH.
+ */
+esp_err_t storage_fs_bench(storage_fs_t fs, storage_fs_bench_result_t *out);
+
+/**
+ * @brief Run storage_fs_bench() on FAT and LittleFS and log them side by side.
+ */
+void storage_fs_bench_all(void);
+
 // =============================================================================
 // NVS (Preferences)
 // =============================================================================
+// Values are staged in RAM and written in one batch with a single commit,
+// CONFIG_STORAGE_NVS_COMMIT_DELAY_MS after the last set (debounced), on
+// storage_nvs_flush(), or at esp_restart(). Repeated sets of a key before
+// then cost one flash write. Getters see staged values.
 
 /**
- * @brief Save an integer value to NVS.
+ * @brief Open the persistent NVS session. Called by storage_init().
+ */
+esp_err_t storage_nvs_init(void);
+
+/**
+ * @brief Save an integer value to NVS (write-behind).
  * 
  * @param key Key name (max 15 chars)
  * @param value Integer value
@@ -40,7 +151,7 @@ esp_err_t storage_nvs_set_i32(const char *key, int32_t value);
 esp_err_t storage_nvs_get_i32(const char *key, int32_t *out_value);
 
 /**
- * @brief Save a string to NVS.
+ * @brief Save a string to NVS (write-behind).
  * 
  * @param key Key name
  * @param value String value
@@ -58,12 +169,29 @@ esp_err_t storage_nvs_set_str(const char *key, const char *value);
  */
 esp_err_t storage_nvs_get_str(const char *key, char *out_value, size_t max_len);
 
+/**
+ * @brief Write and commit staged values now (e.g. credentials).
+ */
+esp_err_t storage_nvs_flush(void);
+
+typedef struct {
+    uint32_t sets;               // storage_nvs_set_*() calls
+    uint32_t coalesced;          // Sets replaced by a later set before the flush
+    uint32_t flash_writes;       // nvs_set_*() calls actually made
+    uint32_t commits;            // nvs_commit() calls
+    uint32_t commits_avoided;    // sets - commits (one commit per set before)
+    uint32_t pending;            // Keys staged now
+} storage_nvs_stats_t;
+
+void storage_nvs_get_stats(storage_nvs_stats_t *out);
+
 // =============================================================================
-// File System (SD Card)
+// File System
 // =============================================================================
 
 /**
- * @brief Write text data to a file.
+ * @brief Write text data to a file. The file is replaced atomically
+ *        (see storage_commit_write()).
  * 
  * @param path Full path (e.g., "/sdcard/data.txt")
  * @param data Null-terminated string to write
@@ -72,7 +200,8 @@ esp_err_t storage_nvs_get_str(const char *key, char *out_value, size_t max_len);
 esp_err_t storage_file_write(const char *path, const char *data);
 
 /**
- * @brief Read text data from a file.
+ * @brief Read text data from a file, once queued writes are flushed
+ *        (interrupted atomic writes are recovered at mount).
  *        Caller is responsible for freeing the returned pointer.
  * 
  * @param path Full path
@@ -81,7 +210,17 @@ esp_err_t storage_file_write(const char *path, const char *data);
 char* storage_file_read(const char *path);
 
 /**
- * @brief Save a cJSON object to a file.
+ * @brief Read a whole file into a caller buffer (no allocation, no size probe).
+ *
+ * @param out_len Bytes read
+ * @return ESP_ERR_NOT_FOUND if missing, ESP_ERR_INVALID_SIZE if the file is
+ *         larger than cap (buf then holds the first cap bytes).
+ */
+esp_err_t storage_file_read_into(const char *path, void *buf, size_t cap, size_t *out_len);
+
+/**
+ * @brief Save a cJSON object to a file. Streamed through a
+ *        storage_json_writer_t: no whole-document string is built.
  * 
  * @param filename Full path
  * @param root cJSON object
@@ -98,6 +237,219 @@ esp_err_t storage_json_save(const char *filename, const cJSON *root);
  */
 cJSON* storage_json_load(const char *filename);
 
+// =============================================================================
+// I/O buffer pool
+// =============================================================================
+
+typedef struct {
+    uint32_t borrowed;      // Served from the pool
+    uint32_t overflows;     // Pool empty, served from the heap
+    uint32_t available;
+} storage_io_buf_stats_t;
+
+/**
+ * @brief Allocate CONFIG_STORAGE_IO_BUF_COUNT cache-line aligned, DMA capable
+ *        buffers of CONFIG_STORAGE_IO_BUF_SIZE bytes. Called by storage_init().
+ */
+esp_err_t storage_io_buf_init(void);
+
+/**
+ * @brief Take a buffer for a file read or a streamed response. Never blocks:
+ *        when the pool is empty a heap buffer is returned instead.
+ *
+ * @param out_size Usable size (CONFIG_STORAGE_IO_BUF_SIZE rounded up)
+ * @return NULL only if the heap fallback failed too.
+ */
+void *storage_io_buf_borrow(size_t *out_size);
+
+/**
+ * @brief Give back a buffer from storage_io_buf_borrow().
+ */
+void storage_io_buf_return(void *buf);
+
+void storage_io_buf_get_stats(storage_io_buf_stats_t *out);
+
+// =============================================================================
+// Group Commit (crash-safe writes)
+// =============================================================================
+
+typedef struct {
+    uint32_t batches;          // Flushes performed
+    uint32_t jobs;             // Writes/appends/removes submitted
+    uint32_t coalesced;        // Jobs skipped because a later one in the batch replaced them
+    uint32_t last_batch_jobs;
+    uint32_t last_flush_us;    // Time spent writing the last batch
+    uint32_t last_commit_us;   // Oldest job of the last batch: enqueue to durable
+    uint32_t max_commit_us;
+    uint64_t total_flush_us;
+} storage_commit_stats_t;
+
+/**
+ * @brief Start the writer task. Until it runs, every job executes inline.
+ */
+esp_err_t storage_commit_init(void);
+
+/**
+ * @brief Replace path atomically: the data goes to "<path>.tmp", is synced,
+ *        then renamed over path. Jobs arriving within
+ *        CONFIG_STORAGE_COMMIT_WINDOW_MS of each other are flushed as one
+ *        batch, and a later write of the same path supersedes an earlier one.
+ *
+ * @param wait true: block until durable and return the result; false: copy
+ *             data, return once queued (failures are logged).
+ */
+esp_err_t storage_commit_write(const char *path, const void *data, size_t len, bool wait);
+
+/**
+ * @brief Append to path; consecutive appends to one file in a batch share a
+ *        single open/sync/close.
+ */
+esp_err_t storage_commit_append(const char *path, const void *data, size_t len, bool wait);
+
+/**
+ * @brief Remove path, ordered with the other queued jobs.
+ */
+esp_err_t storage_commit_remove(const char *path, bool wait);
+
+/**
+ * @brief Wait until every job queued so far is durable (no-op when idle).
+ *        Call before reading a file that may have deferred jobs.
+ */
+esp_err_t storage_commit_flush(void);
+
+void storage_commit_get_stats(storage_commit_stats_t *out);
+
+/**
+ * @brief Finish or discard an interrupted atomic write of path. Boot-time
+ *        only (storage_backend_mount() does the storage root): run while
+ *        saves are queued, it would take their temp files for leftovers.
+ */
+esp_err_t storage_file_recover(const char *path);
+
+/**
+ * @brief storage_file_recover() for every "*.tmp" left in a directory.
+ */
+esp_err_t storage_recover_dir(const char *dir_path);
+
+/**
+ * @brief Open "<path>.tmp" for a streamed atomic write, after waiting for
+ *        queued jobs. Finish with storage_file_end_atomic().
+ */
+FILE *storage_file_begin_atomic(const char *path);
+
+/**
+ * @brief Sync and close f, then swap it in for path (commit) or drop it.
+ */
+esp_err_t storage_file_end_atomic(const char *path, FILE *f, bool commit);
+
+// =============================================================================
+// Streaming JSON writer
+// =============================================================================
+
+/**
+ * Emits JSON through a fixed CONFIG_STORAGE_JSON_WRITER_BUF_SIZE buffer, so
+ * peak memory does not depend on the document size. Values are added with a
+ * key inside objects and key NULL inside arrays. Errors are sticky and
+ * reported by storage_json_writer_close().
+ */
+typedef struct storage_json_writer storage_json_writer_t;
+
+/**
+ * @brief Receives each full buffer, then the remainder on close.
+ */
+typedef esp_err_t (*storage_json_sink_t)(void *ctx, const char *data, size_t len);
+
+storage_json_writer_t *storage_json_writer_create(storage_json_sink_t sink, void *ctx, bool pretty);
+
+/**
+ * @brief Pretty-printed writer to a file, replaced atomically on a
+ *        successful close and left untouched otherwise.
+ */
+storage_json_writer_t *storage_json_writer_open_file(const char *path);
+
+/**
+ * @brief Flush, commit (file writers) and free the writer.
+ * @return The first error hit while writing, ESP_ERR_INVALID_STATE if the
+ *         document is unbalanced.
+ */
+esp_err_t storage_json_writer_close(storage_json_writer_t *w);
+
+void storage_json_begin_object(storage_json_writer_t *w, const char *key);
+void storage_json_end_object(storage_json_writer_t *w);
+void storage_json_begin_array(storage_json_writer_t *w, const char *key);
+void storage_json_end_array(storage_json_writer_t *w);
+void storage_json_add_string(storage_json_writer_t *w, const char *key, const char *value);
+void storage_json_add_int(storage_json_writer_t *w, const char *key, int64_t value);
+void storage_json_add_number(storage_json_writer_t *w, const char *key, double value);
+void storage_json_add_bool(storage_json_writer_t *w, const char *key, bool value);
+
+/**
+ * @brief Stream an existing cJSON value (and its children).
+ */
+void storage_json_add_item(storage_json_writer_t *w, const char *key, const cJSON *item);
+
+// =============================================================================
+// Streaming JSON reader
+// =============================================================================
+
+/**
+ * Pull parser over a rolling CONFIG_STORAGE_JSON_READER_BUF_SIZE buffer: no
+ * file-sized allocation and no DOM. Each storage_json_next() returns one
+ * token; key and string text is unescaped into a STORAGE_JSON_TEXT_MAX
+ * buffer (longer strings are truncated and flagged). Callers may stop at any
+ * point, e.g. once the fields they need were read.
+ */
+#define STORAGE_JSON_TEXT_MAX 256
+
+typedef enum {
+    STORAGE_JSON_OBJECT_BEGIN = 0,
+    STORAGE_JSON_OBJECT_END,
+    STORAGE_JSON_ARRAY_BEGIN,
+    STORAGE_JSON_ARRAY_END,
+    STORAGE_JSON_KEY,        // storage_json_text(); the value follows
+    STORAGE_JSON_STRING,     // storage_json_text()
+    STORAGE_JSON_NUMBER,     // storage_json_number()
+    STORAGE_JSON_TRUE,
+    STORAGE_JSON_FALSE,
+    STORAGE_JSON_NULL,
+    STORAGE_JSON_EOF,        // Complete document consumed
+    STORAGE_JSON_ERROR,      // Syntax or I/O error, see storage_json_reader_close()
+} storage_json_token_t;
+
+typedef struct storage_json_reader storage_json_reader_t;
+
+/**
+ * @brief Fills buf with up to cap bytes; *out_len == 0 means end of input.
+ */
+typedef esp_err_t (*storage_json_source_t)(void *ctx, char *buf, size_t cap, size_t *out_len);
+
+storage_json_reader_t *storage_json_reader_create(storage_json_source_t source, void *ctx);
+
+/**
+ * @brief Reader over a file, once queued writes are flushed (same as
+ *        storage_file_read()). NULL if the file does not exist.
+ */
+storage_json_reader_t *storage_json_reader_open_file(const char *path);
+
+/**
+ * @brief Free the reader.
+ * @return The first syntax/I/O error, ESP_OK otherwise.
+ */
+esp_err_t storage_json_reader_close(storage_json_reader_t *r);
+
+storage_json_token_t storage_json_next(storage_json_reader_t *r);
+const char *storage_json_text(const storage_json_reader_t *r);
+bool storage_json_text_truncated(const storage_json_reader_t *r);
+double storage_json_number(const storage_json_reader_t *r);
+
+/**
+ * @brief Consume the next value, nested containers included (e.g. the value
+ *        of an unknown key).
+ */
+esp_err_t storage_json_skip(storage_json_reader_t *r);
+
+esp_err_t storage_json_reader_error(const storage_json_reader_t *r);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "reptile_storage.h"
+#include "board.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STORAGE_BACKEND";
+
+#define SD_MOUNT_POINT "/sdcard"
+
+static storage_backend_t s_active = STORAGE_BACKEND_NONE;
+static const char *s_root = NULL;
+
+const char *storage_backend_name(storage_backend_t backend) {
+    switch (backend) {
+    case STORAGE_BACKEND_SD:    return "sd";
+    case STORAGE_BACKEND_FLASH: return "flash";
+    case STORAGE_BACKEND_HOST:  return "host";
+    default:                    return "none";
+    }
+}
+
+static esp_err_t mount_flash(void) {
+#if CONFIG_STORAGE_FLASH_FS_LITTLEFS
+    return storage_fs_mount(STORAGE_FS_LITTLEFS, CONFIG_STORAGE_FLASH_PARTITION_LABEL,
+                            CONFIG_STORAGE_FLASH_MOUNT_POINT, false);
+#else
+    return storage_fs_mount(STORAGE_FS_FAT, CONFIG_STORAGE_FLASH_PARTITION_LABEL,
+                            CONFIG_STORAGE_FLASH_MOUNT_POINT, false);
+#endif
+}
+
+static esp_err_t mount_host(void) {
+#if CONFIG_IDF_TARGET_LINUX
+    struct stat st;
+    if (stat(CONFIG_STORAGE_HOST_DIR, &st) != 0 && mkdir(CONFIG_STORAGE_HOST_DIR, 0700) != 0) {
+        ESP_LOGE(TAG, "Cannot create host directory %s", CONFIG_STORAGE_HOST_DIR);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static const char *backend_root(storage_backend_t backend) {
+    switch (backend) {
+    case STORAGE_BACKEND_SD:    return SD_MOUNT_POINT;
+#if CONFIG_IDF_TARGET_LINUX
+    case STORAGE_BACKEND_HOST:  return CONFIG_STORAGE_HOST_DIR;
+#else
+    case STORAGE_BACKEND_FLASH: return CONFIG_STORAGE_FLASH_MOUNT_POINT;
+#endif
+    default:                    return NULL;
+    }
+}
+
+static esp_err_t backend_mount(storage_backend_t backend) {
+    switch (backend) {
+    case STORAGE_BACKEND_SD:    return board_sd_is_mounted() ? ESP_OK : ESP_ERR_NOT_FOUND;
+    case STORAGE_BACKEND_FLASH: return mount_flash();
+    case STORAGE_BACKEND_HOST:  return mount_host();
+    default:                    return ESP_ERR_INVALID_ARG;
+    }
+}
+
+esp_err_t storage_backend_mount(void) {
+    if (s_active != STORAGE_BACKEND_NONE) return ESP_OK;
+
+    // Candidates in order of preference for the configured policy
+#if CONFIG_STORAGE_BACKEND_AUTO
+    static const storage_backend_t s_order[] = { STORAGE_BACKEND_SD, STORAGE_BACKEND_FLASH, STORAGE_BACKEND_HOST };
+#elif CONFIG_STORAGE_BACKEND_SD
+    static const storage_backend_t s_order[] = { STORAGE_BACKEND_SD };
+#elif CONFIG_STORAGE_BACKEND_FLASH
+    static const storage_backend_t s_order[] = { STORAGE_BACKEND_FLASH };
+#else
+    static const storage_backend_t s_order[] = { STORAGE_BACKEND_HOST };
+#endif
+    for (size_t i = 0; i < sizeof(s_order) / sizeof(s_order[0]); i++) {
+        if (backend_mount(s_order[i]) != ESP_OK) continue;
+        s_active = s_order[i];
+        s_root = backend_root(s_active);
+        ESP_LOGI(TAG, "Data stored on %s (%s)", storage_backend_name(s_active), s_root);
+        // Before any task writes: recovery racing the commit writer would
+        // drop or steal the temp file of a save in progress
+        storage_recover_dir(s_root);
+#if CONFIG_STORAGE_BENCHMARK_AT_BOOT
+        storage_backend_bench_all();
+#endif
+#if CONFIG_STORAGE_FS_BENCH
+        storage_fs_bench_all();
+#endif
+        return ESP_OK;
+    }
+    ESP_LOGW(TAG, "No storage backend available, persistence disabled");
+    return ESP_ERR_NOT_FOUND;
+}
+
+storage_backend_t storage_backend_active(void) {
+    return s_active;
+}
+
+bool storage_is_ready(void) {
+    return s_active != STORAGE_BACKEND_NONE;
+}
+
+const char *storage_root(void) {
+    return s_root ? s_root : "";
+}
+
+esp_err_t storage_path(char *buf, size_t len, const char *relative) {
+    if (!s_root) return ESP_ERR_INVALID_STATE;
+    int n = snprintf(buf, len, "%s/%s", s_root, relative);
+    return (n < 0 || n >= (int)len) ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+// =============================================================================
+// Benchmark
+// =============================================================================
+
+#define BENCH_FILE_NAME   "storage_bench.bin"
+#define BENCH_SMALL_BYTES 512
+#define BENCH_SMALL_RUNS  20
+
+esp_err_t storage_backend_bench(storage_backend_t backend, storage_bench_result_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->backend = backend;
+    esp_err_t ret = backend_mount(backend);
+    if (ret != ESP_OK) return ret;
+    const char *root = backend_root(backend);
+    if (!root) return ESP_ERR_NOT_SUPPORTED;
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/" BENCH_FILE_NAME, root);
+    size_t chunk_cap = 0;
+    uint8_t *chunk = storage_io_buf_borrow(&chunk_cap);
+    if (!chunk) return ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < chunk_cap; i++) chunk[i] = (uint8_t)i;
+    const size_t total = (size_t)CONFIG_STORAGE_BENCH_KB * 1024;
+
+    // Sequential write, synced: what a large export or report costs
+    int64_t t0 = esp_timer_get_time();
+    FILE *f = fopen(path, "wb");
+    if (!f) { storage_io_buf_return(chunk); return ESP_FAIL; }
+    size_t written = 0;
+    while (written < total) {
+        size_t n = total - written < chunk_cap ? total - written : chunk_cap;
+        if (fwrite(chunk, 1, n, f) != n) break;
+        written += n;
+    }
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    int64_t t1 = esp_timer_get_time();
+
+    f = fopen(path, "rb");
+    size_t read_total = 0, n;
+    while (f && (n = fread(chunk, 1, chunk_cap, f)) > 0) read_total += n;
+    if (f) fclose(f);
+    int64_t t2 = esp_timer_get_time();
+
+    // Small atomic replaces: the shape of a record save
+    uint64_t small_total_us = 0;
+    for (int i = 0; i < BENCH_SMALL_RUNS; i++) {
+        int64_t s = esp_timer_get_time();
+        storage_commit_write(path, chunk, BENCH_SMALL_BYTES, true);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - s);
+        small_total_us += us;
+        if (us > out->small_write_max_us) out->small_write_max_us = us;
+    }
+    out->small_write_avg_us = (uint32_t)(small_total_us / BENCH_SMALL_RUNS);
+    remove(path);
+    storage_io_buf_return(chunk);
+
+    if (t1 > t0) out->write_kbps = (uint32_t)((uint64_t)written * 1000000 / 1024 / (t1 - t0));
+    if (t2 > t1) out->read_kbps = (uint32_t)((uint64_t)read_total * 1000000 / 1024 / (t2 - t1));
+    ESP_LOGI(TAG, "%-5s write %u KB/s, read %u KB/s, %d B atomic write avg %u us max %u us",
+             storage_backend_name(backend), (unsigned)out->write_kbps, (unsigned)out->read_kbps,
+             BENCH_SMALL_BYTES, (unsigned)out->small_write_avg_us, (unsigned)out->small_write_max_us);
+    return written == total ? ESP_OK : ESP_FAIL;
+}
+
+void storage_backend_bench_all(void) {
+    static const storage_backend_t s_all[] = { STORAGE_BACKEND_SD, STORAGE_BACKEND_FLASH, STORAGE_BACKEND_HOST };
+    for (size_t i = 0; i < sizeof(s_all) / sizeof(s_all[0]); i++) {
+        storage_bench_result_t result;
+        esp_err_t ret = storage_backend_bench(s_all[i], &result);
+        if (ret != ESP_OK && ret != ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGI(TAG, "%-5s skipped: %s", storage_backend_name(s_all[i]), esp_err_to_name(ret));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STORAGE_BUF";
+
+// Cache-line aligned and DMA capable: the SD driver can transfer straight
+// into them instead of bouncing through its own aligned copy.
+#define IO_BUF_ALIGN 64
+#define IO_BUF_SIZE  ((CONFIG_STORAGE_IO_BUF_SIZE + IO_BUF_ALIGN - 1) & ~(IO_BUF_ALIGN - 1))
+#define IO_BUF_CAPS  (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t *s_pool = NULL;          // CONFIG_STORAGE_IO_BUF_COUNT contiguous buffers
+static uint32_t s_free_mask = 0;        // Bit i set: buffer i is available
+static storage_io_buf_stats_t s_stats;
+
+esp_err_t storage_io_buf_init(void) {
+    if (s_pool) return ESP_OK;
+    s_pool = heap_caps_aligned_alloc(IO_BUF_ALIGN, (size_t)IO_BUF_SIZE * CONFIG_STORAGE_IO_BUF_COUNT, IO_BUF_CAPS);
+    if (!s_pool) {
+        // Borrowing still works, every buffer then comes from the heap
+        ESP_LOGW(TAG, "No memory for %d I/O buffers", CONFIG_STORAGE_IO_BUF_COUNT);
+        return ESP_ERR_NO_MEM;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    s_free_mask = (CONFIG_STORAGE_IO_BUF_COUNT >= 32) ? UINT32_MAX : ((1u << CONFIG_STORAGE_IO_BUF_COUNT) - 1);
+    taskEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void *storage_io_buf_borrow(size_t *out_size) {
+    void *buf = NULL;
+    taskENTER_CRITICAL(&s_lock);
+    if (s_free_mask) {
+        int i = __builtin_ctz(s_free_mask);
+        s_free_mask &= ~(1u << i);
+        buf = s_pool + (size_t)i * IO_BUF_SIZE;
+        s_stats.borrowed++;
+    } else {
+        s_stats.overflows++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (!buf) {
+        // Pool exhausted: same contract, the return frees it
+        buf = heap_caps_aligned_alloc(IO_BUF_ALIGN, IO_BUF_SIZE, IO_BUF_CAPS);
+        if (!buf) buf = heap_caps_aligned_alloc(IO_BUF_ALIGN, IO_BUF_SIZE, MALLOC_CAP_8BIT);
+        if (!buf) return NULL;
+    }
+    if (out_size) *out_size = IO_BUF_SIZE;
+    return buf;
+}
+
+void storage_io_buf_return(void *buf) {
+    if (!buf) return;
+    uint8_t *p = buf;
+    if (s_pool && p >= s_pool && p < s_pool + (size_t)IO_BUF_SIZE * CONFIG_STORAGE_IO_BUF_COUNT) {
+        int i = (p - s_pool) / IO_BUF_SIZE;
+        taskENTER_CRITICAL(&s_lock);
+        s_free_mask |= 1u << i;
+        taskEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    heap_caps_free(buf);
+}
+
+void storage_io_buf_get_stats(storage_io_buf_stats_t *out) {
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->available = __builtin_popcount(s_free_mask);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t storage_file_read_into(const char *path, void *buf, size_t cap, size_t *out_len) {
+    *out_len = 0;
+    storage_commit_flush();
+    FILE *f = fopen(path, "rb");
+    if (!f) return ESP_ERR_NOT_FOUND;
+
+    // No size probe: read until EOF, one extra byte tells "did not fit"
+    size_t len = fread(buf, 1, cap, f);
+    esp_err_t ret = ESP_OK;
+    if (ferror(f)) {
+        ret = ESP_FAIL;
+    } else if (len == cap && fgetc(f) != EOF) {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    fclose(f);
+    *out_len = len;
+    return ret;
+}
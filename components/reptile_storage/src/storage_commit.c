@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STORAGE_COMMIT";
+
+#define COMMIT_TMP_SUFFIX ".tmp"
+#define COMMIT_PATH_MAX   512
+#define COMMIT_BATCH_MAX  CONFIG_STORAGE_COMMIT_QUEUE_LEN
+
+typedef enum {
+    COMMIT_OP_WRITE = 0,   // Atomic replace (temp file + rename)
+    COMMIT_OP_APPEND,
+    COMMIT_OP_REMOVE,
+    COMMIT_OP_BARRIER,     // No-op, completes once everything before it did
+} commit_op_t;
+
+typedef struct {
+    commit_op_t op;
+    char *path;
+    const void *data;
+    size_t len;
+    SemaphoreHandle_t done;  // NULL: fire and forget, the writer frees the job
+    bool on_stack;           // Inline job owned by the caller
+    esp_err_t result;
+    int64_t enqueued_us;
+} commit_job_t;
+
+static QueueHandle_t s_queue = NULL;
+static TaskHandle_t s_task = NULL;
+static SemaphoreHandle_t s_stats_lock = NULL;
+static storage_commit_stats_t s_stats;
+static int32_t s_pending = 0;    // Jobs queued but not yet executed
+
+// =============================================================================
+// File primitives (writer task only, or callers when the task is not running)
+// =============================================================================
+
+static esp_err_t tmp_path(char *buf, size_t len, const char *path) {
+    int n = snprintf(buf, len, "%s%s", path, COMMIT_TMP_SUFFIX);
+    return (n < 0 || n >= (int)len) ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+static esp_err_t sync_and_close(FILE *f) {
+    bool ok = fflush(f) == 0;
+    if (ok) ok = fsync(fileno(f)) == 0;
+    if (fclose(f) != 0) ok = false;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+// Replace path by its complete, synced temp file
+static esp_err_t swap_in(const char *tmp, const char *path) {
+    // FAT cannot rename over an existing file
+    remove(path);
+    if (rename(tmp, path) != 0) {
+        ESP_LOGE(TAG, "Failed to rename %s to %s", tmp, path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// The target is only removed once the temp file is complete and synced, so
+// after a power loss either the old file exists (a stale temp is discarded),
+// or only the complete temp exists (it gets renamed): see storage_file_recover().
+static esp_err_t write_atomic(const char *path, const void *data, size_t len) {
+    char tmp[COMMIT_PATH_MAX];
+    if (tmp_path(tmp, sizeof(tmp), path) != ESP_OK) return ESP_ERR_INVALID_SIZE;
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s for writing", tmp);
+        return ESP_FAIL;
+    }
+    bool ok = len == 0 || fwrite(data, 1, len, f) == len;
+    if (sync_and_close(f) != ESP_OK) ok = false;
+    if (!ok) {
+        ESP_LOGE(TAG, "Short write on %s", tmp);
+        remove(tmp);
+        return ESP_FAIL;
+    }
+    return swap_in(tmp, path);
+}
+
+// A later write or remove of the same path makes a job pointless
+static bool job_superseded(commit_job_t **batch, size_t n, size_t i) {
+    if (batch[i]->op == COMMIT_OP_BARRIER) return false;
+    for (size_t j = i + 1; j < n; j++) {
+        if ((batch[j]->op == COMMIT_OP_WRITE || batch[j]->op == COMMIT_OP_REMOVE) &&
+            strcmp(batch[j]->path, batch[i]->path) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void job_finish(commit_job_t *job) {
+    if (job->on_stack) return;
+    if (job->done) {
+        xSemaphoreGive(job->done);
+        return;
+    }
+    // Nobody is waiting for a deferred job: its failure can only be logged
+    if (job->result != ESP_OK) {
+        ESP_LOGE(TAG, "Deferred %s of %s failed: %s",
+                 job->op == COMMIT_OP_APPEND ? "append" : "update", job->path, esp_err_to_name(job->result));
+    }
+    free(job);
+}
+
+static void pending_add(int32_t delta) {
+    if (s_stats_lock) xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    s_pending += delta;
+    if (s_stats_lock) xSemaphoreGive(s_stats_lock);
+}
+
+static void commit_batch(commit_job_t **batch, size_t n) {
+    int64_t start_us = esp_timer_get_time();
+    size_t coalesced = 0;
+
+    // Consecutive appends to one file share a single open/sync/close
+    FILE *append_f = NULL;
+    const char *append_path = NULL;
+    size_t append_first = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        commit_job_t *job = batch[i];
+        if (append_f && (job->op != COMMIT_OP_APPEND || strcmp(job->path, append_path) != 0)) {
+            esp_err_t ret = sync_and_close(append_f);
+            for (size_t k = append_first; k < i; k++) if (ret != ESP_OK) batch[k]->result = ret;
+            append_f = NULL;
+        }
+        if (job_superseded(batch, n, i)) {
+            job->result = ESP_OK;
+            coalesced++;
+            continue;
+        }
+        switch (job->op) {
+        case COMMIT_OP_WRITE:
+            job->result = write_atomic(job->path, job->data, job->len);
+            break;
+        case COMMIT_OP_APPEND:
+            if (!append_f) {
+                append_f = fopen(job->path, "ab");
+                append_path = job->path;
+                append_first = i;
+            }
+            job->result = (append_f && fwrite(job->data, 1, job->len, append_f) == job->len) ? ESP_OK : ESP_FAIL;
+            break;
+        case COMMIT_OP_REMOVE:
+            remove(job->path);
+            job->result = ESP_OK;
+            break;
+        default:
+            job->result = ESP_OK;
+            break;
+        }
+    }
+    if (append_f) {
+        esp_err_t ret = sync_and_close(append_f);
+        for (size_t k = append_first; k < n; k++) if (ret != ESP_OK) batch[k]->result = ret;
+    }
+
+    int64_t end_us = esp_timer_get_time();
+    uint32_t flush_us = (uint32_t)(end_us - start_us);
+    uint32_t commit_us = (uint32_t)(end_us - batch[0]->enqueued_us);
+    if (s_stats_lock) xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    s_stats.batches++;
+    s_stats.jobs += n;
+    s_stats.coalesced += coalesced;
+    s_stats.last_batch_jobs = n;
+    s_stats.last_flush_us = flush_us;
+    s_stats.last_commit_us = commit_us;
+    if (commit_us > s_stats.max_commit_us) s_stats.max_commit_us = commit_us;
+    s_stats.total_flush_us += flush_us;
+    if (s_stats_lock) xSemaphoreGive(s_stats_lock);
+    pending_add(-(int32_t)n);
+    ESP_LOGD(TAG, "Batch of %u jobs (%u coalesced): flush %u us, oldest waited %u us",
+             (unsigned)n, (unsigned)coalesced, (unsigned)flush_us, (unsigned)commit_us);
+
+    for (size_t i = 0; i < n; i++) job_finish(batch[i]);
+}
+
+static void commit_task(void *arg) {
+    (void)arg;
+    commit_job_t *batch[COMMIT_BATCH_MAX];
+    for (;;) {
+        size_t n = 0;
+        if (xQueueReceive(s_queue, &batch[0], portMAX_DELAY) != pdTRUE) continue;
+        n = 1;
+        // Gather whatever else arrives within the window; a barrier means
+        // someone is waiting for everything so far, so it ends the window
+        TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(CONFIG_STORAGE_COMMIT_WINDOW_MS);
+        while (n < COMMIT_BATCH_MAX && batch[n - 1]->op != COMMIT_OP_BARRIER) {
+            TickType_t now = xTaskGetTickCount();
+            if ((int32_t)(deadline - now) <= 0) break;
+            if (xQueueReceive(s_queue, &batch[n], deadline - now) != pdTRUE) break;
+            n++;
+        }
+        commit_batch(batch, n);
+    }
+}
+
+static esp_err_t commit_submit(commit_op_t op, const char *path, const void *data, size_t len, bool wait) {
+    if (op != COMMIT_OP_BARRIER && (!path || (len && !data))) return ESP_ERR_INVALID_ARG;
+    if (!path) path = "";
+
+    if (!s_task) {
+        // Layer not started: run the job inline as a batch of one
+        commit_job_t job = {
+            .op = op, .path = (char *)path, .data = data, .len = len,
+            .on_stack = true, .enqueued_us = esp_timer_get_time(),
+        };
+        commit_job_t *batch[1] = { &job };
+        pending_add(1);
+        commit_batch(batch, 1);
+        return job.result;
+    }
+
+    // Deferred jobs own a copy of the payload; waited ones borrow the caller's
+    size_t path_len = strlen(path) + 1;
+    size_t copy_len = wait ? 0 : len;
+    commit_job_t *job = heap_caps_malloc(sizeof(*job) + path_len + copy_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!job) job = malloc(sizeof(*job) + path_len + copy_len);
+    if (!job) return ESP_ERR_NO_MEM;
+    memset(job, 0, sizeof(*job));
+    job->op = op;
+    job->path = (char *)(job + 1);
+    memcpy(job->path, path, path_len);
+    if (copy_len) {
+        memcpy(job->path + path_len, data, copy_len);
+        job->data = job->path + path_len;
+    } else {
+        job->data = data;
+    }
+    job->len = len;
+    job->enqueued_us = esp_timer_get_time();
+    if (wait) {
+        job->done = xSemaphoreCreateBinary();
+        if (!job->done) { free(job); return ESP_ERR_NO_MEM; }
+    }
+
+    pending_add(1);
+    xQueueSend(s_queue, &job, portMAX_DELAY);
+    if (!wait) return ESP_OK;
+
+    xSemaphoreTake(job->done, portMAX_DELAY);
+    esp_err_t ret = job->result;
+    vSemaphoreDelete(job->done);
+    free(job);
+    return ret;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+esp_err_t storage_commit_init(void) {
+    if (s_task) return ESP_OK;
+    if (!s_stats_lock) {
+        s_stats_lock = xSemaphoreCreateMutex();
+        if (!s_stats_lock) return ESP_ERR_NO_MEM;
+    }
+    s_queue = xQueueCreate(CONFIG_STORAGE_COMMIT_QUEUE_LEN, sizeof(commit_job_t *));
+    if (!s_queue) return ESP_ERR_NO_MEM;
+    if (xTaskCreatePinnedToCore(commit_task, "storage_commit", 4096, NULL, 4, &s_task, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start group commit task");
+        s_task = NULL;
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Group commit ready (window %d ms, batch %d)",
+             CONFIG_STORAGE_COMMIT_WINDOW_MS, CONFIG_STORAGE_COMMIT_QUEUE_LEN);
+    return ESP_OK;
+}
+
+esp_err_t storage_commit_write(const char *path, const void *data, size_t len, bool wait) {
+    return commit_submit(COMMIT_OP_WRITE, path, data, len, wait);
+}
+
+esp_err_t storage_commit_append(const char *path, const void *data, size_t len, bool wait) {
+    return commit_submit(COMMIT_OP_APPEND, path, data, len, wait);
+}
+
+esp_err_t storage_commit_remove(const char *path, bool wait) {
+    return commit_submit(COMMIT_OP_REMOVE, path, NULL, 0, wait);
+}
+
+esp_err_t storage_commit_flush(void) {
+    if (!s_task) return ESP_OK;
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    int32_t pending = s_pending;
+    xSemaphoreGive(s_stats_lock);
+    if (pending == 0) return ESP_OK;
+    return commit_submit(COMMIT_OP_BARRIER, NULL, NULL, 0, true);
+}
+
+void storage_commit_get_stats(storage_commit_stats_t *out) {
+    if (s_stats_lock) xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    *out = s_stats;
+    if (s_stats_lock) xSemaphoreGive(s_stats_lock);
+}
+
+FILE *storage_file_begin_atomic(const char *path) {
+    char tmp[COMMIT_PATH_MAX];
+    if (tmp_path(tmp, sizeof(tmp), path) != ESP_OK) return NULL;
+    // Queued jobs on path must not land after this write
+    storage_commit_flush();
+    FILE *f = fopen(tmp, "wb");
+    if (!f) ESP_LOGE(TAG, "Failed to open %s for writing", tmp);
+    return f;
+}
+
+esp_err_t storage_file_end_atomic(const char *path, FILE *f, bool commit) {
+    char tmp[COMMIT_PATH_MAX];
+    if (tmp_path(tmp, sizeof(tmp), path) != ESP_OK) {
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (sync_and_close(f) != ESP_OK) commit = false;
+    if (!commit) {
+        remove(tmp);
+        return ESP_FAIL;
+    }
+    return swap_in(tmp, path);
+}
+
+esp_err_t storage_file_recover(const char *path) {
+    char tmp[COMMIT_PATH_MAX];
+    if (tmp_path(tmp, sizeof(tmp), path) != ESP_OK) return ESP_ERR_INVALID_SIZE;
+    struct stat st;
+    if (stat(tmp, &st) != 0) return ESP_OK;
+    if (stat(path, &st) == 0) {
+        // Crashed before the swap: the target is intact, the temp may not be
+        ESP_LOGW(TAG, "Discarding incomplete %s", tmp);
+        remove(tmp);
+        return ESP_OK;
+    }
+    // Crashed between remove and rename: the temp is complete
+    ESP_LOGW(TAG, "Completing interrupted write of %s", path);
+    return rename(tmp, path) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t storage_recover_dir(const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) return ESP_ERR_NOT_FOUND;
+    const size_t suffix_len = strlen(COMMIT_TMP_SUFFIX);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix_len || strcmp(entry->d_name + len - suffix_len, COMMIT_TMP_SUFFIX) != 0) continue;
+        char path[COMMIT_PATH_MAX];
+        int n = snprintf(path, sizeof(path), "%s/%.*s", dir_path, (int)(len - suffix_len), entry->d_name);
+        if (n < 0 || n >= (int)sizeof(path)) continue;
+        storage_file_recover(path);
+    }
+    closedir(dir);
+    return ESP_OK;
+}
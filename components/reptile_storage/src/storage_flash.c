@@ -0,0 +1,101 @@
+#include <string.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_vfs_fat.h"
+#include "esp_littlefs.h"
+#include "wear_levelling.h"
+#endif
+
+#define FLASH_MOUNT_MAX 2   // Data partition plus the fs benchmark partition
+
+const char *storage_fs_name(storage_fs_t fs) {
+    return fs == STORAGE_FS_LITTLEFS ? "littlefs" : "fat";
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+
+esp_err_t storage_fs_mount(storage_fs_t fs, const char *label, const char *base_path, bool format) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t storage_fs_unmount(const char *label) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#else
+
+static const char *TAG = "STORAGE_FLASH";
+
+typedef struct {
+    bool used;
+    storage_fs_t fs;
+    const char *label;
+    const char *base_path;
+    wl_handle_t wl_handle;   // FAT only
+} flash_mount_t;
+
+static flash_mount_t s_mounts[FLASH_MOUNT_MAX];
+
+static flash_mount_t *find_mount(const char *label) {
+    for (int i = 0; i < FLASH_MOUNT_MAX; i++) {
+        if (s_mounts[i].used && strcmp(s_mounts[i].label, label) == 0) return &s_mounts[i];
+    }
+    return NULL;
+}
+
+static esp_err_t mount_fat(flash_mount_t *m, bool format) {
+    const esp_vfs_fat_mount_config_t cfg = {
+        .max_files = 8,
+        // First boot: the partition ships blank
+        .format_if_mount_failed = true,
+        .allocation_unit_size = CONFIG_WL_SECTOR_SIZE,
+    };
+    esp_err_t ret = esp_vfs_fat_spiflash_mount_rw_wl(m->base_path, m->label, &cfg, &m->wl_handle);
+    if (ret == ESP_OK && format) ret = esp_vfs_fat_spiflash_format_rw_wl(m->base_path, m->label);
+    return ret;
+}
+
+static esp_err_t mount_littlefs(flash_mount_t *m, bool format) {
+    if (format) {
+        esp_err_t ret = esp_littlefs_format(m->label);
+        if (ret != ESP_OK) return ret;
+    }
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = m->base_path,
+        .partition_label = m->label,
+        .format_if_mount_failed = true,
+    };
+    return esp_vfs_littlefs_register(&conf);
+}
+
+esp_err_t storage_fs_mount(storage_fs_t fs, const char *label, const char *base_path, bool format) {
+    flash_mount_t *m = find_mount(label);
+    if (m) return (m->fs == fs && !format) ? ESP_OK : ESP_ERR_INVALID_STATE;
+    for (int i = 0; i < FLASH_MOUNT_MAX && !m; i++) {
+        if (!s_mounts[i].used) m = &s_mounts[i];
+    }
+    if (!m) return ESP_ERR_NO_MEM;
+
+    *m = (flash_mount_t){ .fs = fs, .label = label, .base_path = base_path, .wl_handle = WL_INVALID_HANDLE };
+    esp_err_t ret = fs == STORAGE_FS_LITTLEFS ? mount_littlefs(m, format) : mount_fat(m, format);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Mounting %s on '%s' failed: %s", storage_fs_name(fs), label, esp_err_to_name(ret));
+        if (m->wl_handle != WL_INVALID_HANDLE) esp_vfs_fat_spiflash_unmount_rw_wl(base_path, m->wl_handle);
+        return ret;
+    }
+    m->used = true;
+    return ESP_OK;
+}
+
+esp_err_t storage_fs_unmount(const char *label) {
+    flash_mount_t *m = find_mount(label);
+    if (!m) return ESP_ERR_NOT_FOUND;
+    esp_err_t ret = m->fs == STORAGE_FS_LITTLEFS ? esp_vfs_littlefs_unregister(m->label)
+                                                 : esp_vfs_fat_spiflash_unmount_rw_wl(m->base_path, m->wl_handle);
+    m->used = false;
+    return ret;
+}
+
+#endif
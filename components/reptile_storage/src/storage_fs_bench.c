@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#if CONFIG_STORAGE_FS_BENCH
+#include "esp_partition.h"
+#endif
+
+static const char *TAG = "STORAGE_FS_BENCH";
+
+#if !CONFIG_STORAGE_FS_BENCH
+
+esp_err_t storage_fs_bench(storage_fs_t fs, storage_fs_bench_result_t *out) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void storage_fs_bench_all(void) {
+    ESP_LOGW(TAG, "Filesystem benchmark not enabled (CONFIG_STORAGE_FS_BENCH)");
+}
+
+#else
+
+#define BENCH_MOUNT_POINT "/fsbench"
+#define BENCH_RECORD_SIZE 420   // Typical binary record: header + a few weights/events
+#define BENCH_EVENT_SIZE  32    // One journal entry
+
+// Flash traffic of the bench partition only. The component links with
+// --wrap for both symbols (see CMakeLists.txt), so every filesystem and the
+// wear-levelling layer go through these.
+static const esp_partition_t *s_counted = NULL;
+static uint64_t s_flash_written = 0;
+static uint64_t s_flash_erased = 0;
+
+esp_err_t __real_esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size);
+esp_err_t __real_esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size);
+
+esp_err_t __wrap_esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size) {
+    if (s_counted && part->address == s_counted->address) s_flash_written += size;
+    return __real_esp_partition_write(part, offset, src, size);
+}
+
+esp_err_t __wrap_esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+    if (s_counted && part->address == s_counted->address) s_flash_erased += size;
+    return __real_esp_partition_erase_range(part, offset, size);
+}
+
+static void record_path(char *buf, size_t len, int i, const char *ext) {
+    // Same name length as a UUID-named record, FAT long-name entries included
+    snprintf(buf, len, BENCH_MOUNT_POINT "/animals/%08x-0000-4000-8000-000000000000.%s", i, ext);
+}
+
+static uint32_t ops_per_s(uint32_t ops, int64_t us) {
+    return us > 0 ? (uint32_t)((uint64_t)ops * 1000000 / us) : 0;
+}
+
+esp_err_t storage_fs_bench(storage_fs_t fs, storage_fs_bench_result_t *out) {
+    memset(out, 0, sizeof(*out));
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           CONFIG_STORAGE_FS_BENCH_PARTITION);
+    if (!part) return ESP_ERR_NOT_FOUND;
+    esp_err_t ret = storage_fs_mount(fs, CONFIG_STORAGE_FS_BENCH_PARTITION, BENCH_MOUNT_POINT, true);
+    if (ret != ESP_OK) return ret;
+    mkdir(BENCH_MOUNT_POINT "/animals", 0700);
+
+    uint8_t record[BENCH_RECORD_SIZE];
+    for (size_t i = 0; i < sizeof(record); i++) record[i] = (uint8_t)(i * 31);
+    char path[96];
+
+    s_flash_written = 0;
+    s_flash_erased = 0;
+    s_counted = part;
+
+    // Animal creation: one atomic record file each, as core_save_animal() does
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_STORAGE_FS_BENCH_ANIMALS && ret == ESP_OK; i++) {
+        record_path(path, sizeof(path), i, "rec");
+        ret = storage_commit_write(path, record, sizeof(record), true);
+        out->logical_bytes += sizeof(record);
+    }
+
+    // Weighings and events: journal appends spread over the animals, group committed
+    int64_t t1 = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_STORAGE_FS_BENCH_EVENTS && ret == ESP_OK; i++) {
+        record_path(path, sizeof(path), i % CONFIG_STORAGE_FS_BENCH_ANIMALS, "jnl");
+        ret = storage_commit_append(path, record, BENCH_EVENT_SIZE, false);
+        out->logical_bytes += BENCH_EVENT_SIZE;
+    }
+    if (ret == ESP_OK) ret = storage_commit_flush();
+
+    // Audit trail: open/append/close per line, as core_log_event() does
+    int64_t t2 = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_STORAGE_FS_BENCH_LOG_LINES && ret == ESP_OK; i++) {
+        FILE *f = fopen(BENCH_MOUNT_POINT "/audit.log", "a");
+        if (!f) { ret = ESP_FAIL; break; }
+        int n = fprintf(f, "[%010d] [AUDIT] [CORE] Animal saved %08x\n", i, i % CONFIG_STORAGE_FS_BENCH_ANIMALS);
+        if (fclose(f) != 0 || n < 0) ret = ESP_FAIL;
+        else out->logical_bytes += n;
+    }
+    int64_t t3 = esp_timer_get_time();
+
+    s_counted = NULL;
+    storage_fs_unmount(CONFIG_STORAGE_FS_BENCH_PARTITION);
+
+    out->create_ops_s = ops_per_s(CONFIG_STORAGE_FS_BENCH_ANIMALS, t1 - t0);
+    out->event_ops_s = ops_per_s(CONFIG_STORAGE_FS_BENCH_EVENTS, t2 - t1);
+    out->log_ops_s = ops_per_s(CONFIG_STORAGE_FS_BENCH_LOG_LINES, t3 - t2);
+    out->flash_written = s_flash_written;
+    out->flash_erased = s_flash_erased;
+    if (out->logical_bytes) out->write_amplification = (float)s_flash_written / out->logical_bytes;
+    return ret;
+}
+
+void storage_fs_bench_all(void) {
+    static const storage_fs_t s_fs[] = { STORAGE_FS_FAT, STORAGE_FS_LITTLEFS };
+    ESP_LOGI(TAG, "Workload: %d animals, %d events, %d log lines on '%s'",
+             CONFIG_STORAGE_FS_BENCH_ANIMALS, CONFIG_STORAGE_FS_BENCH_EVENTS,
+             CONFIG_STORAGE_FS_BENCH_LOG_LINES, CONFIG_STORAGE_FS_BENCH_PARTITION);
+    ESP_LOGI(TAG, "%-8s %9s %9s %9s %10s %10s %6s", "fs", "create/s", "event/s", "log/s",
+             "written KB", "erased KB", "WA");
+    for (size_t i = 0; i < sizeof(s_fs) / sizeof(s_fs[0]); i++) {
+        storage_fs_bench_result_t r;
+        esp_err_t ret = storage_fs_bench(s_fs[i], &r);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "%-8s failed: %s", storage_fs_name(s_fs[i]), esp_err_to_name(ret));
+            continue;
+        }
+        ESP_LOGI(TAG, "%-8s %9u %9u %9u %10u %10u %6.2f", storage_fs_name(s_fs[i]),
+                 (unsigned)r.create_ops_s, (unsigned)r.event_ops_s, (unsigned)r.log_ops_s,
+                 (unsigned)(r.flash_written / 1024), (unsigned)(r.flash_erased / 1024),
+                 r.write_amplification);
+    }
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STORAGE_JSON";
+
+#define JSON_READER_MAX_DEPTH 32
+
+struct storage_json_reader {
+    storage_json_source_t source;
+    void *source_ctx;
+    FILE *file;              // Owned by file readers
+    esp_err_t error;
+    uint8_t depth;
+    uint32_t is_array;       // Bit per nesting level
+    bool expect_key;         // Next string in the current object is a key
+    bool truncated;          // Last string did not fit in text[]
+    double number;
+    size_t text_len;
+    char text[STORAGE_JSON_TEXT_MAX];
+    size_t pos;
+    size_t len;
+    char buf[];              // CONFIG_STORAGE_JSON_READER_BUF_SIZE bytes
+};
+
+static esp_err_t file_source(void *ctx, char *buf, size_t cap, size_t *out_len) {
+    FILE *f = ctx;
+    *out_len = fread(buf, 1, cap, f);
+    return (*out_len == 0 && ferror(f)) ? ESP_FAIL : ESP_OK;
+}
+
+static int next_char(storage_json_reader_t *r) {
+    if (r->pos == r->len) {
+        if (r->error != ESP_OK) return -1;
+        r->pos = 0;
+        r->len = 0;
+        esp_err_t ret = r->source(r->source_ctx, r->buf, CONFIG_STORAGE_JSON_READER_BUF_SIZE, &r->len);
+        if (ret != ESP_OK) r->error = ret;
+        if (r->len == 0) return -1;
+    }
+    return (unsigned char)r->buf[r->pos++];
+}
+
+static int peek_char(storage_json_reader_t *r) {
+    int c = next_char(r);
+    if (c >= 0) r->pos--;
+    return c;
+}
+
+static int skip_ws(storage_json_reader_t *r) {
+    int c;
+    do { c = next_char(r); } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    return c;
+}
+
+static storage_json_token_t fail(storage_json_reader_t *r) {
+    if (r->error == ESP_OK) r->error = ESP_ERR_INVALID_RESPONSE;
+    return STORAGE_JSON_ERROR;
+}
+
+static void text_put(storage_json_reader_t *r, char c) {
+    if (r->text_len + 1 < sizeof(r->text)) r->text[r->text_len++] = c;
+    else r->truncated = true;
+}
+
+static void text_put_utf8(storage_json_reader_t *r, uint32_t cp) {
+    if (cp < 0x80) {
+        text_put(r, (char)cp);
+    } else if (cp < 0x800) {
+        text_put(r, (char)(0xC0 | (cp >> 6)));
+        text_put(r, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        text_put(r, (char)(0xE0 | (cp >> 12)));
+        text_put(r, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        text_put(r, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        text_put(r, (char)(0xF0 | (cp >> 18)));
+        text_put(r, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        text_put(r, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        text_put(r, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+static bool read_hex4(storage_json_reader_t *r, uint32_t *out) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = next_char(r);
+        if (c >= '0' && c <= '9') v = (v << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f') v = (v << 4) | (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v = (v << 4) | (c - 'A' + 10);
+        else return false;
+    }
+    *out = v;
+    return true;
+}
+
+// Opening quote already consumed; longer strings are cut to STORAGE_JSON_TEXT_MAX - 1
+static bool read_string(storage_json_reader_t *r) {
+    r->text_len = 0;
+    r->truncated = false;
+    for (;;) {
+        int c = next_char(r);
+        if (c < 0) return false;
+        if (c == '"') break;
+        if (c != '\\') { text_put(r, (char)c); continue; }
+
+        c = next_char(r);
+        uint32_t cp;
+        switch (c) {
+        case '"': case '\\': case '/': text_put(r, (char)c); break;
+        case 'b': text_put(r, '\b'); break;
+        case 'f': text_put(r, '\f'); break;
+        case 'n': text_put(r, '\n'); break;
+        case 'r': text_put(r, '\r'); break;
+        case 't': text_put(r, '\t'); break;
+        case 'u':
+            if (!read_hex4(r, &cp)) return false;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                uint32_t low;
+                if (next_char(r) != '\\' || next_char(r) != 'u' || !read_hex4(r, &low)) return false;
+                if (low < 0xDC00 || low > 0xDFFF) return false;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            }
+            text_put_utf8(r, cp);
+            break;
+        default:
+            return false;
+        }
+    }
+    r->text[r->text_len] = '\0';
+    return true;
+}
+
+static storage_json_token_t read_number(storage_json_reader_t *r, int first) {
+    r->text_len = 0;
+    r->truncated = false;
+    text_put(r, (char)first);
+    for (;;) {
+        int c = peek_char(r);
+        if (!((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')) break;
+        text_put(r, (char)next_char(r));
+    }
+    r->text[r->text_len] = '\0';
+    char *end;
+    r->number = strtod(r->text, &end);
+    if (end == r->text || *end != '\0') return fail(r);
+    return STORAGE_JSON_NUMBER;
+}
+
+static storage_json_token_t read_literal(storage_json_reader_t *r, int first) {
+    static const struct { const char *word; storage_json_token_t token; } s_literals[] = {
+        { "true", STORAGE_JSON_TRUE }, { "false", STORAGE_JSON_FALSE }, { "null", STORAGE_JSON_NULL },
+    };
+    for (size_t i = 0; i < sizeof(s_literals) / sizeof(s_literals[0]); i++) {
+        const char *w = s_literals[i].word;
+        if (first != w[0]) continue;
+        for (w++; *w; w++) {
+            if (next_char(r) != *w) return fail(r);
+        }
+        return s_literals[i].token;
+    }
+    return fail(r);
+}
+
+static storage_json_token_t open_container(storage_json_reader_t *r, bool array) {
+    if (r->depth >= JSON_READER_MAX_DEPTH) return fail(r);
+    uint32_t bit = 1u << r->depth;
+    if (array) r->is_array |= bit; else r->is_array &= ~bit;
+    r->depth++;
+    r->expect_key = !array;
+    return array ? STORAGE_JSON_ARRAY_BEGIN : STORAGE_JSON_OBJECT_BEGIN;
+}
+
+static storage_json_token_t close_container(storage_json_reader_t *r, bool array) {
+    if (r->depth == 0) return fail(r);
+    if (!!(r->is_array & (1u << (r->depth - 1))) != array) return fail(r);
+    r->depth--;
+    r->expect_key = false;
+    return array ? STORAGE_JSON_ARRAY_END : STORAGE_JSON_OBJECT_END;
+}
+
+storage_json_reader_t *storage_json_reader_create(storage_json_source_t source, void *ctx) {
+    if (!source) return NULL;
+    storage_json_reader_t *r = calloc(1, sizeof(*r) + CONFIG_STORAGE_JSON_READER_BUF_SIZE);
+    if (!r) return NULL;
+    r->source = source;
+    r->source_ctx = ctx;
+    return r;
+}
+
+storage_json_reader_t *storage_json_reader_open_file(const char *path) {
+    storage_commit_flush();
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    storage_json_reader_t *r = storage_json_reader_create(file_source, f);
+    if (!r) { fclose(f); return NULL; }
+    r->file = f;
+    return r;
+}
+
+esp_err_t storage_json_reader_close(storage_json_reader_t *r) {
+    if (!r) return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = r->error;
+    if (r->file) fclose(r->file);
+    free(r);
+    return ret;
+}
+
+storage_json_token_t storage_json_next(storage_json_reader_t *r) {
+    if (r->error != ESP_OK) return STORAGE_JSON_ERROR;
+    for (;;) {
+        int c = skip_ws(r);
+        bool in_object = r->depth && !(r->is_array & (1u << (r->depth - 1)));
+        switch (c) {
+        case -1:
+            if (r->error != ESP_OK || r->depth) return fail(r);
+            return STORAGE_JSON_EOF;
+        case '{': return open_container(r, false);
+        case '[': return open_container(r, true);
+        case '}': return close_container(r, false);
+        case ']': return close_container(r, true);
+        case ',':
+            if (!r->depth) return fail(r);
+            r->expect_key = in_object;
+            continue;
+        case '"':
+            if (!read_string(r)) return fail(r);
+            if (in_object && r->expect_key) {
+                r->expect_key = false;
+                if (skip_ws(r) != ':') return fail(r);
+                return STORAGE_JSON_KEY;
+            }
+            return STORAGE_JSON_STRING;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) return read_number(r, c);
+            return read_literal(r, c);
+        }
+    }
+}
+
+const char *storage_json_text(const storage_json_reader_t *r) {
+    return r->text;
+}
+
+bool storage_json_text_truncated(const storage_json_reader_t *r) {
+    return r->truncated;
+}
+
+double storage_json_number(const storage_json_reader_t *r) {
+    return r->number;
+}
+
+esp_err_t storage_json_skip(storage_json_reader_t *r) {
+    storage_json_token_t t = storage_json_next(r);
+    uint8_t target = r->depth;
+    if (t == STORAGE_JSON_OBJECT_BEGIN || t == STORAGE_JSON_ARRAY_BEGIN) {
+        target--;
+        while (r->depth > target) {
+            t = storage_json_next(r);
+            if (t == STORAGE_JSON_ERROR || t == STORAGE_JSON_EOF) break;
+        }
+    }
+    if (t == STORAGE_JSON_ERROR || t == STORAGE_JSON_EOF) {
+        ESP_LOGD(TAG, "Unterminated value while skipping");
+        fail(r);
+    }
+    return r->error;
+}
+
+esp_err_t storage_json_reader_error(const storage_json_reader_t *r) {
+    return r->error;
+}
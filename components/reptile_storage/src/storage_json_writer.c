@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STORAGE_JSON";
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+struct storage_json_writer {
+    storage_json_sink_t sink;
+    void *sink_ctx;
+    FILE *file;              // File writers: temp file, swapped in on close
+    char *path;
+    bool pretty;
+    esp_err_t error;         // First failure; later calls are no-ops
+    uint8_t depth;
+    uint32_t has_members;    // Bit per nesting level: a separator is needed
+    uint32_t is_array;       // Bit per nesting level
+    size_t used;
+    char buf[];              // CONFIG_STORAGE_JSON_WRITER_BUF_SIZE bytes
+};
+
+static esp_err_t file_sink(void *ctx, const char *data, size_t len) {
+    return fwrite(data, 1, len, (FILE *)ctx) == len ? ESP_OK : ESP_FAIL;
+}
+
+static void flush_buf(storage_json_writer_t *w) {
+    if (w->used && w->error == ESP_OK) w->error = w->sink(w->sink_ctx, w->buf, w->used);
+    w->used = 0;
+}
+
+static void put(storage_json_writer_t *w, const char *data, size_t len) {
+    while (len && w->error == ESP_OK) {
+        size_t room = CONFIG_STORAGE_JSON_WRITER_BUF_SIZE - w->used;
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->used, data, n);
+        w->used += n; data += n; len -= n;
+        if (w->used == CONFIG_STORAGE_JSON_WRITER_BUF_SIZE) flush_buf(w);
+    }
+}
+
+static void put_str(storage_json_writer_t *w, const char *s) {
+    put(w, s, strlen(s));
+}
+
+static void put_indent(storage_json_writer_t *w) {
+    if (!w->pretty) return;
+    put(w, "\n", 1);
+    for (uint8_t i = 0; i < w->depth; i++) put(w, "\t", 1);
+}
+
+// Same escaping as cJSON's print_string_ptr()
+static void put_escaped(storage_json_writer_t *w, const char *s) {
+    put(w, "\"", 1);
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        put(w, run, s - run);
+        run = s + 1;
+        char esc[7];
+        switch (c) {
+        case '"':  put(w, "\\\"", 2); break;
+        case '\\': put(w, "\\\\", 2); break;
+        case '\b': put(w, "\\b", 2); break;
+        case '\f': put(w, "\\f", 2); break;
+        case '\n': put(w, "\\n", 2); break;
+        case '\r': put(w, "\\r", 2); break;
+        case '\t': put(w, "\\t", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put(w, esc, 6);
+            break;
+        }
+    }
+    put(w, run, s - run);
+    put(w, "\"", 1);
+}
+
+// Separator, indentation and "key": for the next value of the current container
+static void begin_value(storage_json_writer_t *w, const char *key) {
+    if (w->depth == 0) return;
+    uint32_t bit = 1u << (w->depth - 1);
+    if (w->has_members & bit) put(w, ",", 1);
+    w->has_members |= bit;
+    put_indent(w);
+    if (!(w->is_array & bit)) {
+        put_escaped(w, key ? key : "");
+        put(w, w->pretty ? ":\t" : ":", w->pretty ? 2 : 1);
+    }
+}
+
+static void open_container(storage_json_writer_t *w, const char *key, bool array) {
+    if (w->error != ESP_OK) return;
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->error = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    begin_value(w, key);
+    put(w, array ? "[" : "{", 1);
+    uint32_t bit = 1u << w->depth;
+    w->depth++;
+    w->has_members &= ~bit;
+    if (array) w->is_array |= bit; else w->is_array &= ~bit;
+}
+
+static void close_container(storage_json_writer_t *w, bool array) {
+    if (w->error != ESP_OK) return;
+    uint32_t bit = w->depth ? 1u << (w->depth - 1) : 0;
+    if (!bit || !!(w->is_array & bit) != array) {
+        w->error = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    bool had_members = w->has_members & bit;
+    w->depth--;
+    if (had_members) put_indent(w);
+    put(w, array ? "]" : "}", 1);
+}
+
+storage_json_writer_t *storage_json_writer_create(storage_json_sink_t sink, void *ctx, bool pretty) {
+    if (!sink) return NULL;
+    storage_json_writer_t *w = calloc(1, sizeof(*w) + CONFIG_STORAGE_JSON_WRITER_BUF_SIZE);
+    if (!w) return NULL;
+    w->sink = sink;
+    w->sink_ctx = ctx;
+    w->pretty = pretty;
+    return w;
+}
+
+storage_json_writer_t *storage_json_writer_open_file(const char *path) {
+    char *path_copy = strdup(path);
+    if (!path_copy) return NULL;
+    FILE *f = storage_file_begin_atomic(path);
+    if (!f) { free(path_copy); return NULL; }
+    storage_json_writer_t *w = storage_json_writer_create(file_sink, f, true);
+    if (!w) {
+        storage_file_end_atomic(path, f, false);
+        free(path_copy);
+        return NULL;
+    }
+    w->file = f;
+    w->path = path_copy;
+    return w;
+}
+
+esp_err_t storage_json_writer_close(storage_json_writer_t *w) {
+    if (!w) return ESP_ERR_INVALID_ARG;
+    // An unbalanced document is never committed
+    if (w->error == ESP_OK && w->depth != 0) w->error = ESP_ERR_INVALID_STATE;
+    flush_buf(w);
+    esp_err_t ret = w->error;
+    if (w->file) {
+        esp_err_t end = storage_file_end_atomic(w->path, w->file, ret == ESP_OK);
+        if (ret == ESP_OK) ret = end;
+        if (ret != ESP_OK) ESP_LOGE(TAG, "Failed to write %s: %s", w->path, esp_err_to_name(ret));
+        free(w->path);
+    }
+    free(w);
+    return ret;
+}
+
+void storage_json_begin_object(storage_json_writer_t *w, const char *key) { open_container(w, key, false); }
+void storage_json_end_object(storage_json_writer_t *w) { close_container(w, false); }
+void storage_json_begin_array(storage_json_writer_t *w, const char *key) { open_container(w, key, true); }
+void storage_json_end_array(storage_json_writer_t *w) { close_container(w, true); }
+
+void storage_json_add_string(storage_json_writer_t *w, const char *key, const char *value) {
+    if (w->error != ESP_OK) return;
+    begin_value(w, key);
+    if (value) put_escaped(w, value); else put_str(w, "null");
+}
+
+void storage_json_add_int(storage_json_writer_t *w, const char *key, int64_t value) {
+    if (w->error != ESP_OK) return;
+    char num[24];
+    snprintf(num, sizeof(num), "%lld", (long long)value);
+    begin_value(w, key);
+    put_str(w, num);
+}
+
+void storage_json_add_number(storage_json_writer_t *w, const char *key, double value) {
+    if (w->error != ESP_OK) return;
+    char num[32];
+    if (isnan(value) || isinf(value)) {
+        strcpy(num, "null");
+    } else {
+        // Shortest of 15/17 digits that reads back exactly, like cJSON
+        snprintf(num, sizeof(num), "%1.15g", value);
+        if (strtod(num, NULL) != value) snprintf(num, sizeof(num), "%1.17g", value);
+    }
+    begin_value(w, key);
+    put_str(w, num);
+}
+
+void storage_json_add_bool(storage_json_writer_t *w, const char *key, bool value) {
+    if (w->error != ESP_OK) return;
+    begin_value(w, key);
+    put_str(w, value ? "true" : "false");
+}
+
+void storage_json_add_item(storage_json_writer_t *w, const char *key, const cJSON *item) {
+    if (w->error != ESP_OK || !item) return;
+    if (cJSON_IsObject(item) || cJSON_IsArray(item)) {
+        bool array = cJSON_IsArray(item);
+        open_container(w, key, array);
+        for (const cJSON *child = item->child; child; child = child->next) {
+            storage_json_add_item(w, array ? NULL : child->string, child);
+        }
+        close_container(w, array);
+    } else if (cJSON_IsString(item)) {
+        storage_json_add_string(w, key, item->valuestring);
+    } else if (cJSON_IsNumber(item)) {
+        storage_json_add_number(w, key, item->valuedouble);
+    } else if (cJSON_IsBool(item)) {
+        storage_json_add_bool(w, key, cJSON_IsTrue(item));
+    } else if (cJSON_IsRaw(item)) {
+        begin_value(w, key);
+        put_str(w, item->valuestring ? item->valuestring : "");
+    } else {
+        begin_value(w, key);
+        put_str(w, "null");
+    }
+}
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+#include "reptile_storage.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "STORAGE_NVS";
+static const char *NVS_NAMESPACE = "reptile_app";
+
+typedef enum {
+    PENDING_I32 = 0,
+    PENDING_STR,
+} pending_type_t;
+
+// A value set but not yet written to flash; a later set of the same key
+// replaces it in place
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    pending_type_t type;
+    int32_t i32;
+    char *str;
+} pending_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static nvs_handle_t s_handle = 0;
+static bool s_open = false;
+static esp_timer_handle_t s_timer = NULL;
+static pending_t s_pending[CONFIG_STORAGE_NVS_PENDING_MAX];
+static size_t s_pending_count = 0;
+static storage_nvs_stats_t s_stats;
+
+// Lazily opened session, kept for the lifetime of the app (caller holds s_lock)
+static esp_err_t session_open(void) {
+    if (s_open) return ESP_OK;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &s_handle);
+    if (err == ESP_OK) s_open = true;
+    return err;
+}
+
+// Write and commit everything pending; values that fail stay staged for the
+// next flush (caller holds s_lock)
+static esp_err_t flush_locked(void) {
+    if (s_pending_count == 0) return ESP_OK;
+    esp_err_t err = session_open();
+    if (err != ESP_OK) return err;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < s_pending_count; i++) {
+        pending_t *p = &s_pending[i];
+        esp_err_t ret = p->type == PENDING_I32 ? nvs_set_i32(s_handle, p->key, p->i32)
+                                               : nvs_set_str(s_handle, p->key, p->str);
+        s_stats.flash_writes++;
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Writing '%s' failed: %s", p->key, esp_err_to_name(ret));
+            err = ret;
+            s_pending[kept++] = *p;
+            continue;
+        }
+        free(p->str);
+    }
+    s_pending_count = kept;
+    esp_err_t ret = nvs_commit(s_handle);
+    s_stats.commits++;
+    return err != ESP_OK ? err : ret;
+}
+
+static void debounce_cb(void *arg) {
+    esp_err_t err = storage_nvs_flush();
+    if (err != ESP_OK) {
+        // What could not be written is still staged: try again later
+        ESP_LOGW(TAG, "Deferred NVS flush failed: %s", esp_err_to_name(err));
+        esp_timer_start_once(s_timer, (uint64_t)CONFIG_STORAGE_NVS_COMMIT_DELAY_MS * 1000);
+    }
+}
+
+static void shutdown_flush(void) {
+    // esp_restart() and OTA reboots: nothing staged is lost
+    storage_nvs_flush();
+}
+
+esp_err_t storage_nvs_init(void) {
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    const esp_timer_create_args_t args = {
+        .callback = debounce_cb,
+        .name = "nvs_flush",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_timer);
+    if (err != ESP_OK) return err;
+    esp_register_shutdown_handler(shutdown_flush);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    err = session_open();
+    xSemaphoreGive(s_lock);
+    if (err != ESP_OK) ESP_LOGW(TAG, "NVS session not open yet: %s", esp_err_to_name(err));
+    return ESP_OK;
+}
+
+static pending_t *pending_find(const char *key) {
+    for (size_t i = 0; i < s_pending_count; i++) {
+        if (strcmp(s_pending[i].key, key) == 0) return &s_pending[i];
+    }
+    return NULL;
+}
+
+// Stage a value and (re)arm the debounce timer; str is taken over
+static esp_err_t stage(const char *key, pending_type_t type, int32_t i32, char *str) {
+    if (!s_lock) { free(str); return ESP_ERR_INVALID_STATE; }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) { free(str); return ESP_ERR_NVS_KEY_TOO_LONG; }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.sets++;
+    pending_t *p = pending_find(key);
+    if (p) {
+        free(p->str);
+        s_stats.coalesced++;
+    } else {
+        if (s_pending_count == CONFIG_STORAGE_NVS_PENDING_MAX) {
+            // Values that failed to flush are logged and stay staged
+            esp_err_t flushed = flush_locked();
+            if (s_pending_count == CONFIG_STORAGE_NVS_PENDING_MAX) {
+                // No room freed: refuse this value rather than drop one
+                xSemaphoreGive(s_lock);
+                free(str);
+                return flushed != ESP_OK ? flushed : ESP_ERR_NO_MEM;
+            }
+        }
+        p = &s_pending[s_pending_count++];
+        strlcpy(p->key, key, sizeof(p->key));
+    }
+    p->type = type;
+    p->i32 = i32;
+    p->str = str;
+    xSemaphoreGive(s_lock);
+
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, (uint64_t)CONFIG_STORAGE_NVS_COMMIT_DELAY_MS * 1000);
+    return ESP_OK;
+}
+
+esp_err_t storage_nvs_set_i32(const char *key, int32_t value) {
+    if (!key) return ESP_ERR_INVALID_ARG;
+    return stage(key, PENDING_I32, value, NULL);
+}
+
+esp_err_t storage_nvs_set_str(const char *key, const char *value) {
+    if (!key || !value) return ESP_ERR_INVALID_ARG;
+    char *copy = strdup(value);
+    if (!copy) return ESP_ERR_NO_MEM;
+    return stage(key, PENDING_STR, 0, copy);
+}
+
+esp_err_t storage_nvs_get_i32(const char *key, int32_t *out_value) {
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err;
+    const pending_t *p = pending_find(key);
+    if (p) {
+        // Read-your-writes before the flush
+        err = p->type == PENDING_I32 ? ESP_OK : ESP_ERR_NVS_TYPE_MISMATCH;
+        if (err == ESP_OK) *out_value = p->i32;
+    } else {
+        err = session_open();
+        if (err == ESP_OK) err = nvs_get_i32(s_handle, key, out_value);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t storage_nvs_get_str(const char *key, char *out_value, size_t max_len) {
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err;
+    const pending_t *p = pending_find(key);
+    if (p) {
+        if (p->type != PENDING_STR) {
+            err = ESP_ERR_NVS_TYPE_MISMATCH;
+        } else if (strlen(p->str) + 1 > max_len) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            strlcpy(out_value, p->str, max_len);
+            err = ESP_OK;
+        }
+    } else {
+        err = session_open();
+        size_t required_size = 0;
+        if (err == ESP_OK) err = nvs_get_str(s_handle, key, NULL, &required_size);
+        if (err == ESP_OK) {
+            if (required_size > max_len) {
+                err = ESP_ERR_NVS_INVALID_LENGTH;
+            } else {
+                err = nvs_get_str(s_handle, key, out_value, &required_size);
+                if (err == ESP_OK && max_len > 0) {
+                    out_value[max_len - 1] = '\0';
+                }
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+    if (err != ESP_OK && max_len > 0) {
+        out_value[0] = '\0';
+    }
+    return err;
+}
+
+esp_err_t storage_nvs_flush(void) {
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    esp_timer_stop(s_timer);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void storage_nvs_get_stats(storage_nvs_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    out->pending = s_pending_count;
+    // One commit per set before the write-behind queue
+    out->commits_avoided = s_stats.sets > s_stats.commits ? s_stats.sets - s_stats.commits : 0;
+    xSemaphoreGive(s_lock);
+}
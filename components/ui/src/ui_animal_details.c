@@ -8,6 +8,7 @@
 #if defined(LV_USE_QRCODE) && LV_USE_QRCODE
 #include "lv_qrcode.h"
 #endif
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -241,6 +242,100 @@ static void build_info_tab(lv_obj_t * parent, const animal_t *animal) {
     lv_label_set_text(lv_label_create(btn_repro), LV_SYMBOL_LOOP " Reproduction");
 }
 
+// =============================================================================
+// History Lists
+// =============================================================================
+
+// Rows fetched per page: the screen opens with the newest ones and older
+// pages are read when the list is scrolled to its end
+#define HISTORY_PAGE_SIZE 20
+
+typedef struct {
+    lv_obj_t * list;
+    core_history_kind_t kind;
+    size_t loaded;
+    size_t total;
+} history_list_t;
+
+static history_list_t weight_history;
+static history_list_t event_history;
+
+static const char *event_type_str(event_type_t type) {
+    switch (type) {
+        case EVENT_FEEDING: return "Nourrissage";
+        case EVENT_SHEDDING: return "Mue";
+        case EVENT_VET: return "Veto";
+        case EVENT_CLEANING: return "Nettoyage";
+        case EVENT_MATING: return "Accouplement";
+        case EVENT_LAYING: return "Ponte";
+        case EVENT_HATCHING: return "Eclosion";
+        default: return "Autre";
+    }
+}
+
+static void list_add_weight(lv_obj_t * list, const weight_record_t *weight) {
+    char date_str[64];
+    char value[24];
+    char item_str[128];
+    format_date(date_str, sizeof(date_str), weight->date);
+    core_weight_format((int32_t)lroundf(weight->value * 1000.0f), value, sizeof(value));
+    snprintf(item_str, sizeof(item_str), "%s: %s", date_str, value);
+    lv_list_add_btn(list, NULL, item_str);
+}
+
+static void list_add_event(lv_obj_t * list, const event_record_t *event) {
+    char buf[64];
+    char item_str[256];
+    format_date(buf, sizeof(buf), event->date);
+    snprintf(item_str, sizeof(item_str), "%s [%s] %s", buf, event_type_str(event->type), event->description);
+    lv_list_add_btn(list, NULL, item_str);
+}
+
+// Append the next page (newest first) to the list
+static esp_err_t history_load_page(history_list_t *h) {
+    core_history_page_t page;
+    esp_err_t ret = core_get_history_page(current_animal_id, h->kind, h->loaded, HISTORY_PAGE_SIZE,
+                                          CORE_HISTORY_NEWEST_FIRST, &page);
+    if (ret != ESP_OK) {
+        LV_LOG_WARN("History page of %s failed: %d", current_animal_id, ret);
+        return ret;
+    }
+    for (size_t i = 0; i < page.count; i++) {
+        if (h->kind == CORE_HISTORY_WEIGHTS) list_add_weight(h->list, &page.weights[i]);
+        else list_add_event(h->list, &page.events[i]);
+    }
+    h->loaded += page.count;
+    h->total = page.total;
+    core_free_history_page(&page);
+    return ESP_OK;
+}
+
+static void history_scroll_cb(lv_event_t * e) {
+    history_list_t *h = lv_event_get_user_data(e);
+    if (h->loaded < h->total && lv_obj_get_scroll_bottom(h->list) < 40) {
+        history_load_page(h);
+    }
+}
+
+static void history_list_init(history_list_t *h, lv_obj_t * list, core_history_kind_t kind, const char *empty_text) {
+    h->list = list;
+    h->kind = kind;
+    h->loaded = 0;
+    h->total = 0;
+    history_load_page(h);
+    if (h->total == 0) {
+        lv_list_add_text(list, empty_text);
+    } else {
+        lv_obj_add_event_cb(list, history_scroll_cb, LV_EVENT_SCROLL_END, h);
+    }
+}
+
+static bool chart_add_weight(uint32_t date, int32_t mg, void *ctx) {
+    lv_obj_t * chart = ctx;
+    lv_chart_set_next_value(chart, lv_chart_get_series_next(chart, NULL), (lv_coord_t)(mg / 1000));
+    return true;
+}
+
 static void build_weight_tab(lv_obj_t * parent, const animal_t *animal) {
     lv_obj_t * btn_add = lv_button_create(parent);
     lv_obj_set_size(btn_add, 40, 40);
@@ -254,39 +349,26 @@ static void build_weight_tab(lv_obj_t * parent, const animal_t *animal) {
     lv_obj_set_y(chart_cont, 50);
     lv_obj_set_style_border_width(chart_cont, 0, 0);
 
-    if (animal->weight_count > 0) {
+    // List Container (its first page also gives the sample count)
+    lv_obj_t * list = lv_list_create(parent);
+    lv_obj_set_size(list, LV_PCT(100), LV_PCT(35));
+    lv_obj_align(list, LV_ALIGN_BOTTOM_MID, 0, 0);
+    history_list_init(&weight_history, list, CORE_HISTORY_WEIGHTS, "Aucun poids enregistré.");
+
+    if (weight_history.total > 0) {
         lv_obj_t * chart = lv_chart_create(chart_cont);
         lv_obj_set_size(chart, LV_PCT(100), LV_PCT(100));
         lv_obj_center(chart);
         lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
-        lv_chart_set_point_count(chart, animal->weight_count);
-        
-        lv_chart_series_t * ser = lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_BLUE), LV_CHART_AXIS_PRIMARY_Y);
+        lv_chart_set_point_count(chart, weight_history.total);
         
-        for (size_t i = 0; i < animal->weight_count; i++) {
-            lv_chart_set_next_value(chart, ser, (lv_coord_t)animal->weights[i].value);
-        }
+        lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_BLUE), LV_CHART_AXIS_PRIMARY_Y);
+        // Grams, decoded straight from the packed history
+        core_foreach_weight(animal->id, chart_add_weight, chart);
         lv_chart_refresh(chart);
     } else {
         lv_label_set_text(lv_label_create(chart_cont), "Pas de données graphiques.");
     }
-
-    // List Container
-    lv_obj_t * list = lv_list_create(parent);
-    lv_obj_set_size(list, LV_PCT(100), LV_PCT(35));
-    lv_obj_align(list, LV_ALIGN_BOTTOM_MID, 0, 0);
-
-    if (animal->weight_count == 0) {
-        lv_list_add_text(list, "Aucun poids enregistré.");
-    } else {
-        char buf[64];
-        for (int i = animal->weight_count - 1; i >= 0; i--) {
-            format_date(buf, sizeof(buf), animal->weights[i].date);
-            char item_str[128];
-            snprintf(item_str, sizeof(item_str), "%s: %.1f %s", buf, animal->weights[i].value, animal->weights[i].unit);
-            lv_list_add_btn(list, NULL, item_str);
-        }
-    }
 }
 
 static void build_event_tab(lv_obj_t * parent, const animal_t *animal) {
@@ -299,31 +381,7 @@ static void build_event_tab(lv_obj_t * parent, const animal_t *animal) {
     lv_obj_t * list = lv_list_create(parent);
     lv_obj_set_size(list, LV_PCT(100), LV_PCT(85));
     lv_obj_set_y(list, 50);
-
-    if (animal->event_count == 0) {
-        lv_list_add_text(list, "Aucun événement.");
-    } else {
-        char buf[64];
-        const char *type_str;
-        for (int i = animal->event_count - 1; i >= 0; i--) {
-            format_date(buf, sizeof(buf), animal->events[i].date);
-            
-            switch(animal->events[i].type) {
-                case EVENT_FEEDING: type_str = "Nourrissage"; break;
-                case EVENT_SHEDDING: type_str = "Mue"; break;
-                case EVENT_VET: type_str = "Veto"; break;
-                case EVENT_CLEANING: type_str = "Nettoyage"; break;
-                case EVENT_MATING: type_str = "Accouplement"; break;
-                case EVENT_LAYING: type_str = "Ponte"; break;
-                case EVENT_HATCHING: type_str = "Eclosion"; break;
-                default: type_str = "Autre"; break;
-            }
-
-            char item_str[256];
-            snprintf(item_str, sizeof(item_str), "%s [%s] %s", buf, type_str, animal->events[i].description);
-            lv_list_add_btn(list, NULL, item_str);
-        }
-    }
+    history_list_init(&event_history, list, CORE_HISTORY_EVENTS, "Aucun événement.");
 }
 
 // =============================================================================
@@ -338,8 +396,9 @@ void ui_create_animal_details_screen(const char *animal_id) {
     lv_coord_t disp_h = lv_display_get_vertical_resolution(disp);
     const lv_coord_t header_height = 60;
 
+    // Header only: the history tabs fetch their own pages
     animal_t animal;
-    if (core_get_animal(animal_id, &animal) != ESP_OK) {
+    if (core_get_animal_header(animal_id, &animal) != ESP_OK) {
         LV_LOG_ERROR("Failed to load animal %s", animal_id);
         return;
     }
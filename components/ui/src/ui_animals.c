@@ -33,7 +33,7 @@ static void load_animal_list(const char *query) {
             for (size_t i = 0; i < count; i++) {
                 char *id_copy = ui_strdup(animals[i].id);
                 char label[256];
-                snprintf(label, sizeof(label), "%s (%s)", animals[i].name, animals[i].species);
+                snprintf(label, sizeof(label), "%s (%s)", animals[i].name, core_species_name(animals[i].species_id));
                 
                 // Need to recreate event callback to capture id_copy
                 // But we can't pass user_data easily in a loop if we define callback outside?
@@ -67,25 +67,38 @@ static void animal_item_wrapper_cb(lv_event_t * e) {
     if (id) ui_create_animal_details_screen(id);
 }
 
+// Rows materialised per keystroke; refining the query narrows the rest
+#define ANIMAL_LIST_VISIBLE_MAX 50
+
+static core_search_session_t * s_search_session;
+
 // Re-implement load_animal_list with correct callback
 static void load_animal_list_correct(const char *query) {
     lv_obj_clean(list_animals);
     
-    animal_summary_t *animals = NULL;
-    size_t count = 0;
-    if (core_search_animals(query, &animals, &count) == ESP_OK) {
+    if (!s_search_session) s_search_session = core_search_session_create();
+    if (!s_search_session) return;
+
+    const animal_summary_t *animals = NULL;
+    size_t count = 0, total = 0;
+    if (core_search_session_update(s_search_session, query, ANIMAL_LIST_VISIBLE_MAX,
+                                   &animals, &count, &total) == ESP_OK) {
         if (count == 0) {
             lv_list_add_text(list_animals, "Aucun animal trouvé.");
         } else {
             for (size_t i = 0; i < count; i++) {
                 char *id_copy = ui_strdup(animals[i].id);
                 char label[256];
-                snprintf(label, sizeof(label), "%s (%s)", animals[i].name, animals[i].species);
+                snprintf(label, sizeof(label), "%s (%s)", animals[i].name, core_species_name(animals[i].species_id));
                 
                 lv_obj_t * btn = lv_list_add_btn(list_animals, LV_SYMBOL_PASTE, label);
                 lv_obj_add_event_cb(btn, animal_item_wrapper_cb, LV_EVENT_CLICKED, id_copy);
             }
-            core_free_animal_list(animals);
+            if (total > count) {
+                char more[64];
+                snprintf(more, sizeof(more), "... %u autres, affinez la recherche", (unsigned)(total - count));
+                lv_list_add_text(list_animals, more);
+            }
         }
     }
 }
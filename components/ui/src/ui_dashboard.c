@@ -5,6 +5,7 @@
 #include "ui_web.h"
 #include "ui_logs.h"
 #include "ui_alerts.h"
+#include "core_service.h"
 #include "lvgl.h"
 #include "board.h"
 #include "esp_err.h"
@@ -22,6 +23,13 @@ static lv_obj_t * clock_label;
 static lv_timer_t * clock_timer;
 static lv_obj_t * battery_label;
 static lv_timer_t * battery_timer;
+static lv_obj_t * alert_badge;
+static lv_obj_t * activity_list;
+static lv_timer_t * activity_timer;
+
+#define ACTIVITY_DAYS 7
+#define ACTIVITY_MAX_ITEMS 20
+#define ACTIVITY_TITLE "Activité (7 jours)"
 
 static void init_styles(void)
 {
@@ -80,6 +88,17 @@ static void clock_timer_cb(lv_timer_t * timer)
     if (clock_label) {
         lv_label_set_text(clock_label, strftime_buf);
     }
+
+    // O(1) read from the alert engine, cheap enough for every tick
+    if (alert_badge) {
+        size_t alerts = core_get_alert_count();
+        if (alerts > 0) {
+            lv_label_set_text_fmt(alert_badge, "%u", (unsigned)alerts);
+            lv_obj_remove_flag(alert_badge, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(alert_badge, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
 }
 
 static void battery_timer_cb(lv_timer_t * timer)
@@ -100,11 +119,65 @@ static void battery_timer_cb(lv_timer_t * timer)
     (void)raw;
 }
 
+static const char *activity_type_str(uint8_t type)
+{
+    switch (type) {
+        case CORE_TIMELINE_WEIGHT: return "Pesée";
+        case EVENT_FEEDING: return "Nourrissage";
+        case EVENT_SHEDDING: return "Mue";
+        case EVENT_VET: return "Veto";
+        case EVENT_CLEANING: return "Nettoyage";
+        case EVENT_MATING: return "Accouplement";
+        case EVENT_LAYING: return "Ponte";
+        case EVENT_HATCHING: return "Eclosion";
+        default: return "Autre";
+    }
+}
+
+// Newest entries of the last days, from the timeline; retried until the
+// boot indexing is done, then left alone
+static void activity_timer_cb(lv_timer_t * timer)
+{
+    if (!activity_list) {
+        return;
+    }
+    if (!core_timeline_ready()) {
+        return;
+    }
+    lv_obj_clean(activity_list);
+    lv_list_add_text(activity_list, ACTIVITY_TITLE);
+
+    uint32_t now = (uint32_t)time(NULL);
+    uint32_t range = ACTIVITY_DAYS * 24 * 3600;
+    core_timeline_cursor_t cursor;
+    core_timeline_cursor_init(&cursor, now > range ? now - range : 0, now, 0, CORE_HISTORY_NEWEST_FIRST);
+    core_timeline_item_t items[ACTIVITY_MAX_ITEMS];
+    size_t count = 0;
+    core_timeline_next(&cursor, items, ACTIVITY_MAX_ITEMS, &count);
+
+    for (size_t i = 0; i < count; i++) {
+        char date_str[32];
+        char item_str[128];
+        time_t t = (time_t)items[i].date;
+        struct tm timeinfo;
+        localtime_r(&t, &timeinfo);
+        strftime(date_str, sizeof(date_str), "%d/%m %H:%M", &timeinfo);
+        snprintf(item_str, sizeof(item_str), "%s  %s  %s", date_str, items[i].name, activity_type_str(items[i].type));
+        lv_list_add_text(activity_list, item_str);
+    }
+    if (count == 0) {
+        lv_list_add_text(activity_list, "Aucune activité");
+    }
+    if (timer) {
+        lv_timer_pause(timer);
+    }
+}
+
 // =============================================================================
 // Helpers
 // =============================================================================
 
-static void create_tile(lv_obj_t * parent, const char * icon, const char * title, int col, int row, int w, int h, bool is_alert)
+static lv_obj_t * create_tile(lv_obj_t * parent, const char * icon, const char * title, int col, int row, int w, int h, bool is_alert)
 {
     lv_obj_t * btn = lv_button_create(parent);
     lv_obj_set_size(btn, w, h);
@@ -121,6 +194,7 @@ static void create_tile(lv_obj_t * parent, const char * icon, const char * title
     lv_label_set_text_fmt(label, "%s\n%s", icon, title);
     lv_obj_set_style_text_align(label, LV_TEXT_ALIGN_CENTER, 0);
     lv_obj_center(label);
+    return btn;
 }
 
 // =============================================================================
@@ -169,7 +243,7 @@ void ui_create_dashboard(void)
 
     // 2. Grid Container for Tiles
     static int32_t col_dsc[] = {LV_GRID_FR(1), LV_GRID_FR(1), LV_GRID_FR(1), LV_GRID_TEMPLATE_LAST};
-    static int32_t row_dsc[] = {LV_GRID_FR(1), LV_GRID_FR(1), LV_GRID_TEMPLATE_LAST};
+    static int32_t row_dsc[] = {LV_GRID_FR(1), LV_GRID_FR(1), LV_GRID_FR(1), LV_GRID_TEMPLATE_LAST};
 
     lv_coord_t disp_w = 1024;
     lv_coord_t disp_h = 600;
@@ -204,7 +278,26 @@ void ui_create_dashboard(void)
     // Row 1
     create_tile(grid, LV_SYMBOL_EDIT, "Journaux", 0, 1, 1, 1, false);
     create_tile(grid, LV_SYMBOL_SETTINGS, "Paramètres", 1, 1, 1, 1, false);
-    create_tile(grid, LV_SYMBOL_WARNING, "Alertes", 2, 1, 1, 1, true); // Replaced Aide with Alertes
+    lv_obj_t * alerts_tile = create_tile(grid, LV_SYMBOL_WARNING, "Alertes", 2, 1, 1, 1, true); // Replaced Aide with Alertes
+
+    // Pending alert count, refreshed by the clock timer
+    alert_badge = lv_label_create(alerts_tile);
+    lv_obj_set_style_bg_color(alert_badge, lv_palette_main(LV_PALETTE_RED), 0);
+    lv_obj_set_style_bg_opa(alert_badge, LV_OPA_COVER, 0);
+    lv_obj_set_style_radius(alert_badge, LV_RADIUS_CIRCLE, 0);
+    lv_obj_set_style_pad_hor(alert_badge, 8, 0);
+    lv_obj_align(alert_badge, LV_ALIGN_TOP_RIGHT, 0, 0);
+    lv_obj_add_flag(alert_badge, LV_OBJ_FLAG_HIDDEN);
+    clock_timer_cb(clock_timer);
+
+    // Row 2: recent activity of every animal
+    activity_list = lv_list_create(grid);
+    lv_obj_set_grid_cell(activity_list, LV_GRID_ALIGN_STRETCH, 0, 3, LV_GRID_ALIGN_STRETCH, 2, 1);
+    lv_list_add_text(activity_list, ACTIVITY_TITLE);
+    lv_list_add_text(activity_list, "Indexation...");
+    if (activity_timer) lv_timer_del(activity_timer);
+    activity_timer = lv_timer_create(activity_timer_cb, 1000, NULL);
+    activity_timer_cb(activity_timer);
 
     // Load the screen
     lv_screen_load(scr);
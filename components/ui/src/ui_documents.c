@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#define EXPIRY_WINDOW_DAYS 30
 
 static char * ui_strdup(const char *src) {
     if (!src) return NULL;
@@ -109,6 +112,30 @@ void ui_create_documents_screen(void)
     lv_obj_set_size(list, disp_w, list_h);
     lv_obj_set_y(list, header_height);
 
+    // Range scan of the expiry index, soonest first
+    lv_list_add_text(list, "Expirent dans les 30 jours");
+    uint32_t now = (uint32_t)time(NULL);
+    document_t *docs = NULL;
+    size_t doc_count = 0;
+    if (core_list_expiring_documents(now, now + EXPIRY_WINDOW_DAYS * 24 * 3600, &docs, &doc_count) == ESP_OK &&
+        doc_count > 0) {
+        for (size_t i = 0; i < doc_count; i++) {
+            char date_str[32];
+            char item_str[160];
+            time_t t = (time_t)docs[i].date_expire;
+            struct tm timeinfo;
+            localtime_r(&t, &timeinfo);
+            strftime(date_str, sizeof(date_str), "%d/%m/%Y", &timeinfo);
+            snprintf(item_str, sizeof(item_str), "%s %s - %s", docs[i].type, docs[i].ref_number, date_str);
+            lv_obj_t * btn = lv_list_add_btn(list, LV_SYMBOL_WARNING, item_str);
+            lv_obj_set_style_text_color(btn, lv_palette_main(LV_PALETTE_ORANGE), 0);
+        }
+        core_free_document_list(docs);
+    } else {
+        lv_list_add_text(list, "Aucun document n'expire prochainement.");
+    }
+
+    lv_list_add_text(list, "Rapports");
     char **reports = NULL;
     size_t count = 0;
     if (core_list_reports(&reports, &count) == ESP_OK) {
@@ -8,6 +8,9 @@
 #include <string.h>
 #include <time.h>
 
+// Newest reproduction events shown; older seasons are rarely looked at
+#define REPRO_LIST_MAX 100
+
 static char current_animal_id[37];
 static lv_obj_t * scr_repro;
 static lv_obj_t * list_history;
@@ -89,8 +92,9 @@ void ui_create_reproduction_screen(const char *animal_id) {
     lv_coord_t disp_h = lv_display_get_vertical_resolution(disp);
     const lv_coord_t header_height = 60;
 
+    // Header only: the reproduction events come from the per-type columns
     animal_t animal;
-    if (core_get_animal(animal_id, &animal) != ESP_OK) return;
+    if (core_get_animal_header(animal_id, &animal) != ESP_OK) return;
 
     scr_repro = lv_obj_create(NULL);
     lv_obj_set_style_bg_color(scr_repro, lv_color_hex(0xF0F0F0), 0);
@@ -121,30 +125,35 @@ void ui_create_reproduction_screen(const char *animal_id) {
     lv_obj_set_size(list_history, disp_w, disp_h - header_height);
     lv_obj_set_y(list_history, header_height);
 
-    if (animal.event_count == 0) {
+    core_event_query_t query = {
+        .types = CORE_EVENT_MASK(EVENT_MATING) | CORE_EVENT_MASK(EVENT_LAYING) | CORE_EVENT_MASK(EVENT_HATCHING),
+        .limit = REPRO_LIST_MAX,
+        .order = CORE_HISTORY_NEWEST_FIRST,
+    };
+    core_history_page_t page = {0};
+    if (core_query_events(animal_id, &query, &page) != ESP_OK || page.count == 0) {
         lv_list_add_text(list_history, "Aucune donnée de reproduction.");
     } else {
         char buf[64];
-        bool found = false;
-        for (int i = animal.event_count - 1; i >= 0; i--) {
-            event_type_t t = animal.events[i].type;
-            if (t == EVENT_MATING || t == EVENT_LAYING || t == EVENT_HATCHING) {
-                found = true;
-                format_date(buf, sizeof(buf), animal.events[i].date);
-                
-                const char *type_str = "Inconnu";
-                const char *icon = LV_SYMBOL_BULLET;
-                if (t == EVENT_MATING) { type_str = "Accouplement"; icon = LV_SYMBOL_LOOP; }
-                else if (t == EVENT_LAYING) { type_str = "Ponte"; icon = LV_SYMBOL_DOWNLOAD; }
-                else if (t == EVENT_HATCHING) { type_str = "Eclosion"; icon = LV_SYMBOL_UP; }
-
-                char item_str[256];
-                snprintf(item_str, sizeof(item_str), "%s [%s] %s", buf, type_str, animal.events[i].description);
-                lv_list_add_btn(list_history, icon, item_str);
-            }
+        for (size_t i = 0; i < page.count; i++) {
+            const event_record_t *ev = &page.events[i];
+            format_date(buf, sizeof(buf), ev->date);
+
+            const char *type_str = "Inconnu";
+            const char *icon = LV_SYMBOL_BULLET;
+            if (ev->type == EVENT_MATING) { type_str = "Accouplement"; icon = LV_SYMBOL_LOOP; }
+            else if (ev->type == EVENT_LAYING) { type_str = "Ponte"; icon = LV_SYMBOL_DOWNLOAD; }
+            else if (ev->type == EVENT_HATCHING) { type_str = "Eclosion"; icon = LV_SYMBOL_UP; }
+
+            char item_str[256];
+            snprintf(item_str, sizeof(item_str), "%s [%s] %s", buf, type_str, ev->description);
+            lv_list_add_btn(list_history, icon, item_str);
+        }
+        if (page.total > page.count) {
+            lv_list_add_text(list_history, "...");
         }
-        if (!found) lv_list_add_text(list_history, "Aucune donnée de reproduction.");
     }
+    core_free_history_page(&page);
 
     core_free_animal_content(&animal);
     lv_screen_load(scr_repro);
@@ -41,6 +41,7 @@ static void save_wifi_cb(lv_event_t * e)
     if (strlen(ssid) > 0) {
         storage_nvs_set_str("wifi_ssid", ssid);
         storage_nvs_set_str("wifi_pwd", pwd);
+        storage_nvs_flush();
         net_connect(ssid, pwd);
         ui_msgbox_notify("Info", "WiFi credentials saved.");
     }
@@ -50,18 +51,22 @@ static void save_pin_cb(lv_event_t * e)
 {
     const char * pin = lv_textarea_get_text(ta_pin);
     storage_nvs_set_str("sys_pin", pin);
+    storage_nvs_flush();
     ui_msgbox_notify("Info", "Code PIN enregistre.");
 }
 
 static void export_cb(lv_event_t * e)
 {
-    if (!board_sd_is_mounted()) {
-        ui_msgbox_notify("SD desactivee", "Aucune carte SD montee. Export indisponible.");
+    char path[64];
+    if (!storage_is_ready() || storage_path(path, sizeof(path), "export.csv") != ESP_OK) {
+        ui_msgbox_notify("Stockage desactive", "Aucun stockage monte. Export indisponible.");
         return;
     }
 
-    if (core_export_csv("/sdcard/export.csv") == ESP_OK) {
-        ui_msgbox_notify("Succes", "Export CSV termine:\n/sdcard/export.csv");
+    if (core_export_csv(path) == ESP_OK) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "Export CSV termine:\n%s", path);
+        ui_msgbox_notify("Succes", msg);
     } else {
         ui_msgbox_notify("Erreur", "Echec de l'export.");
     }
@@ -95,6 +100,7 @@ static void backlight_event_cb(lv_event_t * e)
 
     int32_t percent = lv_slider_get_value(slider_bl);
     board_set_backlight_percent((uint8_t)percent);
+    // Write-behind: a drag ends up as one NVS commit
     storage_nvs_set_i32("backlight_pct", percent);
     update_backlight_label(percent);
 }
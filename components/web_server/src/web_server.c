@@ -4,12 +4,17 @@
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "cJSON.h"
+#include "json_arena_httpd.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "WEB_SERVER";
 static httpd_handle_t server = NULL;
+static json_arena_t *s_arena = NULL;
+
+// Holds one response of a few hundred animals without growing
+#define WEB_ARENA_CHUNK_SIZE (32 * 1024)
 
 // =============================================================================
 // HTML Content
@@ -107,7 +112,7 @@ static esp_err_t api_animals_get_handler(httpd_req_t *req)
         cJSON *item = cJSON_CreateObject();
         cJSON_AddStringToObject(item, "id", list[i].id);
         cJSON_AddStringToObject(item, "name", list[i].name);
-        cJSON_AddStringToObject(item, "species", list[i].species);
+        cJSON_AddStringToObject(item, "species", core_species_name(list[i].species_id));
         cJSON_AddItemToArray(root, item);
     }
     core_free_animal_list(list);
@@ -116,7 +121,7 @@ static esp_err_t api_animals_get_handler(httpd_req_t *req)
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, json_str, strlen(json_str));
     
-    free((void*)json_str);
+    cJSON_free((void*)json_str);
     cJSON_Delete(root);
     return ESP_OK;
 }
@@ -175,6 +180,11 @@ static esp_err_t api_animals_post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// Every handler runs with the server arena bound (json_arena_httpd.h)
+static json_arena_httpd_ctx_t root_get_ctx = { root_get_handler, &s_arena };
+static json_arena_httpd_ctx_t api_animals_get_ctx = { api_animals_get_handler, &s_arena };
+static json_arena_httpd_ctx_t api_animals_post_ctx = { api_animals_post_handler, &s_arena };
+
 // =============================================================================
 // Init
 // =============================================================================
@@ -184,6 +194,9 @@ esp_err_t web_server_init(void)
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.stack_size = 8192; // Increase stack for JSON processing
 
+    s_arena = json_arena_create(WEB_ARENA_CHUNK_SIZE, JSON_ARENA_PSRAM);
+    if (!s_arena) ESP_LOGW(TAG, "No request arena, handlers use the heap");
+
     ESP_LOGI(TAG, "Starting server on port: %d", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
         
@@ -191,8 +204,8 @@ esp_err_t web_server_init(void)
         httpd_uri_t root_uri = {
             .uri       = "/",
             .method    = HTTP_GET,
-            .handler   = root_get_handler,
-            .user_ctx  = NULL
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &root_get_ctx
         };
         httpd_register_uri_handler(server, &root_uri);
 
@@ -200,8 +213,8 @@ esp_err_t web_server_init(void)
         httpd_uri_t animals_get_uri = {
             .uri       = "/api/animals",
             .method    = HTTP_GET,
-            .handler   = api_animals_get_handler,
-            .user_ctx  = NULL
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &api_animals_get_ctx
         };
         httpd_register_uri_handler(server, &animals_get_uri);
 
@@ -209,8 +222,8 @@ esp_err_t web_server_init(void)
         httpd_uri_t animals_post_uri = {
             .uri       = "/api/animals",
             .method    = HTTP_POST,
-            .handler   = api_animals_post_handler,
-            .user_ctx  = NULL
+            .handler   = json_arena_httpd_handler,
+            .user_ctx  = &api_animals_post_ctx
         };
         httpd_register_uri_handler(server, &animals_post_uri);
 
@@ -227,4 +240,6 @@ void web_server_stop(void)
         httpd_stop(server);
         server = NULL;
     }
+    json_arena_destroy(s_arena);
+    s_arena = NULL;
 }
\ No newline at end of file